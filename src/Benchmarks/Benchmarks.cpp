@@ -0,0 +1,535 @@
+// copyright Garrett Skelton 2020
+// MIT license
+#define KATASCRIPT_IMPL
+#include "../Library/KataScript.hpp"
+
+#include <cstring>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// small timing harness, run with a benchmark name to only run that one
+
+using Clock = std::chrono::steady_clock;
+
+// every allocation is counted, so a benchmark can report the memory it holds as well as its time
+std::atomic<size_t> liveBytes = 0;
+std::atomic<size_t> peakBytes = 0;
+
+void* operator new(size_t size) {
+    auto block = static_cast<char*>(std::malloc(size + sizeof(std::max_align_t)));
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    *reinterpret_cast<size_t*>(block) = size;
+    auto live = liveBytes += size;
+    auto peak = peakBytes.load();
+    while (live > peak && !peakBytes.compare_exchange_weak(peak, live)) {}
+    return block + sizeof(std::max_align_t);
+}
+
+void operator delete(void* ptr) noexcept {
+    if (ptr) {
+        auto block = static_cast<char*>(ptr) - sizeof(std::max_align_t);
+        liveBytes -= *reinterpret_cast<size_t*>(block);
+        std::free(block);
+    }
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+// run a function a few times on a fresh interpreter and return the fastest time in milliseconds
+// building the interpreter is not part of the time
+template <typename F>
+double bestOf(int runs, F&& f) {
+    double best = 1e300;
+    for (int i = 0; i < runs; ++i) {
+        KataScript::KataScriptInterpreter interp;
+        auto start = Clock::now();
+        f(interp);
+        best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+// builds an expression shape with close to the requested number of tokens, returning the source and its token count
+using ExpressionShape = std::pair<std::string, size_t>(*)(size_t tokens);
+
+std::pair<std::string, size_t> flatSum(size_t tokens) {
+    auto n = (tokens + 1) / 2;
+    std::string s = "x";
+    for (size_t i = 1; i < n; ++i) {
+        s += " + x";
+    }
+    return { s, n * 2 - 1 };
+}
+
+std::pair<std::string, size_t> mixedOperators(size_t tokens) {
+    auto n = (tokens + 1) / 2;
+    std::string s = "x";
+    const char* ops[] = { " + ", " * ", " - ", " / ", " == ", " && " };
+    for (size_t i = 1; i < n; ++i) {
+        s += ops[i % 6];
+        s += "x";
+    }
+    return { s, n * 2 - 1 };
+}
+
+std::pair<std::string, size_t> nestedCalls(size_t tokens) {
+    auto n = (tokens - 1) / 3;
+    std::string s;
+    for (size_t i = 0; i < n; ++i) {
+        s += "f(";
+    }
+    s += "x";
+    for (size_t i = 0; i < n; ++i) {
+        s += ")";
+    }
+    return { s, n * 3 + 1 };
+}
+
+std::pair<std::string, size_t> nestedParens(size_t tokens) {
+    auto n = (tokens - 1) / 4;
+    std::string s;
+    for (size_t i = 0; i < n; ++i) {
+        s += "(x + ";
+    }
+    s += "x";
+    for (size_t i = 0; i < n; ++i) {
+        s += ")";
+    }
+    return { s, n * 4 + 1 };
+}
+
+std::pair<std::string, size_t> indexChain(size_t tokens) {
+    auto n = (tokens - 1) / 3;
+    std::string s = "x";
+    for (size_t i = 0; i < n; ++i) {
+        s += "[0]";
+    }
+    return { s, n * 3 + 1 };
+}
+
+// parse time of single expressions from 1.25k to 20k tokens
+// wrapping them in a function body means they are parsed but never run
+// the time per token should stay flat as the expressions grow
+void parser() {
+    std::pair<const char*, ExpressionShape> shapes[] = {
+        { "flat sum", flatSum },
+        { "mixed operators", mixedOperators },
+        { "nested calls", nestedCalls },
+        { "nested parens", nestedParens },
+        { "index chain", indexChain },
+    };
+    printf("%-16s %8s %10s %10s\n", "parser", "tokens", "ms", "ns/token");
+    for (auto& [name, shape] : shapes) {
+        for (size_t tokens = 1250; tokens <= 20000; tokens *= 2) {
+            auto [expression, count] = shape(tokens);
+            auto script = "fn bench() { return " + expression + "; }";
+            auto ms = bestOf(5, [&](KataScript::KataScriptInterpreter& interp) {
+                interp.evaluate(script);
+            });
+            printf("%-16s %8zu %10.3f %10.1f\n", name, count, ms, ms * 1e6 / (double)count);
+        }
+    }
+}
+
+// tokenizer throughput over a few megabytes of typical script, straight from a buffer and streamed in chunks
+void tokenizer() {
+    std::string chunk = R"--(
+// a comment that runs to the end of the line
+fn update(entity, dt) {
+    var speed = entity.velocity * dt + 0.5;
+    if (speed >= maxSpeed && !entity.boosting) {
+        speed = maxSpeed;
+    } else if (speed < -12) {
+        print("slow " + string(speed));
+    }
+    foreach (item; entity.inventory) { total += item.weight; }
+    for (i = 0; i < 10; i++) { positions[i] = vec3(i, -i, 0.25); }
+    return [speed, "done", entity.name];
+}
+)--";
+    std::string script;
+    while (script.size() < 8 * 1024 * 1024) {
+        script += chunk;
+    }
+    auto megabytes = (double)script.size() / (1024 * 1024);
+    size_t count = 0;
+    auto buffered = bestOf(5, [&](KataScript::KataScriptInterpreter&) {
+        KataScript::Tokenizer tokenizer(script);
+        KataScript::Token token;
+        count = 0;
+        while (tokenizer.next(token)) {
+            ++count;
+        }
+    });
+    auto streamed = bestOf(5, [&](KataScript::KataScriptInterpreter&) {
+        std::istringstream stream(script);
+        KataScript::Tokenizer tokenizer(stream);
+        KataScript::Token token;
+        while (tokenizer.next(token)) {}
+    });
+    printf("%-16s %10s %10s %10s\n", "tokenizer", "tokens", "ms", "MB/s");
+    printf("%-16s %10zu %10.3f %10.1f\n", "buffer", count, buffered, megabytes / (buffered / 1000));
+    printf("%-16s %10zu %10.3f %10.1f\n", "stream", count, streamed, megabytes / (streamed / 1000));
+}
+
+// the same request script run many times, parsed on every run against compiled once
+// a compiled program is loaded into the interpreter on its first run and reused after that
+void programs() {
+    std::string script;
+    for (int i = 0; i < 200; ++i) {
+        script += "fn f" + std::to_string(i) + "(a, b) { var c = a * b + " + std::to_string(i) + "; if (c > 10) { return c - 1; } return c; }\n";
+    }
+    script += "total = 0;\nfor (i = 0; i < 20; i++) { total += f7(i, 2); }\n";
+    const int requests = 100;
+
+    auto parsed = bestOf(5, [&](KataScript::KataScriptInterpreter& interp) {
+        for (int i = 0; i < requests; ++i) {
+            interp.evaluate(script, interp.newScope("request"));
+        }
+    });
+    auto program = KataScript::KataScriptInterpreter().compile(script);
+    auto compiled = bestOf(5, [&](KataScript::KataScriptInterpreter& interp) {
+        for (int i = 0; i < requests; ++i) {
+            interp.run(*program, interp.newScope("request"));
+        }
+    });
+    printf("%-16s %10s %12s\n", "programs", "ms", "ms/request");
+    printf("%-16s %10.3f %12.4f\n", "evaluate", parsed, parsed / requests);
+    printf("%-16s %10.3f %12.4f\n", "compiled", compiled, compiled / requests);
+}
+
+// class instances with long member names, built, read and called on both engines
+// every lookup is by interned symbol, so the length of a name shouldn't matter after parsing
+void members() {
+    std::string script = R"--(
+class particleWithLongName {
+    var positionAlongTheTrack; var velocityAlongTheTrack; var accumulatedDistance;
+    fn particleWithLongName(p, v) { positionAlongTheTrack = p; velocityAlongTheTrack = v; accumulatedDistance = 0; }
+    fn advanceOneStep(dt) {
+        positionAlongTheTrack += velocityAlongTheTrack * dt;
+        accumulatedDistance += abs(velocityAlongTheTrack * dt);
+        return positionAlongTheTrack;
+    }
+}
+fn simulate(count, steps) {
+    var particles = [];
+    for (var i = 0; i < count; i++) { particles += [particleWithLongName(i, i % 7 - 3)]; }
+    var total = 0;
+    for (var s = 0; s < steps; s++) {
+        foreach (p; particles) { total += p.advanceOneStep(0.5) + p.accumulatedDistance; }
+    }
+    return total;
+}
+)--";
+    printf("%-16s %10s\n", "members", "ms");
+    for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+        auto ms = bestOf(5, [&](KataScript::KataScriptInterpreter& interp) {
+            interp.setExecutionEngine(engine);
+            interp.evaluate(script);
+            interp.evaluate("result = simulate(200, 100);");
+        });
+        printf("%-16s %10.3f\n", engine == KataScript::ExecutionEngine::Bytecode ? "bytecode" : "tree walker", ms);
+    }
+}
+
+// a big library where a request only calls a few of the functions
+// with lazy parsing the other bodies are only scanned for their closing brace
+void lazy() {
+    std::string library;
+    for (int i = 0; i < 2000; ++i) {
+        auto n = std::to_string(i);
+        library += "fn util" + n + "(a, b) {\n    var c = a * " + n + " + b;\n    if (c > 10) { return [c, a, b]; }\n"
+            "    foreach (x; [a, b, c]) { c += x; }\n    return c - 1;\n}\n";
+    }
+    library += "total = util1(1, 2) + util10(3, 4) + util100(5, 6);\n";
+    printf("%-16s %10s\n", "lazy", "ms");
+    for (auto lazyParsing : { false, true }) {
+        auto ms = bestOf(5, [&](KataScript::KataScriptInterpreter& interp) {
+            interp.setLazyParsing(lazyParsing);
+            interp.evaluate(library);
+        });
+        printf("%-16s %10.3f\n", lazyParsing ? "lazy" : "eager", ms);
+    }
+}
+
+// every request imports the same library into its own scope
+// uncached parses the file each time, cached parses it once and runs the parsed form after that
+void imports() {
+    {
+        std::ofstream library("benchmarkImport.ks");
+        for (int i = 0; i < 200; ++i) {
+            library << "fn util" << i << "(a, b) { var c = a * " << i << " + b; if (c > 10) { return c - 1; } return c; }\n";
+        }
+    }
+    const int requests = 100;
+    printf("%-16s %10s %12s\n", "imports", "ms", "ms/request");
+    for (auto cached : { false, true }) {
+        auto ms = bestOf(5, [&](KataScript::KataScriptInterpreter& interp) {
+            for (int i = 0; i < requests; ++i) {
+                if (!cached) {
+                    interp.invalidateImports();
+                }
+                interp.evaluate("import \"benchmarkImport.ks\"; total = util7(3, 4);", interp.newScope("request" + std::to_string(i)));
+            }
+        });
+        printf("%-16s %10.3f %12.4f\n", cached ? "cached" : "uncached", ms, ms / requests);
+    }
+    std::remove("benchmarkImport.ks");
+}
+
+// a cold start that imports a lot of small files, read one by one from disk or out of one bundle
+void bundles() {
+    const int files = 300;
+    std::vector<std::string> paths;
+    std::string script;
+    for (int i = 0; i < files; ++i) {
+        auto n = std::to_string(i);
+        paths.push_back("benchmarkModule" + n + ".ks");
+        std::ofstream module(paths.back());
+        module << "fn module" << n << "(a) { return a + " << n << "; }\nloaded += 1;\n";
+        script += "import \"" + paths.back() + "\";\n";
+    }
+    KataScript::writeBundle("benchmarkModules.ksb", paths);
+    script = "loaded = 0;\n" + script;
+    printf("%-16s %10s\n", "bundles", "ms");
+    for (auto bundled : { false, true }) {
+        auto ms = bestOf(5, [&](KataScript::KataScriptInterpreter& interp) {
+            if (bundled) {
+                interp.mountBundle("benchmarkModules.ksb");
+            }
+            interp.evaluate(script);
+        });
+        printf("%-16s %10.3f\n", bundled ? "bundle" : "files", ms);
+    }
+    for (auto& path : paths) {
+        std::remove(path.c_str());
+    }
+    std::remove("benchmarkModules.ksb");
+}
+
+// insert, look up and iterate a million int keys
+// the old dictionary was an unordered_map keyed by the hash alone, it's timed the same way for comparison
+void dictionaries() {
+    const KataScript::Int count = 1000000;
+    std::vector<KataScript::Value> keys;
+    keys.reserve(count);
+    for (KataScript::Int i = 0; i < count; ++i) {
+        keys.emplace_back(i * 7919);
+    }
+    auto value = KataScript::makeValue(KataScript::Int(1));
+    printf("%-16s %10s %10s %10s\n", "dictionaries", "insert ms", "lookup ms", "iterate ms");
+    auto measure = [&](const char* name, auto&& insert, auto&& lookup, auto&& iterate) {
+        double times[3] = { 1e300, 1e300, 1e300 };
+        for (int run = 0; run < 3; ++run) {
+            auto start = Clock::now();
+            insert();
+            auto inserted = Clock::now();
+            lookup();
+            auto looked = Clock::now();
+            iterate();
+            auto iterated = Clock::now();
+            times[0] = std::min(times[0], std::chrono::duration<double, std::milli>(inserted - start).count());
+            times[1] = std::min(times[1], std::chrono::duration<double, std::milli>(looked - inserted).count());
+            times[2] = std::min(times[2], std::chrono::duration<double, std::milli>(iterated - looked).count());
+        }
+        printf("%-16s %10.3f %10.3f %10.3f\n", name, times[0], times[1], times[2]);
+    };
+
+    std::unordered_map<size_t, KataScript::ValueRef> map;
+    KataScript::Int found = 0;
+    measure("unordered_map",
+        [&] { map = {}; for (auto& key : keys) { map[key.getHash()] = value; } },
+        [&] { for (auto& key : keys) { found += map.find(key.getHash())->second->getInt(); } },
+        [&] { for (auto& item : map) { found += item.second->getInt(); } });
+
+    KataScript::Dictionary dict;
+    measure("dictionary",
+        [&] { dict = {}; for (auto& key : keys) { dict[key] = value; } },
+        [&] { for (auto& key : keys) { found += dict.find(key)->second->getInt(); } },
+        [&] { for (auto& item : dict) { found += item.second->getInt(); } });
+    if (found == 0) {
+        printf("nothing found\n");
+    }
+}
+
+// reading and writing typed array elements in a loop, the time doesn't include making the array
+void arrays() {
+    std::string script = R"--(
+fn fill(arr, n) { for (i = 0; i < n; i++) { arr[i] = i * 0.5; } }
+fn sum(arr, n) { var total = 0.0; for (i = 0; i < n; i++) { total += arr[i]; } return total; }
+fn scale(arr, n) { for (i = 0; i < n; i++) { arr[i] *= 2.0; } }
+)--";
+    printf("%-16s %10s\n", "arrays", "ms");
+    for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+        double best = 1e300;
+        for (int run = 0; run < 5; ++run) {
+            KataScript::KataScriptInterpreter interp;
+            interp.setExecutionEngine(engine);
+            interp.evaluate(script);
+            *interp.resolveVariable(std::string("values")) = KataScript::Value(KataScript::Array(std::vector<KataScript::Float>(100000)));
+            auto start = Clock::now();
+            interp.evaluate("fill(values, 100000); total = sum(values, 100000); scale(values, 100000);");
+            best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        }
+        printf("%-16s %10.3f\n", engine == KataScript::ExecutionEngine::Bytecode ? "bytecode" : "tree walker", best);
+    }
+}
+
+// passing a big list or string to functions that keep a copy, and making class instances that hold the list
+// peak is the most memory held at once during the run, past what was held before it
+void copies() {
+    std::string script = R"--(
+class holder {
+    var items;
+    fn holder(base) { items = base; }
+}
+fn keep(l) { var kept = l; return length(kept); }
+fn passAll(big, n) { var total = 0; for (i = 0; i < n; i++) { total += keep(big); } return total; }
+fn makeHolders(big, n) { var all = list(); for (i = 0; i < n; i++) { pushback(all, holder(big)); } return length(all); }
+)--";
+    KataScript::List items;
+    for (KataScript::Int i = 0; i < 100000; ++i) {
+        items.push_back(KataScript::makeValue(i));
+    }
+    std::pair<const char*, const char*> cases[] = {
+        { "pass list", "passAll(biglist, 1000);" },
+        { "pass string", "passAll(bigstring, 1000);" },
+        { "instances", "makeHolders(biglist, 100);" },
+    };
+    printf("%-16s %10s %10s\n", "copies", "ms", "peak KB");
+    for (auto& [name, call] : cases) {
+        double best = 1e300;
+        size_t peak = 0;
+        for (int run = 0; run < 3; ++run) {
+            KataScript::KataScriptInterpreter interp;
+            interp.evaluate(script);
+            *interp.resolveVariable(std::string("biglist")) = KataScript::Value(items);
+            *interp.resolveVariable(std::string("bigstring")) = KataScript::Value(std::string(1 << 20, 'x'));
+            auto before = liveBytes.load();
+            peakBytes = before;
+            auto start = Clock::now();
+            interp.evaluate(call);
+            best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+            peak = std::max(peak, peakBytes.load() - before);
+        }
+        printf("%-16s %10.3f %10zu\n", name, best, peak / 1024);
+    }
+}
+
+// foreach over a million element array and list, peak is the memory the loop held past what was held before it
+void foreachLoops() {
+    KataScript::List items;
+    for (KataScript::Int i = 0; i < 1000000; ++i) {
+        items.push_back(KataScript::makeValue(i));
+    }
+    std::pair<const char*, KataScript::Value> cases[] = {
+        { "array", KataScript::Value(KataScript::Array(std::vector<KataScript::Int>(1000000, 1))) },
+        { "list", KataScript::Value(items) },
+    };
+    printf("%-16s %10s %10s\n", "foreach", "ms", "peak KB");
+    for (auto& [name, collection] : cases) {
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            double best = 1e300;
+            size_t peak = 0;
+            for (int run = 0; run < 3; ++run) {
+                KataScript::KataScriptInterpreter interp;
+                interp.setExecutionEngine(engine);
+                *interp.resolveVariable(std::string("values")) = collection;
+                auto before = liveBytes.load();
+                peakBytes = before;
+                auto start = Clock::now();
+                interp.evaluate("total = 0; foreach (x; values) { total += x; }");
+                best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+                peak = std::max(peak, peakBytes.load() - before);
+            }
+            auto label = std::string(name) + (engine == KataScript::ExecutionEngine::Bytecode ? " bytecode" : " tree walker");
+            printf("%-16s %10.3f %10zu\n", label.c_str(), best, peak / 1024);
+        }
+    }
+}
+
+// ArrayMath functions over a million floats, as a new array and in place, against the same math in a script loop
+// throughput is millions of elements per second
+void arrayMath() {
+    const size_t count = 1000000;
+    std::vector<KataScript::Float> a(count), b(count);
+    for (size_t i = 0; i < count; ++i) {
+        a[i] = i * 0.001 - 500.0;
+        b[i] = (i % 7) + 0.5;
+    }
+    std::pair<const char*, const char*> cases[] = {
+        { "add", "c = arrayadd(a, b);" },
+        { "add in place", "arrayadd(a, b, true);" },
+        { "mul scalar", "c = arrayscale(a, 0.5);" },
+        { "div", "c = arraydiv(a, b);" },
+        { "fma", "c = arrayfma(a, b, 1.0);" },
+        { "fma in place", "arrayfma(a, b, 1.0, true);" },
+        { "clamp", "c = arrayclamp(a, -1.0, b);" },
+        { "abs", "c = arrayabs(a);" },
+        { "sqrt", "c = arraysqrt(b);" },
+        { "less mask", "c = arrayless(a, b);" },
+        { "sin", "c = arraysin(a);" },
+        { "pow", "c = arraypow(b, 1.5);" },
+    };
+    printf("%-16s %10s %10s\n", "array math", "ms", "Melem/s");
+    for (auto& [name, script] : cases) {
+        double best = 1e300;
+        for (int run = 0; run < 5; ++run) {
+            KataScript::KataScriptInterpreter interp;
+            *interp.resolveVariable(std::string("a")) = KataScript::Value(KataScript::Array(a));
+            *interp.resolveVariable(std::string("b")) = KataScript::Value(KataScript::Array(b));
+            auto start = Clock::now();
+            interp.evaluate(script);
+            best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        }
+        printf("%-16s %10.3f %10.1f\n", name, best, count / best / 1000.0);
+    }
+
+    std::string loop = R"--(
+fn fmaLoop(a, b, c, n) { for (i = 0; i < n; i++) { c[i] = a[i] * b[i] + 1.0; } }
+)--";
+    for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+        double best = 1e300;
+        for (int run = 0; run < 3; ++run) {
+            KataScript::KataScriptInterpreter interp;
+            interp.setExecutionEngine(engine);
+            interp.evaluate(loop);
+            *interp.resolveVariable(std::string("a")) = KataScript::Value(KataScript::Array(a));
+            *interp.resolveVariable(std::string("b")) = KataScript::Value(KataScript::Array(b));
+            *interp.resolveVariable(std::string("c")) = KataScript::Value(KataScript::Array(std::vector<KataScript::Float>(count)));
+            auto start = Clock::now();
+            interp.evaluate("fmaLoop(a, b, c, " + std::to_string(count) + ");");
+            best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        }
+        auto label = std::string("fma loop") + (engine == KataScript::ExecutionEngine::Bytecode ? " bytecode" : " tree walker");
+        printf("%-16s %10.3f %10.1f\n", label.c_str(), best, count / best / 1000.0);
+    }
+}
+
+int main(int argc, char** argv) {
+    std::pair<const char*, void(*)()> benchmarks[] = {
+        { "tokenizer", tokenizer },
+        { "parser", parser },
+        { "programs", programs },
+        { "members", members },
+        { "lazy", lazy },
+        { "imports", imports },
+        { "bundles", bundles },
+        { "dictionaries", dictionaries },
+        { "arrays", arrays },
+        { "copies", copies },
+        { "foreach", foreachLoops },
+        { "arraymath", arrayMath },
+    };
+    for (auto& [name, run] : benchmarks) {
+        if (argc < 2 || strcmp(argv[1], name) == 0) {
+            run();
+        }
+    }
+    return 0;
+}
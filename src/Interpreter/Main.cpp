@@ -20,8 +20,25 @@ int main(int argc, char** argv) {
 	} else if (argc == 2) {
 		// run script from file
         return interp.evaluateFile(std::string(argv[1]));
+	} else if (argc == 3 && std::string(argv[1]) == "--bytecode") {
+		// run script from file on the bytecode engine
+		interp.setExecutionEngine(KataScript::ExecutionEngine::Bytecode);
+		return interp.evaluateFile(std::string(argv[2]));
+	} else if (argc == 3 && std::string(argv[1]) == "--lazy") {
+		// run script from file, parsing function bodies when they are first called
+		interp.setLazyParsing(true);
+		return interp.evaluateFile(std::string(argv[2]));
+	} else if (argc == 4 && std::string(argv[1]) == "--compile") {
+		// save a parsed script, it runs like any other script file
+		return interp.compileFile(std::string(argv[2]), std::string(argv[3]));
+	} else if (argc >= 4 && std::string(argv[1]) == "--bundle") {
+		// pack script files and directories of them into one file
+		return KataScript::writeBundle(std::string(argv[2]), std::vector<std::string>(argv + 3, argv + argc));
+	} else if (argc == 4 && std::string(argv[1]) == "--mount") {
+		// run script from file, its imports are found in the bundle first
+		return interp.mountBundle(std::string(argv[2])) || interp.evaluateFile(std::string(argv[3]));
 	} else {
-		std::cout << "Usage: \n\tKataScript -> Starts Interpreter\n\tKataScript [filepath] -> Execute Script File\n";
+		std::cout << "Usage: \n\tKataScript -> Starts Interpreter\n\tKataScript [filepath] -> Execute Script File\n\tKataScript --bytecode [filepath] -> Execute Script File with the bytecode engine\n\tKataScript --lazy [filepath] -> Execute Script File, parsing function bodies on their first call\n\tKataScript --compile [filepath] [outpath] -> Compile Script File for faster loading\n\tKataScript --bundle [outpath] [filepaths...] -> Pack Script Files and folders into a bundle\n\tKataScript --mount [bundlepath] [filepath] -> Execute Script File, importing from the bundle\n";
 	}
 
 	return 0;
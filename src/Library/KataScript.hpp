@@ -3,18 +3,28 @@
 #pragma once
 
 #include <cstdarg>
+#include <cstring>
 #include <iostream>
 #include <cmath>
 #include <chrono>
 #include <fstream>
 #include <string>
 #include <sstream>
+#include <deque>
 
 #include "exception.hpp"
 #include "stringUtils.hpp"
 #include "types.hpp"
+#include "tokenizer.hpp"
+#include "fileView.hpp"
+#include "copyOnWrite.hpp"
+#include "arrayKernels.hpp"
 #include "value.hpp"
 #include "expressions.hpp"
+#include "bytecode.hpp"
+#include "program.hpp"
+#include "importCache.hpp"
+#include "bundle.hpp"
 #include "scope.hpp"
 #include "modules.hpp"
 
@@ -35,44 +45,138 @@ namespace KataScript {
         expectIfEnd,
         loopCall,
         forEach,
-        importModule
+        importModule,
+        skipFunctionBody
     };
 
     // finally we have our interpereter
     class KataScriptInterpreter {
         friend Expression;
+        friend struct BytecodeCompiler;
         vector<Module> modules;
         vector<Module> optionalModules;
         ScopeRef globalScope = make_shared<Scope>(this);
+        // scopes for function calls and blocks that can be handed out again
+        vector<ScopeRef> freeScopes;
         ScopeRef parseScope = globalScope;
         ExpressionRef currentExpression;
         ExpressionRef previousExpression;
         ValueRef listIndexFunctionVarLocation;
+        ValueRef listLiteralFunctionVarLocation;
         ValueRef identityFunctionVarLocation;
         ValueRef setFunctionVarLocation;
+        // standard library operators without side effects, calls to these on constants can be folded
+        vector<FunctionRef> pureOperators;
+        // the standard library function behind each builtin operator, so a replaced operator is noticed
+        array<FunctionRef, (size_t)BuiltinOperator::Count> builtinOperators;
+        // indexing and the operators that assign to their first argument
+        // an index into an array gets read or written in place when these are still the standard library ones
+        FunctionRef listIndexFunction;
+        vector<FunctionRef> assignmentOperators;
+        bool constantFolding = true;
+        size_t foldedConstants = 0;
+        // top level function bodies are only scanned while parsing, and parsed when first called
+        bool lazyParsing = false;
+        // the body being skipped, and whether it defines something and has to be parsed right away after all
+        shared_ptr<UnparsedBody> skippedBody;
+        size_t skippedBodyLine = 1;
+        bool skippedBodyDefines = false;
 
         ParseState parseState = ParseState::beginExpression;
         vector<string_view> parseStrings;
         int outerNestLayer = 0;
         bool lastStatementClosedScope = false;
         uint64_t currentLine = 0;
+        // line of the token being parsed
+        size_t tokenLine = 1;
         ParseState prevState = ParseState::beginExpression;
         ModulePrivilegeFlags allowedModulePrivileges;
+        ExecutionEngine engine = ExecutionEngine::TreeWalker;
+        // while compiling, top level statements are saved here instead of run
+        ProgramTree* recording = nullptr;
+        // every live program that has run here, loaded into this interpreter
+        unordered_map<uint64_t, LoadedProgram> programs;
+        // parsed imports, possibly shared with other interpreters
+        ImportCacheRef importCache = make_shared<ImportCache>();
+        // the files imported here, an unchanged file imported again where it is still in scope is skipped
+        struct ImportedFile {
+            FileStamp stamp;
+            std::weak_ptr<Scope> scope;
+            ProgramRef program;
+        };
+        unordered_map<string, ImportedFile> importedFiles;
+        // mounted bundles, imports look in these before the disk
+        vector<BundleRef> bundles;
 
-        ReturnResult needsToReturn(ExpressionRef expr, ScopeRef scope, Class* classs);
+        ReturnResult needsToReturn(const ExpressionRef& expr, ScopeRef scope, Class* classs);
         ReturnResult needsToReturn(const vector<ExpressionRef>& subexpressions, ScopeRef scope, Class* classs);
-        ExpressionRef consolidated(ExpressionRef exp, ScopeRef scope, Class* classs);
+        ReturnResult consolidated(const ExpressionRef& exp, ScopeRef scope, Class* classs);
 
         ExpressionRef getResolveVarExpression(const string& name, bool classScope);
         ExpressionRef getExpression(const vector<string_view>& strings, ScopeRef scope, Class* classs);
+        ExpressionRef getOperatorExpression(string_view token, const ValueRef& function);
+        ExpressionRef parseExpression(const vector<string_view>& strings, size_t& i, OperatorPrecedence minPrecedence, ScopeRef scope, Class* classs);
+        ExpressionRef parseOperand(const vector<string_view>& strings, size_t& i, ScopeRef scope, Class* classs);
+        void parseArguments(const vector<string_view>& strings, size_t& i, vector<ExpressionRef>& args, ScopeRef scope, Class* classs);
+        size_t foldConstants(const ExpressionRef& exp);
+        size_t foldCall(const ExpressionRef& exp);
         ValueRef getValue(const vector<string_view>& strings, ScopeRef scope, Class* classs);
         ValueRef getValue(ExpressionRef expr, ScopeRef scope, Class* classs);
+        ValueRef execute(ExpressionRef expr, ScopeRef scope, Class* classs);
 
+        ChunkRef compileExpression(ExpressionRef expr);
+        ChunkRef compileFunction(FunctionRef fnc);
+        ValueRef runChunk(const Chunk& chunk, ScopeRef scope, Class* classs, size_t start = 0, size_t stop = (size_t)-1);
+
+        void resolveSlots(FunctionRef fnc);
+        void finishSkippedBody();
+        void parseSkippedBody(const FunctionRef& fnc);
+        // whether an operator node still calls the standard library function it was parsed with
+        bool isBuiltinOperator(const FunctionExpression& expr) const {
+            auto fnc = std::get_if<FunctionRef>(&expr.function->value);
+            return fnc && *fnc == builtinOperators[(size_t)expr.op];
+        }
+        bool isArrayIndex(const ExpressionRef& exp) const {
+            if (exp->type != ExpressionType::FunctionCall) {
+                return false;
+            }
+            auto& funcExpr = get<FunctionExpression>(exp->expression);
+            auto fnc = std::get_if<FunctionRef>(&funcExpr.function->value);
+            return fnc && *fnc == listIndexFunction && funcExpr.subexpressions.size() == 2;
+        }
+        bool isAssignment(const FunctionRef& fnc) const {
+            return std::find(assignmentOperators.begin(), assignmentOperators.end(), fnc) != assignmentOperators.end();
+        }
+        // which standard library assignment a function still is, if any
+        BuiltinAssignment getBuiltinAssignment(const FunctionRef& fnc) const {
+            auto iter = std::find(assignmentOperators.begin(), assignmentOperators.end(), fnc);
+            if (iter == assignmentOperators.end()) {
+                return BuiltinAssignment::None;
+            }
+            return (BuiltinAssignment)(iter - assignmentOperators.begin());
+        }
+        ValueRef* getVariable(const ExpressionRef& exp, ScopeRef scope);
+        const Value* getImmediate(const ExpressionRef& exp, ScopeRef scope, Class* classs, Value& storage);
+        bool getCondition(const ExpressionRef& exp, ScopeRef scope, Class* classs);
+        const Value& getOperand(const ExpressionRef& exp, ScopeRef scope, Class* classs, ValueRef& ref, Value& storage);
+        FunctionRef resolveFunction(Symbol name, Class* classs, ScopeRef scope, MethodCache& cache);
+        ValueRef* findMember(Symbol name, Class* classs, MemberCache& cache);
         void clearParseStacks();
-        void parse(string_view token);
+        void parse(string_view token, Keyword keyword);
+        bool parseTokens(Tokenizer& tokenizer, bool holdTokens, bool closeDanglingExpressions);
+        void runStatement(ExpressionRef expr);
+        void inheritScope(const string& name);
+        void importModule(const string& name);
+        bool importFile(const string& path);
+        BundleRef findBundled(const string& path, string_view& source) const;
+        void loadProgram(string_view data, ProgramTree& tree);
+        bool runProgram(const ProgramTree& tree);
+        bool evaluateCompiled(string_view data, const string& path);
         
         ScopeRef newClassScope(const string& name, ScopeRef scope);
         void closeScope(ScopeRef& scope);
+        ScopeRef acquireScope(const string& name, ScopeRef scope);
+        void releaseScope(ScopeRef& scope);
         bool closeCurrentExpression();
         FunctionRef newFunction(const string& name, ScopeRef scope, FunctionRef func);
         FunctionRef newFunction(const string& name, ScopeRef scope, const vector<string>& argNames);
@@ -80,6 +184,7 @@ namespace KataScript {
         FunctionRef newConstructor(const string& name, ScopeRef scope, const vector<string>& argNames);
         Module* getOptionalModule(const string& name);
         void createStandardLibrary();
+        void createArrayMathModule();
         void createOptionalModules();
     public:
         ScopeRef insertScope(ScopeRef existing, ScopeRef parent);
@@ -93,6 +198,8 @@ namespace KataScript {
         FunctionRef newFunction(const string& name, ScopeRef scope, const ScopedLambda& lam) { return newFunction(name, scope, make_shared<Function>(name, lam)); }
         FunctionRef newFunction(const string& name, const ScopedLambda& lam) { return newFunction(name, globalScope, lam); }
         FunctionRef newFunction(const string& name, ScopeRef scope, const ClassLambda& lam) { return newFunction(name, scope, make_shared<Function>(name, lam)); }
+        FunctionRef newFunction(const string& name, ScopeRef scope, const LazyLambda& lam) { return newFunction(name, scope, make_shared<Function>(name, lam)); }
+        FunctionRef newFunction(const string& name, const LazyLambda& lam) { return newFunction(name, globalScope, lam); }
         ScopeRef newModule(const string& name, ModulePrivilegeFlags flags, const unordered_map<string, Lambda>& functions);
         ValueRef callFunction(const string& name, ScopeRef scope, const List& args);
         ValueRef callFunction(FunctionRef fnc, ScopeRef scope, const List& args, Class* classs = nullptr);
@@ -101,20 +208,20 @@ namespace KataScript {
         ValueRef callFunction(FunctionRef fnc, const List& args) { return callFunction(fnc, globalScope, args); }
         template <typename ... Ts>
         ValueRef callFunctionWithArgs(FunctionRef fnc, ScopeRef scope, Ts...args) {
-            List argsList = { make_shared<Value>(args)... };
+            List argsList = { makeValue(args)... };
             return callFunction(fnc, scope, argsList);
         }
         template <typename ... Ts>
         ValueRef callFunctionWithArgs(FunctionRef fnc, Ts...args) {
-            List argsList = { make_shared<Value>(args)... };
+            List argsList = { makeValue(args)... };
             return callFunction(fnc, globalScope, argsList);
         }
 
-        ValueRef& resolveVariable(const string& name, Class* classs, ScopeRef scope);
-        ValueRef& resolveVariable(const string& name, ScopeRef scope);
-        FunctionRef resolveFunction(const string& name, Class* classs, ScopeRef scope);
-        FunctionRef resolveFunction(const string& name, ScopeRef scope);
-        ScopeRef resolveScope(const string& name, ScopeRef scope);
+        ValueRef& resolveVariable(Symbol name, Class* classs, ScopeRef scope);
+        ValueRef& resolveVariable(Symbol name, ScopeRef scope);
+        FunctionRef resolveFunction(Symbol name, Class* classs, ScopeRef scope);
+        FunctionRef resolveFunction(Symbol name, ScopeRef scope);
+        ScopeRef resolveScope(Symbol name, ScopeRef scope);
 
         ValueRef resolveVariable(const string& name) { return resolveVariable(name, globalScope); }
         FunctionRef resolveFunction(const string& name) { return resolveFunction(name, globalScope); }
@@ -122,13 +229,34 @@ namespace KataScript {
         
         bool readLine(string_view text);
         bool evaluate(string_view script);
+        bool evaluate(std::istream& script);
         bool evaluateFile(const string& path);
+        ProgramRef compile(string_view script, size_t firstLine = 1);
+        bool run(const Program& program);
+        bool run(const Program& program, ScopeRef scope);
+        bool compileFile(const string& sourcePath, const string& outPath);
+        bool evaluateCompiledFile(const string& path);
         bool readLine(string_view text, ScopeRef scope);
         bool evaluate(string_view script, ScopeRef scope);
+        bool evaluate(std::istream& script, ScopeRef scope);
         bool evaluateFile(const string& path, ScopeRef scope);
         void clearState();
+        void setExecutionEngine(ExecutionEngine e) { engine = e; }
+        ExecutionEngine getExecutionEngine() const { return engine; }
+        void setConstantFolding(bool enabled) { constantFolding = enabled; }
+        bool getConstantFolding() const { return constantFolding; }
+        size_t getFoldedConstantCount() const { return foldedConstants; }
+        size_t getLoadedProgramCount() const { return programs.size(); }
+        void setLazyParsing(bool enabled) { lazyParsing = enabled; }
+        bool getLazyParsing() const { return lazyParsing; }
+        void setImportCache(ImportCacheRef cache) { importCache = cache ? cache : make_shared<ImportCache>(); }
+        ImportCacheRef getImportCache() const { return importCache; }
+        void invalidateImport(const string& path);
+        void invalidateImports();
+        bool mountBundle(const string& path);
+        void unmountBundles() { bundles.clear(); }
         KataScriptInterpreter(ModulePrivilegeFlags priv) : allowedModulePrivileges(priv) 
-            { createStandardLibrary(); if (priv) { createOptionalModules(); } }
+            { createStandardLibrary(); createArrayMathModule(); if (priv) { createOptionalModules(); } }
         KataScriptInterpreter(ModulePrivilege priv) : KataScriptInterpreter(static_cast<ModulePrivilegeFlags>(priv)) { }
         KataScriptInterpreter() : KataScriptInterpreter(ModulePrivilegeFlags()) { }
     };
@@ -141,11 +269,15 @@ namespace KataScript {
 #ifdef KATASCRIPT_IMPL
 
 #include "typeConversion.hpp"
+#include "forEach.hpp"
 #include "parsing.hpp"
 #include "scopeImplementation.hpp"
 #include "functionImplementation.hpp"
 #include "expressionImplementation.hpp"
+#include "bytecodeImplementation.hpp"
 #include "modulesImplementation.hpp"
+#include "arrayMath.hpp"
 #include "optionalModules.hpp"
+#include "programImplementation.hpp"
 
 #endif // KATASCRIPT_IMPL
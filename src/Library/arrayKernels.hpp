@@ -0,0 +1,312 @@
+#pragma once
+
+// sse2 is always there on x64, avx is used when the build targets it, KATASCRIPT_NO_SIMD goes one element at a time everywhere
+#if !defined(KATASCRIPT_NO_SIMD)
+#if defined(__AVX__)
+#define KATASCRIPT_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KATASCRIPT_SSE
+#endif
+#endif
+
+#if defined(KATASCRIPT_AVX) || defined(KATASCRIPT_SSE)
+#include <immintrin.h>
+#endif
+
+namespace KataScript {
+    // element-wise math over whole arrays, the ArrayMath module is built on these
+    // Lanes<T> works on as many elements at once as a register holds, ScalarLanes<T> on one
+    // floats and doubles get sse or avx registers, ints are left to the compiler to vectorize
+
+    enum class CompareOp : uint8_t {
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual,
+        Equal,
+        NotEqual,
+    };
+
+    template <typename T>
+    struct ScalarLanes {
+        using Reg = T;
+        static constexpr size_t width = 1;
+
+        static Reg set(T v) { return v; }
+        static Reg load(const T* p) { return *p; }
+        static void store(T* p, Reg v) { *p = v; }
+        static Reg add(Reg a, Reg b) { return a + b; }
+        static Reg sub(Reg a, Reg b) { return a - b; }
+        static Reg mul(Reg a, Reg b) { return a * b; }
+        static Reg div(Reg a, Reg b) { return a / b; }
+        // picks the same side as the sse instructions when a nan is involved
+        static Reg min(Reg a, Reg b) { return a < b ? a : b; }
+        static Reg max(Reg a, Reg b) { return a > b ? a : b; }
+        static Reg abs(Reg a) {
+            if constexpr (std::is_floating_point_v<T>) {
+                return std::fabs(a);
+            } else {
+                return a < 0 ? -a : a;
+            }
+        }
+        static Reg sqrt(Reg a) { return (Reg)std::sqrt(a); }
+        static Reg fma(Reg a, Reg b, Reg c) {
+#ifdef __FMA__
+            if constexpr (std::is_floating_point_v<T>) {
+                return std::fma(a, b, c);
+            }
+#endif
+            return a * b + c;
+        }
+
+        // a bit per element, set where the comparison holds
+        template <CompareOp Op>
+        static unsigned compare(Reg a, Reg b) {
+            if constexpr (Op == CompareOp::Less) {
+                return a < b;
+            } else if constexpr (Op == CompareOp::LessEqual) {
+                return a <= b;
+            } else if constexpr (Op == CompareOp::Greater) {
+                return a > b;
+            } else if constexpr (Op == CompareOp::GreaterEqual) {
+                return a >= b;
+            } else if constexpr (Op == CompareOp::Equal) {
+                return a == b;
+            } else {
+                return a != b;
+            }
+        }
+    };
+
+    template <typename T>
+    struct Lanes : ScalarLanes<T> {};
+
+#if defined(KATASCRIPT_AVX)
+    template <>
+    struct Lanes<double> {
+        using Reg = __m256d;
+        static constexpr size_t width = 4;
+
+        static Reg set(double v) { return _mm256_set1_pd(v); }
+        static Reg load(const double* p) { return _mm256_loadu_pd(p); }
+        static void store(double* p, Reg v) { _mm256_storeu_pd(p, v); }
+        static Reg add(Reg a, Reg b) { return _mm256_add_pd(a, b); }
+        static Reg sub(Reg a, Reg b) { return _mm256_sub_pd(a, b); }
+        static Reg mul(Reg a, Reg b) { return _mm256_mul_pd(a, b); }
+        static Reg div(Reg a, Reg b) { return _mm256_div_pd(a, b); }
+        static Reg min(Reg a, Reg b) { return _mm256_min_pd(a, b); }
+        static Reg max(Reg a, Reg b) { return _mm256_max_pd(a, b); }
+        static Reg abs(Reg a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+        static Reg sqrt(Reg a) { return _mm256_sqrt_pd(a); }
+        static Reg fma(Reg a, Reg b, Reg c) {
+#ifdef __FMA__
+            return _mm256_fmadd_pd(a, b, c);
+#else
+            return _mm256_add_pd(_mm256_mul_pd(a, b), c);
+#endif
+        }
+
+        template <CompareOp Op>
+        static unsigned compare(Reg a, Reg b) {
+            if constexpr (Op == CompareOp::Less) {
+                return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ));
+            } else if constexpr (Op == CompareOp::LessEqual) {
+                return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LE_OQ));
+            } else if constexpr (Op == CompareOp::Greater) {
+                return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ));
+            } else if constexpr (Op == CompareOp::GreaterEqual) {
+                return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GE_OQ));
+            } else if constexpr (Op == CompareOp::Equal) {
+                return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ));
+            } else {
+                return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_NEQ_UQ));
+            }
+        }
+    };
+
+    template <>
+    struct Lanes<float> {
+        using Reg = __m256;
+        static constexpr size_t width = 8;
+
+        static Reg set(float v) { return _mm256_set1_ps(v); }
+        static Reg load(const float* p) { return _mm256_loadu_ps(p); }
+        static void store(float* p, Reg v) { _mm256_storeu_ps(p, v); }
+        static Reg add(Reg a, Reg b) { return _mm256_add_ps(a, b); }
+        static Reg sub(Reg a, Reg b) { return _mm256_sub_ps(a, b); }
+        static Reg mul(Reg a, Reg b) { return _mm256_mul_ps(a, b); }
+        static Reg div(Reg a, Reg b) { return _mm256_div_ps(a, b); }
+        static Reg min(Reg a, Reg b) { return _mm256_min_ps(a, b); }
+        static Reg max(Reg a, Reg b) { return _mm256_max_ps(a, b); }
+        static Reg abs(Reg a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+        static Reg sqrt(Reg a) { return _mm256_sqrt_ps(a); }
+        static Reg fma(Reg a, Reg b, Reg c) {
+#ifdef __FMA__
+            return _mm256_fmadd_ps(a, b, c);
+#else
+            return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+        }
+
+        template <CompareOp Op>
+        static unsigned compare(Reg a, Reg b) {
+            if constexpr (Op == CompareOp::Less) {
+                return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ));
+            } else if constexpr (Op == CompareOp::LessEqual) {
+                return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ));
+            } else if constexpr (Op == CompareOp::Greater) {
+                return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ));
+            } else if constexpr (Op == CompareOp::GreaterEqual) {
+                return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ));
+            } else if constexpr (Op == CompareOp::Equal) {
+                return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ));
+            } else {
+                return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_NEQ_UQ));
+            }
+        }
+    };
+#elif defined(KATASCRIPT_SSE)
+    template <>
+    struct Lanes<double> {
+        using Reg = __m128d;
+        static constexpr size_t width = 2;
+
+        static Reg set(double v) { return _mm_set1_pd(v); }
+        static Reg load(const double* p) { return _mm_loadu_pd(p); }
+        static void store(double* p, Reg v) { _mm_storeu_pd(p, v); }
+        static Reg add(Reg a, Reg b) { return _mm_add_pd(a, b); }
+        static Reg sub(Reg a, Reg b) { return _mm_sub_pd(a, b); }
+        static Reg mul(Reg a, Reg b) { return _mm_mul_pd(a, b); }
+        static Reg div(Reg a, Reg b) { return _mm_div_pd(a, b); }
+        static Reg min(Reg a, Reg b) { return _mm_min_pd(a, b); }
+        static Reg max(Reg a, Reg b) { return _mm_max_pd(a, b); }
+        static Reg abs(Reg a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+        static Reg sqrt(Reg a) { return _mm_sqrt_pd(a); }
+        static Reg fma(Reg a, Reg b, Reg c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+
+        template <CompareOp Op>
+        static unsigned compare(Reg a, Reg b) {
+            if constexpr (Op == CompareOp::Less) {
+                return _mm_movemask_pd(_mm_cmplt_pd(a, b));
+            } else if constexpr (Op == CompareOp::LessEqual) {
+                return _mm_movemask_pd(_mm_cmple_pd(a, b));
+            } else if constexpr (Op == CompareOp::Greater) {
+                return _mm_movemask_pd(_mm_cmpgt_pd(a, b));
+            } else if constexpr (Op == CompareOp::GreaterEqual) {
+                return _mm_movemask_pd(_mm_cmpge_pd(a, b));
+            } else if constexpr (Op == CompareOp::Equal) {
+                return _mm_movemask_pd(_mm_cmpeq_pd(a, b));
+            } else {
+                return _mm_movemask_pd(_mm_cmpneq_pd(a, b));
+            }
+        }
+    };
+
+    template <>
+    struct Lanes<float> {
+        using Reg = __m128;
+        static constexpr size_t width = 4;
+
+        static Reg set(float v) { return _mm_set1_ps(v); }
+        static Reg load(const float* p) { return _mm_loadu_ps(p); }
+        static void store(float* p, Reg v) { _mm_storeu_ps(p, v); }
+        static Reg add(Reg a, Reg b) { return _mm_add_ps(a, b); }
+        static Reg sub(Reg a, Reg b) { return _mm_sub_ps(a, b); }
+        static Reg mul(Reg a, Reg b) { return _mm_mul_ps(a, b); }
+        static Reg div(Reg a, Reg b) { return _mm_div_ps(a, b); }
+        static Reg min(Reg a, Reg b) { return _mm_min_ps(a, b); }
+        static Reg max(Reg a, Reg b) { return _mm_max_ps(a, b); }
+        static Reg abs(Reg a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+        static Reg sqrt(Reg a) { return _mm_sqrt_ps(a); }
+        static Reg fma(Reg a, Reg b, Reg c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+
+        template <CompareOp Op>
+        static unsigned compare(Reg a, Reg b) {
+            if constexpr (Op == CompareOp::Less) {
+                return _mm_movemask_ps(_mm_cmplt_ps(a, b));
+            } else if constexpr (Op == CompareOp::LessEqual) {
+                return _mm_movemask_ps(_mm_cmple_ps(a, b));
+            } else if constexpr (Op == CompareOp::Greater) {
+                return _mm_movemask_ps(_mm_cmpgt_ps(a, b));
+            } else if constexpr (Op == CompareOp::GreaterEqual) {
+                return _mm_movemask_ps(_mm_cmpge_ps(a, b));
+            } else if constexpr (Op == CompareOp::Equal) {
+                return _mm_movemask_ps(_mm_cmpeq_ps(a, b));
+            } else {
+                return _mm_movemask_ps(_mm_cmpneq_ps(a, b));
+            }
+        }
+    };
+#endif
+
+    // one operand of a kernel, a whole array or a few values repeated along it
+    // a scalar repeats every element, a vec3 laid out as floats repeats every third one
+    template <typename T>
+    struct ArraySource {
+        const T* data = nullptr;
+        // 0 for a whole array, 1 for a scalar, 3 for a vec3
+        size_t period = 0;
+        // the repeated values written out far enough that a register can be loaded from any point in the first period
+        array<T, 16> repeated{};
+
+        ArraySource(const T* values) : data(values) {}
+        ArraySource(const T* values, size_t count) : period(count) {
+            for (size_t i = 0; i < repeated.size(); ++i) {
+                repeated[i] = values[i % count];
+            }
+        }
+
+        T at(size_t i) const {
+            switch (period) {
+            case 0:
+                return data[i];
+            case 1:
+                return repeated[0];
+            default:
+                return repeated[i % 3];
+            }
+        }
+
+        template <typename L>
+        typename L::Reg load(L, size_t i) const {
+            switch (period) {
+            case 0:
+                return L::load(data + i);
+            case 1:
+                return L::set(repeated[0]);
+            default:
+                return L::load(repeated.data() + i % 3);
+            }
+        }
+    };
+
+    // out[i] = f(lanes, i) for every element, a register at a time and then one at a time for what's left
+    // out may be one of the sources, every element is read before it is written
+    template <typename T, typename F>
+    void forEachLane(T* out, size_t count, F&& f) {
+        using L = Lanes<T>;
+        size_t i = 0;
+        for (; i + L::width <= count; i += L::width) {
+            L::store(out + i, f(L(), i));
+        }
+        for (; i < count; ++i) {
+            out[i] = f(ScalarLanes<T>(), i);
+        }
+    }
+
+    // out[i] = 1 where the comparison holds for an element and 0 where it doesn't
+    template <CompareOp Op, typename T, typename M>
+    void compareArrays(const ArraySource<T>& a, const ArraySource<T>& b, M* out, size_t count) {
+        using L = Lanes<T>;
+        size_t i = 0;
+        for (; i + L::width <= count; i += L::width) {
+            auto bits = L::template compare<Op>(a.load(L(), i), b.load(L(), i));
+            for (size_t k = 0; k < L::width; ++k) {
+                out[i + k] = (M)((bits >> k) & 1);
+            }
+        }
+        for (; i < count; ++i) {
+            out[i] = (M)ScalarLanes<T>::template compare<Op>(a.at(i), b.at(i));
+        }
+    }
+}
@@ -0,0 +1,301 @@
+#pragma once
+#include "KataScript.hpp"
+
+namespace KataScript {
+    static_assert(sizeof(vec3) == 3 * sizeof(float), "vec3 arrays are handed to the kernels as floats");
+
+    // the kernels see vec3s as three floats each
+    template <typename E>
+    using FlatNumber = std::conditional_t<std::is_same_v<E, vec3>, float, E>;
+
+    template <typename E>
+    constexpr Type numberType() {
+        if constexpr (std::is_same_v<E, Int>) {
+            return Type::Int;
+        } else if constexpr (std::is_same_v<E, Float>) {
+            return Type::Float;
+        } else {
+            return Type::Vec3;
+        }
+    }
+
+    template <typename E, typename N>
+    E convertNumber(N n) {
+        if constexpr (std::is_same_v<E, vec3>) {
+            return vec3((float)n);
+        } else {
+            return (E)n;
+        }
+    }
+
+    // the type an ArrayMath function works in, the widest of its operands like the scalar operators use
+    inline Type arrayMathType(const string& name, const List& args, size_t operands, Type minimum) {
+        auto type = minimum;
+        for (size_t i = 0; i < operands; ++i) {
+            auto& val = std::as_const(*args[i]);
+            auto t = val.getType() == Type::Array ? val.getArray().getType() : val.getType();
+            if (t != Type::Int && t != Type::Float && t != Type::Vec3) {
+                throw Exception(name + " only works on numbers, not `" + getTypeName(t) + "`");
+            }
+            type = max(type, t);
+        }
+        return type;
+    }
+
+    // one operand read as Es, an array of Es is used where it is and anything else is converted into storage
+    template <typename E>
+    ArraySource<FlatNumber<E>> arrayMathSource(const string& name, const Value& val, size_t count, vector<E>& storage) {
+        using F = FlatNumber<E>;
+        if (val.getType() == Type::Array) {
+            auto& arr = val.getArray();
+            if (arr.size() != count) {
+                throw Exception(name + " needs arrays of the same length, got "s + std::to_string(count) + " and " + std::to_string(arr.size()));
+            }
+            if (arr.getType() == numberType<E>()) {
+                return ArraySource<F>((const F*)arr.getStdVector<E>().data());
+            }
+            storage.reserve(count);
+            if (arr.getType() == Type::Int) {
+                for (auto n : arr.getStdVector<Int>()) {
+                    storage.push_back(convertNumber<E>(n));
+                }
+            } else {
+                for (auto n : arr.getStdVector<Float>()) {
+                    storage.push_back(convertNumber<E>(n));
+                }
+            }
+            return ArraySource<F>((const F*)storage.data());
+        }
+        E scalar{};
+        switch (val.getType()) {
+        case Type::Int:
+            scalar = convertNumber<E>(val.getInt());
+            break;
+        case Type::Float:
+            scalar = convertNumber<E>(val.getFloat());
+            break;
+        default:
+            if constexpr (std::is_same_v<E, vec3>) {
+                scalar = val.getVec3();
+            }
+            break;
+        }
+        return ArraySource<F>((const F*)&scalar, sizeof(E) / sizeof(F));
+    }
+
+    // reads the operands of an ArrayMath function and calls f(element, sources, args) in the type they work in
+    // the first operand has to be an array and sets the length, array members are read as their values
+    template <typename F>
+    ValueRef withArrayMathSources(const string& name, const List& arguments, size_t operands, Type minimum, F&& f) {
+        if (arguments.size() < operands) {
+            return makeNull();
+        }
+        List args = arguments;
+        for (auto& arg : args) {
+            if (arg->getType() == Type::ArrayMember) {
+                arg = arg->getArrayMember().getValue();
+            }
+        }
+        if (args[0]->getType() != Type::Array) {
+            throw Exception(name + " needs an array first, not `" + getTypeName(args[0]->getType()) + "`");
+        }
+        auto count = std::as_const(*args[0]).getArray().size();
+
+        auto run = [&](auto element) -> ValueRef {
+            using E = decltype(element);
+            vector<vector<E>> storage(operands);
+            vector<ArraySource<FlatNumber<E>>> sources;
+            sources.reserve(operands);
+            for (size_t i = 0; i < operands; ++i) {
+                sources.push_back(arrayMathSource<E>(name, *args[i], count, storage[i]));
+            }
+            return f(element, sources, args);
+        };
+        switch (arrayMathType(name, args, operands, minimum)) {
+        case Type::Int:
+            return run(Int());
+        case Type::Float:
+            return run(Float());
+        default:
+            return run(vec3());
+        }
+    }
+
+    // runs kernel(out, flat element count, sources) into a new array
+    // one more truthy argument after the operands writes the result back into the first one instead
+    template <typename Kernel>
+    ValueRef arrayMath(const string& name, const List& arguments, size_t operands, Type minimum, Kernel&& kernel) {
+        return withArrayMathSources(name, arguments, operands, minimum, [&](auto element, auto& sources, List& args) -> ValueRef {
+            using E = decltype(element);
+            using F = FlatNumber<E>;
+            auto count = std::as_const(*args[0]).getArray().size();
+            auto flatCount = count * (sizeof(E) / sizeof(F));
+            bool inPlace = args.size() > sources.size() && args[sources.size()]->getBool();
+            // sources pointing into the first array keep its old data alive if writing to it has to copy
+            if (inPlace && std::as_const(*args[0]).getArray().getType() == numberType<E>()) {
+                kernel((F*)args[0]->getStdVector<E>().data(), flatCount, sources);
+                return args[0];
+            }
+            vector<E> out(count);
+            kernel((F*)out.data(), flatCount, sources);
+            if (inPlace) {
+                *args[0] = Value(Array(std::move(out)));
+                return args[0];
+            }
+            return makeValue(Array(std::move(out)));
+        });
+    }
+
+    // compares two operands element by element into an int array of 1s and 0s
+    template <CompareOp Op>
+    ValueRef arrayMask(const string& name, const List& arguments) {
+        return withArrayMathSources(name, arguments, 2, Type::Int, [&](auto element, auto& sources, List& args) -> ValueRef {
+            using E = decltype(element);
+            if constexpr (std::is_same_v<E, vec3>) {
+                throw Exception(name + " doesn't compare vec3s");
+            } else {
+                vector<Int> mask(std::as_const(*args[0]).getArray().size());
+                compareArrays<Op>(sources[0], sources[1], mask.data(), mask.size());
+                return makeValue(Array(std::move(mask)));
+            }
+        });
+    }
+
+    void KataScriptInterpreter::createArrayMathModule() {
+        newModule("ArrayMath"s, 0, {
+            {"arrayadd", [](const List& args) {
+                return arrayMath("arrayadd", args, 2, Type::Int, [](auto* out, size_t count, auto& sources) {
+                    auto& a = sources[0];
+                    auto& b = sources[1];
+                    forEachLane(out, count, [&](auto L, size_t i) { return L.add(a.load(L, i), b.load(L, i)); });
+                });
+                }},
+
+            {"arraysub", [](const List& args) {
+                return arrayMath("arraysub", args, 2, Type::Int, [](auto* out, size_t count, auto& sources) {
+                    auto& a = sources[0];
+                    auto& b = sources[1];
+                    forEachLane(out, count, [&](auto L, size_t i) { return L.sub(a.load(L, i), b.load(L, i)); });
+                });
+                }},
+
+            {"arraymul", [](const List& args) {
+                return arrayMath("arraymul", args, 2, Type::Int, [](auto* out, size_t count, auto& sources) {
+                    auto& a = sources[0];
+                    auto& b = sources[1];
+                    forEachLane(out, count, [&](auto L, size_t i) { return L.mul(a.load(L, i), b.load(L, i)); });
+                });
+                }},
+
+            {"arraydiv", [](const List& args) {
+                return arrayMath("arraydiv", args, 2, Type::Int, [](auto* out, size_t count, auto& sources) {
+                    auto& a = sources[0];
+                    auto& b = sources[1];
+                    if constexpr (std::is_integral_v<std::remove_pointer_t<decltype(out)>>) {
+                        for (size_t i = 0; i < count; ++i) {
+                            if (b.at(i) == 0) {
+                                throw Exception("arraydiv divides an int by 0"s);
+                            }
+                        }
+                    }
+                    forEachLane(out, count, [&](auto L, size_t i) { return L.div(a.load(L, i), b.load(L, i)); });
+                });
+                }},
+
+            {"arrayfma", [](const List& args) {
+                return arrayMath("arrayfma", args, 3, Type::Int, [](auto* out, size_t count, auto& sources) {
+                    auto& a = sources[0];
+                    auto& b = sources[1];
+                    auto& c = sources[2];
+                    forEachLane(out, count, [&](auto L, size_t i) { return L.fma(a.load(L, i), b.load(L, i), c.load(L, i)); });
+                });
+                }},
+
+            {"arrayscale", [](const List& args) {
+                if (args.size() >= 2 && args[1]->getType() == Type::Array) {
+                    throw Exception("arrayscale takes a number to scale by, use arraymul for two arrays"s);
+                }
+                return arrayMath("arrayscale", args, 2, Type::Int, [](auto* out, size_t count, auto& sources) {
+                    auto& a = sources[0];
+                    auto& s = sources[1];
+                    forEachLane(out, count, [&](auto L, size_t i) { return L.mul(a.load(L, i), s.load(L, i)); });
+                });
+                }},
+
+            {"arrayclamp", [](const List& args) {
+                return arrayMath("arrayclamp", args, 3, Type::Int, [](auto* out, size_t count, auto& sources) {
+                    auto& a = sources[0];
+                    auto& lo = sources[1];
+                    auto& hi = sources[2];
+                    forEachLane(out, count, [&](auto L, size_t i) { return L.min(L.max(a.load(L, i), lo.load(L, i)), hi.load(L, i)); });
+                });
+                }},
+
+            {"arrayabs", [](const List& args) {
+                return arrayMath("arrayabs", args, 1, Type::Int, [](auto* out, size_t count, auto& sources) {
+                    auto& a = sources[0];
+                    forEachLane(out, count, [&](auto L, size_t i) { return L.abs(a.load(L, i)); });
+                });
+                }},
+
+            {"arraysqrt", [](const List& args) {
+                return arrayMath("arraysqrt", args, 1, Type::Float, [](auto* out, size_t count, auto& sources) {
+                    auto& a = sources[0];
+                    forEachLane(out, count, [&](auto L, size_t i) { return L.sqrt(a.load(L, i)); });
+                });
+                }},
+
+            // there are no sse or avx instructions for these, so they go an element at a time
+            {"arraysin", [](const List& args) {
+                return arrayMath("arraysin", args, 1, Type::Float, [](auto* out, size_t count, auto& sources) {
+                    using F = std::remove_pointer_t<decltype(out)>;
+                    for (size_t i = 0; i < count; ++i) {
+                        out[i] = (F)sin(sources[0].at(i));
+                    }
+                });
+                }},
+
+            {"arraycos", [](const List& args) {
+                return arrayMath("arraycos", args, 1, Type::Float, [](auto* out, size_t count, auto& sources) {
+                    using F = std::remove_pointer_t<decltype(out)>;
+                    for (size_t i = 0; i < count; ++i) {
+                        out[i] = (F)cos(sources[0].at(i));
+                    }
+                });
+                }},
+
+            {"arraypow", [](const List& args) {
+                return arrayMath("arraypow", args, 2, Type::Float, [](auto* out, size_t count, auto& sources) {
+                    using F = std::remove_pointer_t<decltype(out)>;
+                    for (size_t i = 0; i < count; ++i) {
+                        out[i] = (F)pow(sources[0].at(i), sources[1].at(i));
+                    }
+                });
+                }},
+
+            {"arrayless", [](const List& args) {
+                return arrayMask<CompareOp::Less>("arrayless", args);
+                }},
+
+            {"arraylessequal", [](const List& args) {
+                return arrayMask<CompareOp::LessEqual>("arraylessequal", args);
+                }},
+
+            {"arraygreater", [](const List& args) {
+                return arrayMask<CompareOp::Greater>("arraygreater", args);
+                }},
+
+            {"arraygreaterequal", [](const List& args) {
+                return arrayMask<CompareOp::GreaterEqual>("arraygreaterequal", args);
+                }},
+
+            {"arrayequal", [](const List& args) {
+                return arrayMask<CompareOp::Equal>("arrayequal", args);
+                }},
+
+            {"arraynotequal", [](const List& args) {
+                return arrayMask<CompareOp::NotEqual>("arraynotequal", args);
+                }},
+        });
+    }
+}
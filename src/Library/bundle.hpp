@@ -0,0 +1,149 @@
+#pragma once
+
+namespace KataScript {
+    // a bundle is many script files in one, so importing them takes a single mapping instead of a file each
+    // layout: magic, version, file count, then path, offset and size of every file sorted by path, then the sources
+    constexpr char BundleMagic[4] = { '\0', 'K', 'S', 'B' };
+    constexpr uint32_t BundleFormatVersion = 1;
+
+    // the name a file goes by inside a bundle, the path it's imported with written the same way every time
+    inline string bundlePath(const string& path) {
+        auto normal = std::filesystem::path(path).lexically_normal().generic_string();
+        if (normal.starts_with("./")) {
+            normal.erase(0, 2);
+        }
+        return normal;
+    }
+
+    class Bundle {
+        FileView file;
+        // path and source of every file, in the order they are stored
+        vector<std::pair<string_view, string_view>> index;
+        size_t position = 0;
+
+        string_view take(size_t size) {
+            auto data = file.data();
+            if (size > data.size() - position) {
+                throw Exception("Bundle ends early");
+            }
+            auto bytes = data.substr(position, size);
+            position += size;
+            return bytes;
+        }
+
+        template <typename T>
+        T read() {
+            T value;
+            std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+            return value;
+        }
+
+    public:
+        // the bundle file as it was when it was mounted, its files are cached as imports under this path
+        FileStamp stamp;
+
+        Bundle(const string& path) : file(path, true) {
+            if (!file.isOpen() || !FileStamp::get(path, stamp)) {
+                throw Exception("Bundle "s + path + " not found");
+            }
+            if (!file.data().starts_with(string_view(BundleMagic, sizeof(BundleMagic)))) {
+                throw Exception(path + " is not a bundle");
+            }
+            position = sizeof(BundleMagic);
+            auto version = read<uint32_t>();
+            if (version != BundleFormatVersion) {
+                throw Exception("Bundle "s + path + " has format version " + std::to_string(version));
+            }
+            // every entry has at least its path size, offset and size, so a count the index can't hold is never allocated
+            auto count = read<uint32_t>();
+            if (count > (file.data().size() - position) / (sizeof(uint32_t) + sizeof(uint64_t) * 2)) {
+                throw Exception("Bundle ends early");
+            }
+            index.resize(count);
+            for (auto& entry : index) {
+                entry.first = take(read<uint32_t>());
+                auto offset = read<uint64_t>();
+                auto size = read<uint64_t>();
+                if (offset > file.data().size() || size > file.data().size() - offset) {
+                    throw Exception("Bundle "s + path + " has a file past its end");
+                }
+                entry.second = file.data().substr(offset, size);
+            }
+            if (!std::is_sorted(index.begin(), index.end())) {
+                std::sort(index.begin(), index.end());
+            }
+        }
+
+        // the source of a file in the bundle, false if it isn't in here
+        bool find(const string& path, string_view& source) const {
+            auto iter = std::lower_bound(index.begin(), index.end(), string_view(path), [](const auto& entry, string_view p) { return entry.first < p; });
+            if (iter == index.end() || iter->first != path) {
+                return false;
+            }
+            source = iter->second;
+            return true;
+        }
+
+        size_t size() const { return index.size(); }
+    };
+
+    using BundleRef = shared_ptr<Bundle>;
+
+    // write script files into a bundle, directories add every .ks file inside them
+    // returns true on error, like the interpreter's file functions
+    inline bool writeBundle(const string& outPath, const vector<string>& inputs) {
+        vector<string> paths;
+        for (auto& input : inputs) {
+            std::error_code error;
+            if (std::filesystem::is_directory(input, error)) {
+                for (auto& entry : std::filesystem::recursive_directory_iterator(input, error)) {
+                    if (entry.is_regular_file() && entry.path().extension() == ".ks") {
+                        paths.push_back(entry.path().string());
+                    }
+                }
+            } else {
+                paths.push_back(input);
+            }
+        }
+
+        vector<std::pair<string, string>> files;
+        for (auto& path : paths) {
+            FileView file(path, true);
+            if (!file.isOpen()) {
+                printf("file: %s not found\n", path.c_str());
+                return true;
+            }
+            files.emplace_back(bundlePath(path), string(file.data()));
+        }
+        std::sort(files.begin(), files.end());
+        files.erase(std::unique(files.begin(), files.end(), [](const auto& a, const auto& b) { return a.first == b.first; }), files.end());
+
+        auto out = std::ofstream(outPath, std::ios::binary);
+        if (!out) {
+            printf("file: %s could not be written\n", outPath.c_str());
+            return true;
+        }
+        auto write = [&out](auto value) {
+            out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        };
+        // sources start right after the index
+        uint64_t offset = sizeof(BundleMagic) + sizeof(uint32_t) * 2;
+        for (auto& file : files) {
+            offset += sizeof(uint32_t) + file.first.size() + sizeof(uint64_t) * 2;
+        }
+        out.write(BundleMagic, sizeof(BundleMagic));
+        write(BundleFormatVersion);
+        write((uint32_t)files.size());
+        for (auto& file : files) {
+            write((uint32_t)file.first.size());
+            out.write(file.first.data(), file.first.size());
+            write(offset);
+            write((uint64_t)file.second.size());
+            offset += file.second.size();
+        }
+        for (auto& file : files) {
+            out.write(file.second.data(), file.second.size());
+        }
+        return false;
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include "types.hpp"
+#include "expressions.hpp"
+
+namespace KataScript {
+    // which engine runs parsed expressions
+    enum class ExecutionEngine : uint8_t {
+        TreeWalker,
+        Bytecode
+    };
+
+    // opcodes for the bytecode engine
+    // each instruction is an opcode with a flag byte and two operands
+    enum class OpCode : uint8_t {
+        PushNull,
+        PushConstant,   // push a fresh copy of constants[a]
+        PushFolded,     // push a fresh copy of constants[a] and jump to folds[b].end while its operators are unchanged,
+                        // otherwise run the call it was folded from, which follows
+        PushValue,      // push the shared value values[a]
+        ResolveVar,     // push the variable names[a]
+        DefineVar,      // define names[a] in the current scope, from the popped value if flags is set
+        ResolveSlot,    // push frame slot a, or the variable names[b] outside of a frame
+        DefineSlot,     // define frame slot a, or names[b] outside of a frame, from the popped value if flags is set
+        MemberVariable, // resolve names[a] on the popped object, or on the current class if flags is unset
+        MemberSlot,     // resolve names[a] on the current class, falling back to frame slot b
+        Call,           // call the function held by values[a] with b popped arguments
+        Operator,       // apply builtin operator flags to two popped arguments, or call values[a] if it was replaced
+                        // operands marked in b are an array and an index to read, indexed with values[a + 1]
+        Index,          // pop an index and a collection and push the element, calling values[a] unless it's still listindex
+        AssignElement,  // call values[a] with b arguments where the first is an element, indexed with values[a + 1]
+                        // the collection and the index are under the other arguments, an array element is stored back after the call
+        ResolveFunction,// push the variable names[a], which has to hold something callable
+        CallIndirect,   // pop b arguments and then a callee and call it
+        LazyCall,       // if the callee on the stack is lazy, call it with thunks over the argument code in lazyArgs[a] and skip past it
+        CallMember,     // pop b arguments and then an object and call its member names[a]
+        Pop,
+        Jump,           // jump to a
+        JumpIfFalse,    // pop a value and jump to a if it is falsy
+        PushScope,      // open a new scope named names[a]
+        PopScope,       // forget frame slots a up to b and close the current scope
+        ForEachBegin,   // pop a collection, the key variable when a is set, and the loop variable, then start iterating
+        ForEachNext,    // assign the next element and its key to the loop variables or jump to a when done
+        ForEachEnd,
+        Return          // pop a value and return it
+    };
+
+    // flags for call instructions
+    constexpr uint8_t KeepFirstArrayMember = 1;
+    // the function was a builtin assignment when compiled, it's applied in place for as long as it still is one
+    constexpr uint8_t AssignInPlace = 2;
+
+    // operands of an operator instruction that are read straight out of an array
+    constexpr uint32_t ElementOperandA = 1;
+    constexpr uint32_t ElementOperandB = 2;
+
+    struct Instruction {
+        OpCode op;
+        uint8_t flags = 0;
+        uint32_t a = 0;
+        uint32_t b = 0;
+    };
+
+    // the operators a folded constant depends on, and where the code for its unfolded call ends
+    struct FoldedCode {
+        vector<FoldedOperator> operators;
+        uint32_t end = 0;
+    };
+
+    // an entry on the bytecode stack
+    // temporaries like constants and operator results are immediates, and a variable is pushed as the place it lives in,
+    // so reading one or assigning to it in place doesn't copy its handle, which would box an immediate
+    struct StackValue {
+        ValueRef ref;
+        // the variable this entry stands for, until something needs a handle of its own
+        ValueRef* place = nullptr;
+
+        StackValue() = default;
+        StackValue(ValueRef r) : ref(std::move(r)) {}
+        explicit StackValue(Value v) : ref(makeImmediate(std::move(v))) {}
+
+        static StackValue variable(ValueRef& var) {
+            StackValue entry;
+            entry.place = &var;
+            return entry;
+        }
+
+        Value& operator*() const { return place ? **place : *ref; }
+        Value* operator->() const { return &**this; }
+
+        // the handle to hand out, a variable is copied out of its place so it shares its value from then on
+        ValueRef& shared() {
+            if (place) {
+                ref = *place;
+                place = nullptr;
+            }
+            return ref;
+        }
+
+        // a new value holding a copy, an immediate is moved instead since nothing else can see it
+        ValueRef copied() {
+            if (!place && ref.isImmediate()) {
+                return std::move(ref);
+            }
+            return makeImmediate(**this);
+        }
+    };
+
+    // a compiled, linear version of one or more expression trees
+    // chunks are always shared, lazy arguments keep the one their code is in alive
+    struct Chunk : std::enable_shared_from_this<Chunk> {
+        vector<Instruction> code;
+        vector<Value> constants;
+        vector<FoldedCode> folds;
+        vector<ValueRef> values;
+        vector<Symbol> names;
+        // where each argument's code starts, plus where the last one ends, for calls that may be lazy
+        vector<vector<uint32_t>> lazyArgs;
+        // lookup caches for member calls and member variables, one per entry in names
+        mutable vector<MethodCache> methodCaches;
+        mutable vector<MemberCache> memberCaches;
+        // how many top level statements went into this chunk, for function bodies
+        size_t statementCount = 0;
+    };
+}
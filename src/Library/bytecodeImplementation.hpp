@@ -0,0 +1,792 @@
+#pragma once
+#include "KataScript.hpp"
+
+namespace KataScript {
+    // things the compiler has opened that a jump out of a block needs to close again
+    enum class ControlEntry : uint8_t {
+        Scope,
+        ForEach
+    };
+
+    struct OpenControl {
+        ControlEntry type;
+        // the frame slots a scope declares
+        uint32_t firstSlot = 0;
+        uint32_t endSlot = 0;
+
+        OpenControl(ControlEntry t, size_t first = 0, size_t end = 0) 
+            : type(t), firstSlot((uint32_t)first), endSlot((uint32_t)end) {}
+    };
+
+    struct LoopContext {
+        size_t controlDepth;
+        vector<size_t> breakJumps;
+        vector<size_t> continueJumps;
+
+        LoopContext(size_t depth) : controlDepth(depth) {}
+    };
+
+    // turns expression trees into a flat list of instructions
+    struct BytecodeCompiler {
+        Chunk& chunk;
+        const KataScriptInterpreter& interp;
+        ValueRef setFunction;
+        // constructors keep running after a return, it only leaves the current statement
+        bool returnExitsStatement = false;
+        vector<OpenControl> control;
+        vector<LoopContext> loops;
+        vector<size_t> statementExits;
+        unordered_map<Symbol, uint32_t> nameIndices;
+
+        BytecodeCompiler(Chunk& c, const KataScriptInterpreter& i, bool exitOnReturn)
+            : chunk(c), interp(i), setFunction(i.setFunctionVarLocation), returnExitsStatement(exitOnReturn) {}
+
+        size_t emit(OpCode op, uint32_t a = 0, uint32_t b = 0, uint8_t flags = 0) {
+            chunk.code.push_back(Instruction{ op, flags, a, b });
+            return chunk.code.size() - 1;
+        }
+
+        uint32_t name(Symbol n) {
+            auto iter = nameIndices.find(n);
+            if (iter != nameIndices.end()) {
+                return iter->second;
+            }
+            chunk.names.push_back(n);
+            return nameIndices[n] = (uint32_t)(chunk.names.size() - 1);
+        }
+
+        uint32_t value(ValueRef val) {
+            chunk.values.push_back(val);
+            return (uint32_t)(chunk.values.size() - 1);
+        }
+
+        uint32_t here() {
+            return (uint32_t)chunk.code.size();
+        }
+
+        void patch(size_t at) {
+            chunk.code[at].a = here();
+        }
+
+        void patch(const vector<size_t>& jumps) {
+            for (auto j : jumps) {
+                patch(j);
+            }
+        }
+
+        // close everything opened above the given depth, without forgetting it at compile time
+        void unwindTo(size_t depth) {
+            for (auto i = control.size(); i > depth; --i) {
+                auto& entry = control[i - 1];
+                if (entry.type == ControlEntry::Scope) {
+                    emit(OpCode::PopScope, entry.firstSlot, entry.endSlot);
+                } else {
+                    emit(OpCode::ForEachEnd);
+                }
+            }
+        }
+
+        void exitStatement() {
+            unwindTo(0);
+            statementExits.push_back(emit(OpCode::Jump));
+        }
+
+        // a statement in a block leaves nothing on the stack
+        void compileStatement(const ExpressionRef& exp) {
+            if (!exp) {
+                return;
+            }
+            switch (exp->type) {
+            case ExpressionType::Return:
+                compileExpression(get<Return>(exp->expression).expression);
+                if (returnExitsStatement) {
+                    emit(OpCode::Pop);
+                    exitStatement();
+                } else {
+                    emit(OpCode::Return);
+                }
+                break;
+            case ExpressionType::Break:
+                if (loops.size()) {
+                    unwindTo(loops.back().controlDepth);
+                    loops.back().breakJumps.push_back(emit(OpCode::Jump));
+                } else {
+                    exitStatement();
+                }
+                break;
+            case ExpressionType::Continue:
+                if (loops.size()) {
+                    unwindTo(loops.back().controlDepth);
+                    loops.back().continueJumps.push_back(emit(OpCode::Jump));
+                } else {
+                    exitStatement();
+                }
+                break;
+            default:
+                compileExpression(exp);
+                emit(OpCode::Pop);
+                break;
+            }
+        }
+
+        void compileStatements(const vector<ExpressionRef>& subs) {
+            for (auto&& sub : subs) {
+                compileStatement(sub);
+            }
+        }
+
+        void compileArgs(const vector<ExpressionRef>& subs, size_t first = 0) {
+            for (auto i = first; i < subs.size(); ++i) {
+                compileExpression(subs[i]);
+            }
+        }
+
+        // the callee is already on the stack, the arguments are only run here if it isn't lazy
+        void compileMaybeLazyCall(const vector<ExpressionRef>& subs, size_t first) {
+            chunk.lazyArgs.emplace_back();
+            auto index = chunk.lazyArgs.size() - 1;
+            emit(OpCode::LazyCall, (uint32_t)index);
+            vector<uint32_t> bounds;
+            for (auto i = first; i < subs.size(); ++i) {
+                bounds.push_back(here());
+                compileExpression(subs[i]);
+            }
+            bounds.push_back(here());
+            chunk.lazyArgs[index] = std::move(bounds);
+            emit(OpCode::CallIndirect, 0, (uint32_t)(subs.size() - first));
+        }
+
+        // an expression always leaves exactly one value on the stack
+        void compileExpression(const ExpressionRef& exp) {
+            if (!exp) {
+                emit(OpCode::PushNull);
+                return;
+            }
+            switch (exp->type) {
+            case ExpressionType::Constant: {
+                auto& constant = get<Constant>(exp->expression);
+                chunk.constants.push_back(constant.val);
+                if (!constant.unfolded) {
+                    emit(OpCode::PushConstant, (uint32_t)(chunk.constants.size() - 1));
+                    break;
+                }
+                auto fold = (uint32_t)chunk.folds.size();
+                chunk.folds.push_back(FoldedCode{ constant.operators });
+                emit(OpCode::PushFolded, (uint32_t)(chunk.constants.size() - 1), fold);
+                compileExpression(constant.unfolded);
+                chunk.folds[fold].end = here();
+            }
+                break;
+            case ExpressionType::Value:
+                emit(OpCode::PushValue, value(get<ValueRef>(exp->expression)));
+                break;
+            case ExpressionType::ResolveVar: {
+                auto& resolveVar = get<ResolveVar>(exp->expression);
+                if (resolveVar.slot != NoSlot) {
+                    emit(OpCode::ResolveSlot, (uint32_t)resolveVar.slot, name(resolveVar.name));
+                } else {
+                    emit(OpCode::ResolveVar, name(resolveVar.name));
+                }
+            }
+                break;
+            case ExpressionType::DefineVar: {
+                auto& def = get<DefineVar>(exp->expression);
+                if (def.slot != NoSlot) {
+                    // the slot exists while its value is computed
+                    emit(OpCode::ResolveSlot, (uint32_t)def.slot, name(def.name));
+                    emit(OpCode::Pop);
+                }
+                if (def.defineExpression) {
+                    compileExpression(def.defineExpression);
+                }
+                if (def.slot != NoSlot) {
+                    emit(OpCode::DefineSlot, (uint32_t)def.slot, name(def.name), def.defineExpression ? 1 : 0);
+                } else {
+                    emit(OpCode::DefineVar, name(def.name), 0, def.defineExpression ? 1 : 0);
+                }
+            }
+                break;
+            case ExpressionType::FunctionDef:
+                emit(OpCode::PushValue, value(get<FunctionExpression>(exp->expression).function));
+                break;
+            case ExpressionType::MemberVariable: {
+                auto& expr = get<MemberVariable>(exp->expression);
+                if (expr.object) {
+                    compileExpression(expr.object);
+                } else if (expr.slot != NoSlot) {
+                    emit(OpCode::MemberSlot, name(expr.name), (uint32_t)expr.slot);
+                    break;
+                }
+                emit(OpCode::MemberVariable, name(expr.name), 0, expr.object ? 1 : 0);
+            }
+                break;
+            case ExpressionType::MemberFunctionCall: {
+                auto& expr = get<MemberFunctionCall>(exp->expression);
+                compileExpression(expr.object);
+                compileArgs(expr.subexpressions);
+                emit(OpCode::CallMember, name(expr.functionName), (uint32_t)expr.subexpressions.size());
+            }
+                break;
+            case ExpressionType::FunctionCall: {
+                auto& funcExpr = get<FunctionExpression>(exp->expression);
+                auto& subs = funcExpr.subexpressions;
+                if (funcExpr.function->getType() == Type::String) {
+                    emit(OpCode::ResolveFunction, name(funcExpr.function->getString()));
+                    compileMaybeLazyCall(subs, 0);
+                } else if (funcExpr.function->getType() == Type::Null && subs.size()) {
+                    // the first subexpression produces the function to call
+                    compileExpression(subs.front());
+                    compileMaybeLazyCall(subs, 1);
+                } else if (funcExpr.function->getType() == Type::Function 
+                    && funcExpr.function->getFunction()->getBodyType() == FunctionBodyType::LazyLambda) {
+                    emit(OpCode::PushValue, value(funcExpr.function));
+                    compileMaybeLazyCall(subs, 0);
+                } else if (interp.isArrayIndex(exp)) {
+                    compileArgs(subs);
+                    emit(OpCode::Index, value(funcExpr.function));
+                } else if (funcExpr.op != BuiltinOperator::None && subs.size() == 2) {
+                    // array elements are read by the operator itself, so they never need a value of their own
+                    uint32_t elements = 0;
+                    ValueRef listIndex;
+                    for (size_t i = 0; i < 2; ++i) {
+                        if (interp.isArrayIndex(subs[i])) {
+                            auto& index = get<FunctionExpression>(subs[i]->expression);
+                            compileArgs(index.subexpressions);
+                            listIndex = index.function;
+                            elements |= i ? ElementOperandB : ElementOperandA;
+                        } else {
+                            compileExpression(subs[i]);
+                        }
+                    }
+                    emit(OpCode::Operator, value(funcExpr.function), elements, (uint8_t)funcExpr.op);
+                    if (elements) {
+                        value(listIndex);
+                    }
+                } else if (subs.size() && funcExpr.function->getType() == Type::Function
+                    && interp.isAssignment(funcExpr.function->getFunction()) && interp.isArrayIndex(subs.front())) {
+                    auto& index = get<FunctionExpression>(subs.front()->expression);
+                    compileArgs(index.subexpressions);
+                    compileArgs(subs, 1);
+                    emit(OpCode::AssignElement, value(funcExpr.function), (uint32_t)subs.size());
+                    value(index.function);
+                } else {
+                    compileArgs(subs);
+                    uint8_t flags = funcExpr.function == setFunction ? KeepFirstArrayMember : 0;
+                    if (funcExpr.function->getType() == Type::Function && interp.isAssignment(funcExpr.function->getFunction())) {
+                        flags |= AssignInPlace;
+                    }
+                    emit(OpCode::Call, value(funcExpr.function), (uint32_t)subs.size(), flags);
+                }
+            }
+                break;
+            case ExpressionType::Loop: {
+                auto& loopexp = get<Loop>(exp->expression);
+                emit(OpCode::PushScope, name("loop"));
+                control.emplace_back(ControlEntry::Scope, loopexp.firstSlot, loopexp.endSlot);
+                if (loopexp.initExpression) {
+                    compileExpression(loopexp.initExpression);
+                    emit(OpCode::Pop);
+                }
+                auto test = here();
+                compileExpression(loopexp.testExpression);
+                auto exitJump = emit(OpCode::JumpIfFalse);
+                loops.emplace_back(control.size());
+                compileStatements(loopexp.subexpressions);
+                patch(loops.back().continueJumps);
+                if (loopexp.iterateExpression) {
+                    compileExpression(loopexp.iterateExpression);
+                    emit(OpCode::Pop);
+                }
+                emit(OpCode::Jump, test);
+                patch(exitJump);
+                patch(loops.back().breakJumps);
+                loops.pop_back();
+                control.pop_back();
+                emit(OpCode::PopScope, (uint32_t)loopexp.firstSlot, (uint32_t)loopexp.endSlot);
+                emit(OpCode::PushNull);
+            }
+                break;
+            case ExpressionType::ForEach: {
+                auto& foreach = get<Foreach>(exp->expression);
+                emit(OpCode::PushScope, name("loop"));
+                control.emplace_back(ControlEntry::Scope, foreach.firstSlot, foreach.endSlot);
+                // the loop variable, and the key variable when there is one, are resolved before the collection is evaluated
+                auto resolve = [&](Symbol varName, size_t slot) {
+                    if (slot != NoSlot) {
+                        emit(OpCode::ResolveSlot, (uint32_t)slot, name(varName));
+                    } else {
+                        emit(OpCode::ResolveVar, name(varName));
+                    }
+                };
+                resolve(foreach.iterateName, foreach.slot);
+                bool hasKey = foreach.keyName != Symbol();
+                if (hasKey) {
+                    resolve(foreach.keyName, foreach.keySlot);
+                }
+                compileExpression(foreach.listExpression);
+                emit(OpCode::ForEachBegin, (uint32_t)hasKey);
+                control.emplace_back(ControlEntry::ForEach);
+                auto next = here();
+                auto exitJump = emit(OpCode::ForEachNext);
+                loops.emplace_back(control.size());
+                compileStatements(foreach.subexpressions);
+                for (auto j : loops.back().continueJumps) {
+                    chunk.code[j].a = next;
+                }
+                emit(OpCode::Jump, next);
+                patch(exitJump);
+                patch(loops.back().breakJumps);
+                loops.pop_back();
+                control.pop_back();
+                emit(OpCode::ForEachEnd);
+                control.pop_back();
+                emit(OpCode::PopScope, (uint32_t)foreach.firstSlot, (uint32_t)foreach.endSlot);
+                emit(OpCode::PushNull);
+            }
+                break;
+            case ExpressionType::IfElse: {
+                vector<size_t> endJumps;
+                for (auto& express : get<IfElse>(exp->expression)) {
+                    size_t skipJump = 0;
+                    if (express.testExpression) {
+                        compileExpression(express.testExpression);
+                        skipJump = emit(OpCode::JumpIfFalse);
+                    }
+                    emit(OpCode::PushScope, name("ifelse"));
+                    control.emplace_back(ControlEntry::Scope, express.firstSlot, express.endSlot);
+                    compileStatements(express.subexpressions);
+                    control.pop_back();
+                    emit(OpCode::PopScope, (uint32_t)express.firstSlot, (uint32_t)express.endSlot);
+                    endJumps.push_back(emit(OpCode::Jump));
+                    if (!express.testExpression) {
+                        // an else branch always runs, so anything after it never does
+                        break;
+                    }
+                    patch(skipJump);
+                }
+                patch(endJumps);
+                emit(OpCode::PushNull);
+            }
+                break;
+            case ExpressionType::Return:
+            case ExpressionType::Break:
+            case ExpressionType::Continue:
+                compileStatement(exp);
+                emit(OpCode::PushNull);
+                break;
+            default:
+                emit(OpCode::PushNull);
+                break;
+            }
+        }
+    };
+
+    ChunkRef KataScriptInterpreter::compileExpression(ExpressionRef exp) {
+        auto chunk = make_shared<Chunk>();
+        BytecodeCompiler compiler(*chunk, *this, false);
+        compiler.compileExpression(exp);
+        compiler.emit(OpCode::Return);
+        compiler.patch(compiler.statementExits);
+        compiler.emit(OpCode::PushNull);
+        compiler.emit(OpCode::Return);
+        chunk->statementCount = 1;
+        chunk->methodCaches.resize(chunk->names.size());
+        chunk->memberCaches.resize(chunk->names.size());
+        return chunk;
+    }
+
+    ChunkRef KataScriptInterpreter::compileFunction(FunctionRef fnc) {
+        auto& subexpressions = get<vector<ExpressionRef>>(fnc->body);
+        if (fnc->bytecode && fnc->bytecode->statementCount == subexpressions.size()) {
+            return fnc->bytecode;
+        }
+        auto chunk = make_shared<Chunk>();
+        BytecodeCompiler compiler(*chunk, *this, fnc->type == FunctionType::constructor);
+        for (auto&& sub : subexpressions) {
+            compiler.compileStatement(sub);
+            compiler.patch(compiler.statementExits);
+            compiler.statementExits.clear();
+        }
+        compiler.emit(OpCode::PushNull);
+        compiler.emit(OpCode::Return);
+        chunk->statementCount = subexpressions.size();
+        chunk->methodCaches.resize(chunk->names.size());
+        chunk->memberCaches.resize(chunk->names.size());
+        fnc->bytecode = chunk;
+        return chunk;
+    }
+
+    // the dispatch loop for the bytecode engine
+    ValueRef KataScriptInterpreter::runChunk(const Chunk& chunk, ScopeRef scope, Class* classs, size_t start, size_t stop) {
+        vector<StackValue> stack;
+        vector<ForEachState> iterators;
+        size_t openScopes = 0;
+        auto& code = chunk.code;
+        size_t ip = start;
+
+        // pops arguments off the stack, array members are passed by value except to =
+        auto popArgs = [&stack](size_t count, bool keepFirst) {
+            List args;
+            args.reserve(count);
+            for (auto iter = stack.end() - count; iter != stack.end(); ++iter) {
+                args.push_back(std::move(iter->shared()));
+            }
+            stack.resize(stack.size() - count);
+            for (size_t i = keepFirst ? 1 : 0; i < args.size(); ++i) {
+                if (args[i]->getType() == Type::ArrayMember) {
+                    args[i] = args[i]->getArrayMember().getValue();
+                }
+            }
+            return args;
+        };
+
+        // an operand of an operator, one marked as an element was left on the stack as an array and an index
+        // ref is only set when the operand has a value of its own, and for one that isn't an element only when it's handed out
+        auto operand = [&](size_t at, bool element, bool handOut, const ValueRef& listIndex, ValueRef& ref, Value& storage) -> const Value& {
+            if (!element) {
+                if (stack[at]->getType() == Type::ArrayMember) {
+                    storage = *stack[at]->getArrayMember().getValue();
+                    return storage;
+                }
+                if (handOut) {
+                    ref = stack[at].shared();
+                }
+                return *stack[at];
+            }
+            auto& container = stack[at].shared();
+            auto& index = stack[at + 1].shared();
+            auto fnc = std::get_if<FunctionRef>(&listIndex->value);
+            if (fnc && *fnc == listIndexFunction && container->getType() == Type::Array && index->getType() == Type::Int) {
+                loadArrayElement(std::as_const(*container).getArray(), index->getInt(), storage);
+                return storage;
+            }
+            ref = callFunction(listIndex->getFunction(), scope, { container, index }, classs);
+            if (ref->getType() == Type::ArrayMember) {
+                storage = *ref->getArrayMember().getValue();
+                ref = nullptr;
+                return storage;
+            }
+            return *ref;
+        };
+
+        while (true) {
+            if (ip == stop) {
+                // a lazy argument finished evaluating
+                return stack.back().shared();
+            }
+            auto& ins = code[ip++];
+            switch (ins.op) {
+            case OpCode::PushNull:
+                stack.emplace_back(Value());
+                break;
+            case OpCode::PushConstant:
+                stack.emplace_back(chunk.constants[ins.a]);
+                break;
+            case OpCode::PushFolded: {
+                auto& fold = chunk.folds[ins.b];
+                if (operatorsUnchanged(fold.operators)) {
+                    stack.emplace_back(chunk.constants[ins.a]);
+                    ip = fold.end;
+                }
+            }
+                break;
+            case OpCode::PushValue:
+                stack.push_back(chunk.values[ins.a]);
+                break;
+            case OpCode::ResolveVar:
+                stack.push_back(StackValue::variable(resolveVariable(chunk.names[ins.a], scope)));
+                break;
+            case OpCode::DefineVar: {
+                auto& varr = scope->variables[chunk.names[ins.a]];
+                if (ins.flags) {
+                    varr = stack.back().copied();
+                    stack.back() = StackValue::variable(varr);
+                } else {
+                    varr = makeImmediate();
+                    stack.push_back(StackValue::variable(varr));
+                }
+            }
+                break;
+            case OpCode::ResolveSlot:
+                if (scope->frame) {
+                    stack.push_back(StackValue::variable(scope->slot(ins.a)));
+                } else {
+                    stack.push_back(StackValue::variable(resolveVariable(chunk.names[ins.b], scope)));
+                }
+                break;
+            case OpCode::DefineSlot: {
+                auto& varr = scope->frame ? scope->slot(ins.a) : scope->variables[chunk.names[ins.b]];
+                if (ins.flags) {
+                    varr = stack.back().copied();
+                    stack.back() = StackValue::variable(varr);
+                } else {
+                    varr = makeImmediate();
+                    stack.push_back(StackValue::variable(varr));
+                }
+            }
+                break;
+            case OpCode::MemberSlot: {
+                auto& name = chunk.names[ins.a];
+                if (classs) {
+                    if (auto member = findMember(name, classs, chunk.memberCaches[ins.a])) {
+                        stack.push_back(StackValue::variable(*member));
+                        break;
+                    }
+                }
+                stack.push_back(StackValue::variable(scope->frame ? scope->slot(ins.b) : resolveVariable(name, scope)));
+            }
+                break;
+            case OpCode::MemberVariable: {
+                auto classToUse = classs;
+                ValueRef object;
+                if (ins.flags) {
+                    object = std::move(stack.back().shared());
+                    stack.pop_back();
+                    if (object->getType() == Type::Class) {
+                        classToUse = object->getClass().get();
+                    }
+                }
+                auto& name = chunk.names[ins.a];
+                if (classToUse) {
+                    if (auto member = findMember(name, classToUse, chunk.memberCaches[ins.a])) {
+                        // the object may only be held by this instruction, so its member is copied out
+                        stack.push_back(object ? StackValue(*member) : StackValue::variable(*member));
+                        break;
+                    }
+                }
+                stack.push_back(StackValue::variable(resolveVariable(name, scope)));
+            }
+                break;
+            case OpCode::Call: {
+                auto& function = chunk.values[ins.a];
+                if (ins.flags & AssignInPlace) {
+                    auto fnc = std::get_if<FunctionRef>(&function->value);
+                    auto assignment = fnc ? getBuiltinAssignment(*fnc) : BuiltinAssignment::None;
+                    auto targetArg = builtinAssignmentTarget(assignment, ins.b);
+                    auto first = stack.size() - ins.b;
+                    if (assignment != BuiltinAssignment::None && targetArg < ins.b
+                        && stack[first + targetArg]->getType() != Type::ArrayMember) {
+                        auto& target = stack[first + targetArg];
+                        auto& val = stack.back();
+                        if (ins.b == 1) {
+                            // postfix increments and decrements give back what the target was
+                            Value previous = *target;
+                            applyBuiltinAssignment(assignment, *target, *val);
+                            target = StackValue(std::move(previous));
+                        } else {
+                            applyBuiltinAssignment(assignment, *target,
+                                val->getType() == Type::ArrayMember ? *val->getArrayMember().getValue() : *val);
+                            if (targetArg) {
+                                stack[first] = std::move(target);
+                            }
+                        }
+                        stack.resize(first + 1);
+                        break;
+                    }
+                }
+                auto args = popArgs(ins.b, ins.flags & KeepFirstArrayMember);
+                stack.push_back(callFunction(function->getFunction(), scope, args, classs));
+            }
+                break;
+            case OpCode::Operator: {
+                auto& function = chunk.values[ins.a];
+                auto fnc = std::get_if<FunctionRef>(&function->value);
+                if (ins.b == 0) {
+                    if (!fnc || *fnc != builtinOperators[ins.flags]) {
+                        auto args = popArgs(2, false);
+                        stack.push_back(callFunction(function->getFunction(), scope, args, classs));
+                        break;
+                    }
+                    auto& a = stack[stack.size() - 2];
+                    auto& b = stack.back();
+                    auto result = evaluateBuiltinOperator((BuiltinOperator)ins.flags,
+                        a->getType() == Type::ArrayMember ? *a->getArrayMember().getValue() : *a,
+                        b->getType() == Type::ArrayMember ? *b->getArrayMember().getValue() : *b);
+                    stack.pop_back();
+                    stack.back() = StackValue(std::move(result));
+                    break;
+                }
+                auto& listIndex = chunk.values[ins.a + 1];
+                size_t aCount = (ins.b & ElementOperandA) ? 2 : 1;
+                size_t bCount = (ins.b & ElementOperandB) ? 2 : 1;
+                auto start = stack.size() - aCount - bCount;
+                ValueRef aRef, bRef;
+                Value aStorage, bStorage;
+                bool replaced = !fnc || *fnc != builtinOperators[ins.flags];
+                auto& a = operand(start, ins.b & ElementOperandA, replaced, listIndex, aRef, aStorage);
+                auto& b = operand(start + aCount, ins.b & ElementOperandB, replaced, listIndex, bRef, bStorage);
+                if (replaced) {
+                    auto result = callFunction(function->getFunction(), scope, { aRef ? aRef : makeValue(a), bRef ? bRef : makeValue(b) }, classs);
+                    stack.resize(start);
+                    stack.push_back(std::move(result));
+                } else {
+                    auto result = evaluateBuiltinOperator((BuiltinOperator)ins.flags, a, b);
+                    stack.resize(start);
+                    stack.emplace_back(std::move(result));
+                }
+            }
+                break;
+            case OpCode::Index: {
+                auto& function = chunk.values[ins.a];
+                auto fnc = std::get_if<FunctionRef>(&function->value);
+                auto& container = stack[stack.size() - 2];
+                auto& index = stack.back();
+                if (fnc && *fnc == listIndexFunction && container->getType() == Type::Array && index->getType() == Type::Int) {
+                    Value element;
+                    loadArrayElement(std::as_const(*container).getArray(), index->getInt(), element);
+                    stack.pop_back();
+                    stack.back() = StackValue(std::move(element));
+                    break;
+                }
+                auto args = popArgs(2, false);
+                stack.push_back(callFunction(function->getFunction(), scope, args, classs));
+            }
+                break;
+            case OpCode::AssignElement: {
+                auto fnc = chunk.values[ins.a]->getFunction();
+                auto& listIndex = chunk.values[ins.a + 1];
+                auto args = popArgs(ins.b - 1, false);
+                auto index = std::move(stack.back().shared());
+                stack.pop_back();
+                auto container = std::move(stack.back().shared());
+                stack.pop_back();
+                auto indexFnc = std::get_if<FunctionRef>(&listIndex->value);
+                if (indexFnc && *indexFnc == listIndexFunction && isAssignment(fnc)
+                    && container->getType() == Type::Array && index->getType() == Type::Int) {
+                    args.insert(args.begin(), makeNull());
+                    loadArrayElement(std::as_const(*container).getArray(), index->getInt(), *args.front());
+                    stack.push_back(callFunction(fnc, scope, args, classs));
+                    storeArrayElement(container->getArray(), index->getInt(), *args.front());
+                    break;
+                }
+                args.insert(args.begin(), callFunction(listIndex->getFunction(), scope, { container, index }, classs));
+                stack.push_back(callFunction(fnc, scope, args, classs));
+            }
+                break;
+            case OpCode::ResolveFunction: {
+                auto& name = chunk.names[ins.a];
+                auto& function = resolveVariable(name, scope);
+                if (function->getType() == Type::Null) {
+                    throw Exception("Function "s + name.getString() + " was null and cannot be called");
+                }
+                stack.push_back(function);
+            }
+                break;
+            case OpCode::LazyCall: {
+                auto& function = *stack.back();
+                if (function.getType() != Type::Function || function.getFunction()->getBodyType() != FunctionBodyType::LazyLambda) {
+                    break;
+                }
+                auto fncRef = function.getFunction();
+                stack.pop_back();
+                auto& bounds = chunk.lazyArgs[ins.a];
+                vector<Thunk> thunks;
+                thunks.reserve(bounds.size() - 1);
+                // each thunk holds the chunk its code is in, so the function can keep one past the call
+                auto owner = chunk.shared_from_this();
+                for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+                    thunks.emplace_back([this, owner, start = bounds[i], end = bounds[i + 1], scope, classs]() {
+                        auto val = runChunk(*owner, scope, classs, start, end);
+                        return val->getType() == Type::ArrayMember ? val->getArrayMember().getValue() : std::move(val);
+                    });
+                }
+                auto returnVal = get<LazyLambda>(fncRef->body)(thunks);
+                stack.push_back(returnVal ? std::move(returnVal) : makeNull());
+                // skip the argument code and the eager call after it
+                ip = bounds.back() + 1;
+            }
+                break;
+            case OpCode::CallIndirect: {
+                auto args = popArgs(ins.b, false);
+                auto function = std::move(stack.back().shared());
+                stack.pop_back();
+                if (function->getType() == Type::ArrayMember) {
+                    function = function->getArrayMember().getValue();
+                }
+                if (function->getType() == Type::Null) {
+                    throw Exception("Indirect function call could not resolve function");
+                }
+                stack.push_back(callFunction(function->getFunction(), scope, args, classs));
+            }
+                break;
+            case OpCode::CallMember: {
+                auto args = popArgs(ins.b, false);
+                auto val = std::move(stack.back().shared());
+                stack.pop_back();
+                if (val->getType() == Type::ArrayMember) {
+                    val = val->getArrayMember().getValue();
+                }
+                auto& name = chunk.names[ins.a];
+                if (val->getType() != Type::Class) {
+                    auto fncRef = resolveVariable(name, scope)->getFunction();
+                    args.insert(args.begin(), val);
+                    stack.push_back(callFunction(fncRef, scope, args, classs));
+                } else {
+                    auto fncRef = resolveFunction(name, val->getClass().get(), scope, chunk.methodCaches[ins.a]);
+                    stack.push_back(callFunction(fncRef, scope, args, val->getClass()));
+                }
+            }
+                break;
+            case OpCode::Pop:
+                stack.pop_back();
+                break;
+            case OpCode::Jump:
+                ip = ins.a;
+                break;
+            case OpCode::JumpIfFalse: {
+                auto test = stack.back()->getBool();
+                stack.pop_back();
+                if (!test) {
+                    ip = ins.a;
+                }
+            }
+                break;
+            case OpCode::PushScope:
+                scope = acquireScope(chunk.names[ins.a].getString(), scope);
+                ++openScopes;
+                break;
+            case OpCode::PopScope:
+                scope->clearSlots(ins.a, ins.b);
+                releaseScope(scope);
+                --openScopes;
+                break;
+            case OpCode::ForEachBegin: {
+                auto collection = std::move(stack.back().shared());
+                stack.pop_back();
+                ValueRef key;
+                if (ins.a) {
+                    key = std::move(stack.back().shared());
+                    stack.pop_back();
+                }
+                auto var = std::move(stack.back().shared());
+                stack.pop_back();
+                iterators.emplace_back(std::move(var), std::move(key), *collection);
+            }
+                break;
+            case OpCode::ForEachNext:
+                if (!iterators.back().next()) {
+                    ip = ins.a;
+                }
+                break;
+            case OpCode::ForEachEnd:
+                iterators.pop_back();
+                break;
+            case OpCode::Return: {
+                auto val = std::move(stack.back().shared());
+                while (openScopes) {
+                    releaseScope(scope);
+                    --openScopes;
+                }
+                return val;
+            }
+            }
+        }
+    }
+
+    ValueRef KataScriptInterpreter::execute(ExpressionRef exp, ScopeRef scope, Class* classs) {
+        if (engine == ExecutionEngine::Bytecode) {
+            return runChunk(*compileExpression(exp), scope, classs);
+        }
+        return getValue(exp, scope, classs);
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+namespace KataScript {
+    // strings, arrays and lists keep their data in a buffer that copies of the value share
+    // copying is just a refcount bump, the data is only duplicated when a shared buffer is written to
+    // an empty handle, like a moved from one, reads as an empty T
+    template <typename T>
+    class CopyOnWrite {
+        shared_ptr<T> data;
+
+        static shared_ptr<T> make(T&& v) {
+#ifdef KATASCRIPT_NO_VALUE_POOL
+            return make_shared<T>(std::move(v));
+#else
+            return std::allocate_shared<T>(PoolAllocator<T>(), std::move(v));
+#endif
+        }
+
+        static const T& empty() {
+            static const T e;
+            return e;
+        }
+
+    public:
+        CopyOnWrite() = default;
+        CopyOnWrite(T v) : data(make(std::move(v))) {}
+
+        const T& read() const {
+            return data ? *data : empty();
+        }
+
+        // the data for changing, anything else still sharing it keeps the old copy
+        T& write() {
+            if (!data) {
+                data = make(T());
+            } else if (data.use_count() != 1) {
+                data = make(T(*data));
+            } else {
+#ifndef KATASCRIPT_THREAD_UNSAFE
+                // the last other owner may have let go on another thread, see its reads before writing
+                std::atomic_thread_fence(std::memory_order_acquire);
+#endif
+            }
+            return *data;
+        }
+
+        // true if another value holds this same buffer
+        bool isShared() const {
+            return data.use_count() > 1;
+        }
+    };
+
+    template <typename T>
+    inline std::ostream& operator<<(std::ostream& os, const CopyOnWrite<T>& v) {
+        return (os << v.read());
+    }
+}
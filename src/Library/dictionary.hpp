@@ -0,0 +1,277 @@
+#pragma once
+
+namespace KataScript {
+    bool operator == (const Value& a, const Value& b);
+
+    // hash table that keeps the real keys and iterates in the order keys were first added
+    // entries sit in one vector, slots is an open addressing index into it probed linearly
+    // a slot keeps 32 bits of the key's hash next to the entry index, so probing only reads an entry when the tags match and growing never does
+    // entries iterate like map pairs, first is the key and second the value
+    class Dictionary {
+    public:
+        struct Entry {
+            Value first;
+            ValueRef second;
+            bool erased = false;
+        };
+
+        // indexes instead of pointers, so adding entries while iterating doesn't break the loop
+        template <typename Owner, typename Item>
+        class Iterator {
+            Owner* dict = nullptr;
+            size_t index = 0;
+
+            void skipErased() {
+                while (index < dict->entries.size() && dict->entries[index].erased) {
+                    ++index;
+                }
+            }
+
+        public:
+            Iterator() = default;
+            Iterator(Owner* d, size_t i) : dict(d), index(i) { skipErased(); }
+            Item& operator*() const { return dict->entries[index]; }
+            Item* operator->() const { return &dict->entries[index]; }
+            Iterator& operator++() {
+                ++index;
+                skipErased();
+                return *this;
+            }
+            bool operator==(const Iterator& o) const { return index == o.index; }
+        };
+        using iterator = Iterator<Dictionary, Entry>;
+        using const_iterator = Iterator<const Dictionary, const Entry>;
+
+    private:
+        static constexpr uint64_t EmptySlot = UINT64_MAX;
+        vector<Entry> entries;
+        vector<uint64_t> slots;
+        size_t live = 0;
+        uint32_t shift = 64;
+        // running foreach loops, entries don't move while there are any
+        uint32_t pins = 0;
+
+        // keys are only equal with the same type, so 1 and 1.0 are different keys like their hashes are
+        static bool keysMatch(const Value& a, const Value& b) {
+            if (a.getType() != b.getType()) {
+                return false;
+            }
+            switch (a.getType()) {
+            case Type::Function:
+                return a.getFunction() == b.getFunction();
+            case Type::UserPointer:
+                return a.getPointer() == b.getPointer();
+            case Type::ArrayMember:
+                return keysMatch(*a.getArrayMember().getValue(), *b.getArrayMember().getValue());
+            case Type::Dictionary:
+                return a.getDictionary() == b.getDictionary();
+            case Type::Class:
+                return a.getClass() == b.getClass();
+            default:
+                return a == b;
+            }
+        }
+
+        static uint32_t tagOf(const Value& key) {
+            auto hash = (uint64_t)key.getHash();
+            return (uint32_t)(hash ^ (hash >> 32));
+        }
+        static uint64_t makeSlot(uint32_t tag, uint32_t index) {
+            return ((uint64_t)tag << 32) | index;
+        }
+        static uint32_t slotTag(uint64_t slot) {
+            return (uint32_t)(slot >> 32);
+        }
+        static uint32_t slotIndex(uint64_t slot) {
+            return (uint32_t)slot;
+        }
+
+        // fibonacci hashing spreads out sequential int keys, which otherwise hash to themselves
+        size_t home(uint32_t tag) const {
+            return (size_t)(((uint64_t)tag * 0x9E3779B97F4A7C15ull) >> shift);
+        }
+
+        // the slot holding the key, or the empty slot it would go in
+        size_t probe(const Value& key, uint32_t tag) const {
+            auto mask = slots.size() - 1;
+            for (auto i = home(tag);; i = (i + 1) & mask) {
+                auto slot = slots[i];
+                if (slot == EmptySlot || (slotTag(slot) == tag && keysMatch(entries[slotIndex(slot)].first, key))) {
+                    return i;
+                }
+            }
+        }
+
+        // drop erased entries and size the slots for count keys, at most half full
+        void rebuild(size_t count) {
+            vector<uint64_t> old;
+            old.swap(slots);
+            // compacting moves entries down, so remember where each one went
+            vector<uint32_t> moved;
+            if (live != entries.size() && pins == 0) {
+                moved.resize(entries.size());
+                uint32_t to = 0;
+                for (uint32_t from = 0; from < (uint32_t)entries.size(); ++from) {
+                    moved[from] = to;
+                    if (!entries[from].erased) {
+                        if (to != from) {
+                            entries[to] = std::move(entries[from]);
+                        }
+                        ++to;
+                    }
+                }
+                entries.erase(entries.begin() + to, entries.end());
+            }
+
+            size_t size = 8;
+            uint32_t bits = 3;
+            while (size < count * 2) {
+                size *= 2;
+                ++bits;
+            }
+            slots.assign(size, EmptySlot);
+            shift = 64 - bits;
+            auto mask = size - 1;
+            for (auto slot : old) {
+                if (slot == EmptySlot) {
+                    continue;
+                }
+                auto i = home(slotTag(slot));
+                while (slots[i] != EmptySlot) {
+                    i = (i + 1) & mask;
+                }
+                slots[i] = makeSlot(slotTag(slot), moved.empty() ? slotIndex(slot) : moved[slotIndex(slot)]);
+            }
+        }
+
+    public:
+        size_t size() const { return live; }
+        bool empty() const { return live == 0; }
+
+        iterator begin() { return iterator(this, 0); }
+        iterator end() { return iterator(this, entries.size()); }
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, entries.size()); }
+
+        void reserve(size_t count) {
+            entries.reserve(count);
+            if (count * 2 > slots.size()) {
+                rebuild(count);
+            }
+        }
+
+        void clear() {
+            entries.clear();
+            slots.clear();
+            live = 0;
+        }
+
+        // the value for a key, a new key is added with a nullptr value for the caller to fill in
+        ValueRef& operator[](const Value& key) {
+            auto tag = tagOf(key);
+            if ((live + 1) * 2 > slots.size()) {
+                rebuild(live + 1);
+            }
+            auto i = probe(key, tag);
+            if (slots[i] == EmptySlot) {
+                slots[i] = makeSlot(tag, (uint32_t)entries.size());
+                entries.push_back(Entry{ key, nullptr });
+                ++live;
+            }
+            return entries[slotIndex(slots[i])].second;
+        }
+
+        iterator find(const Value& key) {
+            if (live == 0) {
+                return end();
+            }
+            auto i = probe(key, tagOf(key));
+            return slots[i] == EmptySlot ? end() : iterator(this, slotIndex(slots[i]));
+        }
+
+        const_iterator find(const Value& key) const {
+            if (live == 0) {
+                return end();
+            }
+            auto i = probe(key, tagOf(key));
+            return slots[i] == EmptySlot ? end() : const_iterator(this, slotIndex(slots[i]));
+        }
+
+        bool contains(const Value& key) const {
+            return find(key) != end();
+        }
+
+        bool erase(const Value& key) {
+            if (live == 0) {
+                return false;
+            }
+            auto i = probe(key, tagOf(key));
+            if (slots[i] == EmptySlot) {
+                return false;
+            }
+            auto& entry = entries[slotIndex(slots[i])];
+            entry.erased = true;
+            entry.first = Value();
+            entry.second = nullptr;
+            --live;
+
+            // pull later keys of the same run back into the gap, so a lookup never stops early
+            auto mask = slots.size() - 1;
+            for (auto j = (i + 1) & mask; slots[j] != EmptySlot; j = (j + 1) & mask) {
+                auto h = home(slotTag(slots[j]));
+                if (((j - h) & mask) >= ((j - i) & mask)) {
+                    slots[i] = slots[j];
+                    i = j;
+                }
+            }
+            slots[i] = EmptySlot;
+
+            if (pins == 0 && entries.size() > 8 && entries.size() - live > live) {
+                rebuild(live);
+            }
+            return true;
+        }
+
+        // keeps a dictionary from compacting its entries, so a loop going through them by index never skips or repeats one
+        class Pin {
+            shared_ptr<Dictionary> dict;
+
+        public:
+            Pin() = default;
+            Pin(shared_ptr<Dictionary> d) : dict(std::move(d)) {
+                ++dict->pins;
+            }
+            Pin(Pin&& o) noexcept : dict(std::move(o.dict)) {}
+            Pin& operator=(Pin&& o) noexcept {
+                std::swap(dict, o.dict);
+                return *this;
+            }
+            ~Pin() {
+                if (dict) {
+                    --dict->pins;
+                }
+            }
+        };
+
+        // the first entry from index on that hasn't been erased, moving index past it, nullptr once there are none left
+        Entry* next(size_t& index) {
+            while (index < entries.size()) {
+                auto& entry = entries[index++];
+                if (!entry.erased) {
+                    return &entry;
+                }
+            }
+            return nullptr;
+        }
+
+        // add the keys this doesn't have yet, keys already here keep their values
+        void merge(const Dictionary& o) {
+            for (auto&& item : o) {
+                auto& ref = (*this)[item.first];
+                if (!ref) {
+                    ref = item.second;
+                }
+            }
+        }
+    };
+}
@@ -5,14 +5,10 @@ namespace KataScript {
     bool isReturnType(ExpressionType t) {
         return t == ExpressionType::Return || t == ExpressionType::Break || t == ExpressionType::Continue;
     }
-    ReturnResult KataScriptInterpreter::needsToReturn(ExpressionRef exp, ScopeRef scope, Class* classs) {
-        if (isReturnType(exp->type)) {
-            return ReturnResult{ getValue(exp, scope, classs), exp->type};
-        } else {
-            auto result = consolidated(exp, scope, classs);
-            if (isReturnType(result->type)) {
-                return ReturnResult{ get<ValueRef>(result->expression), result->type };
-            }
+    ReturnResult KataScriptInterpreter::needsToReturn(const ExpressionRef& exp, ScopeRef scope, Class* classs) {
+        auto result = consolidated(exp, scope, classs);
+        if (isReturnType(result.type)) {
+            return result;
         }
         return ReturnResult{ nullptr, ExpressionType::None };
     }
@@ -29,36 +25,60 @@ namespace KataScript {
         return ReturnResult{ nullptr, ExpressionType::None };
     }
 
-    // walk the tree depth first and replace any function expressions 
-    // with a value expression of their results
-    ExpressionRef KataScriptInterpreter::consolidated(ExpressionRef exp, ScopeRef scope, Class* classs) {
+    // walk the tree depth first and evaluate it
+    // the result type is None for plain values, or says which control flow statement was hit
+    ReturnResult KataScriptInterpreter::consolidated(const ExpressionRef& exp, ScopeRef scope, Class* classs) {
         switch (exp->type) {
-        case ExpressionType::Constant:
-            return make_shared<Expression>(make_shared<Value>(get<Constant>(exp->expression).val));
+        case ExpressionType::Constant: {
+            auto& constant = get<Constant>(exp->expression);
+            if (!constant.stillFolded()) {
+                return consolidated(constant.unfolded, scope, classs);
+            }
+            return ReturnResult{ constant.get() };
+        }
         case ExpressionType::DefineVar: {
             auto& def = get<DefineVar>(exp->expression);
-            auto& varr = scope->variables[def.name];
+            auto& varr = (def.slot != NoSlot && scope->frame) ? scope->slot(def.slot) : scope->variables[def.name];
             if (def.defineExpression) {
-                auto val = getValue(def.defineExpression, scope, classs);
-                varr = make_shared<Value>(val->value);
+                Value storage;
+                if (auto val = getImmediate(def.defineExpression, scope, classs, storage)) {
+                    varr = val == &storage ? makeImmediate(std::move(storage)) : makeImmediate(*val);
+                } else {
+                    varr = makeImmediate(getValue(def.defineExpression, scope, classs)->value);
+                }
             } else {
-                varr = makeNull();
+                varr = makeImmediate();
+            }
+            // handing out the variable itself would box it, so the definition gives back a copy
+            return ReturnResult{ makeImmediate(*varr) };
+        }
+        case ExpressionType::ResolveVar: {
+            auto& resolveVar = get<ResolveVar>(exp->expression);
+            if (resolveVar.slot != NoSlot && scope->frame) {
+                return ReturnResult{ scope->slot(resolveVar.slot) };
             }
-            return make_shared<Expression>(varr);
+            return ReturnResult{ resolveVariable(resolveVar.name, scope) };
         }
-        case ExpressionType::ResolveVar:
-            return make_shared<Expression>(resolveVariable(get<ResolveVar>(exp->expression).name, scope));
         case ExpressionType::MemberVariable: {
             auto& expr = get<MemberVariable>(exp->expression);
             auto classToUse = classs;
+            ValueRef object;
             if (expr.object) {
-                auto val = getValue(expr.object, scope, classs);
-                if (val->getType() == Type::Class) {
-                    auto clRef = val->getClass();
-                    classToUse = clRef.get();
+                object = getValue(expr.object, scope, classs);
+                if (object->getType() == Type::Class) {
+                    classToUse = object->getClass().get();
+                }
+            }
+            // class members win over locals
+            if (classToUse) {
+                if (auto member = findMember(expr.name, classToUse, expr.cache)) {
+                    return ReturnResult{ *member };
                 }
             }
-            return make_shared<Expression>(resolveVariable(expr.name, classToUse, scope));
+            if (!expr.object && expr.slot != NoSlot && scope->frame) {
+                return ReturnResult{ scope->slot(expr.slot) };
+            }
+            return ReturnResult{ resolveVariable(expr.name, scope) };
         }
         case ExpressionType::MemberFunctionCall: {
             auto& expr = get<MemberFunctionCall>(exp->expression);
@@ -66,205 +86,310 @@ namespace KataScript {
             if (val->getType() == Type::ArrayMember) {
                 val = val->getArrayMember().getValue();
             }
-            auto fncRef = (val->getType() != Type::Class) ? resolveVariable(expr.functionName, scope)->getFunction() : resolveFunction(expr.functionName, val->getClass().get(), scope);
+            auto fncRef = (val->getType() != Type::Class) ? resolveVariable(expr.functionName, scope)->getFunction() : resolveFunction(expr.functionName, val->getClass().get(), scope, expr.cache);
             List args;
+            args.reserve(expr.subexpressions.size() + 1);
             for (auto&& sub : expr.subexpressions) {
                 auto subval = getValue(sub, scope, classs);
-                args.push_back(subval->getType() == Type::ArrayMember ? subval->getArrayMember().getValue() : subval);
+                args.push_back(subval->getType() == Type::ArrayMember ? subval->getArrayMember().getValue() : std::move(subval));
             }
             if (val->getType() != Type::Class) {
                 args.insert(args.begin(), val);
-                return make_shared<Expression>(callFunction(fncRef, scope, args, classs));
+                return ReturnResult{ callFunction(fncRef, scope, args, classs) };
             }
-            return make_shared<Expression>(callFunction(fncRef, scope, args, val->getClass()));
+            return ReturnResult{ callFunction(fncRef, scope, args, val->getClass()) };
         }
         case ExpressionType::Return:
-            return make_shared<Expression>(getValue(get<Return>(exp->expression).expression, scope, classs));
+            return ReturnResult{ getValue(get<Return>(exp->expression).expression, scope, classs), ExpressionType::Return };
         case ExpressionType::Break:
-            return make_shared<Expression>(makeNull());
+        case ExpressionType::Continue:
+            return ReturnResult{ makeNull(), exp->type };
+        case ExpressionType::FunctionDef:
+            return ReturnResult{ get<FunctionExpression>(exp->expression).function };
         case ExpressionType::FunctionCall: {
+            // resolve the function on every call, the same node can see different functions
             auto& funcExpr = get<FunctionExpression>(exp->expression);
-            if (funcExpr.function->getType() == Type::String) {
-                auto resolvedFunction = resolveVariable(funcExpr.function->getString(), scope);                
-                if (resolvedFunction->getType() == Type::Null) {
+            if (funcExpr.op != BuiltinOperator::None && funcExpr.subexpressions.size() == 2 && isBuiltinOperator(funcExpr)) {
+                ValueRef aRef, bRef;
+                Value aStorage, bStorage;
+                auto& a = getOperand(funcExpr.subexpressions[0], scope, classs, aRef, aStorage);
+                auto& b = getOperand(funcExpr.subexpressions[1], scope, classs, bRef, bStorage);
+                return ReturnResult{ applyBuiltinOperator(funcExpr.op, a, b) };
+            }
+            if (isArrayIndex(exp)) {
+                ValueRef ref;
+                Value storage;
+                getOperand(exp, scope, classs, ref, storage);
+                return ReturnResult{ ref ? std::move(ref) : makeImmediate(std::move(storage)) };
+            }
+            auto function = funcExpr.function;
+            size_t firstArg = 0;
+            if (function->getType() == Type::String) {
+                function = resolveVariable(funcExpr.function->getString(), scope);
+                if (function->getType() == Type::Null) {
                     throw Exception("Function "s + funcExpr.function->getString() + " was null and cannot be called");
                 }
-                funcExpr.function = resolvedFunction;
-            } else if (funcExpr.function->getType() == Type::Null) {
+            } else if (function->getType() == Type::Null) {
                 if (funcExpr.subexpressions.size() >= 1) {
-                    funcExpr.function = getValue(funcExpr.subexpressions.front(), scope, classs);
-                    if (funcExpr.function->getType() == Type::ArrayMember) {
-                        funcExpr.function = funcExpr.function->getArrayMember().getValue();
+                    function = getValue(funcExpr.subexpressions.front(), scope, classs);
+                    if (function->getType() == Type::ArrayMember) {
+                        function = function->getArrayMember().getValue();
                     }
-                    if (funcExpr.function->getType() == Type::Null) {
+                    if (function->getType() == Type::Null) {
                         // todo: better more descriptive error message
                         // perhaps reconstruct the line of code from the expression?
                         throw Exception("Indirect function call could not resolve function");
                     }
-                    funcExpr.subexpressions.erase(funcExpr.subexpressions.begin());                    
+                    firstArg = 1;
+                }
+            }
+            auto fncRef = function->getFunction();
+            if (fncRef->getBodyType() == FunctionBodyType::LazyLambda) {
+                vector<Thunk> thunks;
+                thunks.reserve(funcExpr.subexpressions.size() - firstArg);
+                // each thunk holds what it evaluates, so the function can keep one past the call
+                for (auto i = firstArg; i < funcExpr.subexpressions.size(); ++i) {
+                    thunks.emplace_back([this, arg = funcExpr.subexpressions[i], scope, classs]() {
+                        auto val = getValue(arg, scope, classs);
+                        return val->getType() == Type::ArrayMember ? val->getArrayMember().getValue() : std::move(val);
+                    });
+                }
+                auto returnVal = get<LazyLambda>(fncRef->body)(thunks);
+                return ReturnResult{ returnVal ? std::move(returnVal) : makeNull() };
+            }
+            // builtin assignments change their target in place, so the value assigned never needs a box
+            auto assignment = getBuiltinAssignment(fncRef);
+            auto argCount = funcExpr.subexpressions.size() - firstArg;
+            auto targetArg = builtinAssignmentTarget(assignment, argCount);
+            if (assignment != BuiltinAssignment::None && targetArg < argCount
+                && (targetArg == 0 || funcExpr.subexpressions[firstArg]->type == ExpressionType::Value)
+                && !isArrayIndex(funcExpr.subexpressions[firstArg + targetArg])) {
+                // a variable is changed where it lives, copying its handle out would box it
+                ValueRef held;
+                auto targetExp = funcExpr.subexpressions[firstArg + targetArg];
+                auto place = getVariable(targetExp, scope);
+                if (!place) {
+                    held = getValue(targetExp, scope, classs);
+                    place = &held;
+                }
+                ValueRef ref;
+                Value storage;
+                auto& val = targetArg + 1 < argCount ? getOperand(funcExpr.subexpressions[firstArg + 1], scope, classs, ref, storage) : **place;
+                if ((*place)->getType() == Type::ArrayMember) {
+                    if (assignment == BuiltinAssignment::Set) {
+                        (*place)->getArrayMember().setValue(ref ? std::move(ref) : makeImmediate(val));
+                        return ReturnResult{ (*place)->getArrayMember().getValue() };
+                    }
+                    held = (*place)->getArrayMember().getValue();
+                    place = &held;
                 }
+                auto& target = *place;
+                if (argCount == 1) {
+                    // postfix increments and decrements give back what the target was
+                    auto previous = makeImmediate(target->value);
+                    applyBuiltinAssignment(assignment, *target, val);
+                    return ReturnResult{ std::move(previous) };
+                }
+                applyBuiltinAssignment(assignment, *target, val);
+                // an immediate variable gives back a copy so it stays unboxed
+                return ReturnResult{ target.isImmediate() ? makeImmediate(*target) : target };
             }
-            auto fncRef = funcExpr.function->getFunction();
             List args;
-            bool isEq = funcExpr.function == setFunctionVarLocation;
-            for (auto&& sub : funcExpr.subexpressions) {
-                auto val = getValue(sub, scope, classs);
-                args.push_back((val->getType() == Type::ArrayMember && !isEq) ? val->getArrayMember().getValue() : val);
+            args.reserve(funcExpr.subexpressions.size() - firstArg);
+            bool isEq = function == setFunctionVarLocation;
+            // an array element being assigned to is copied out, and stored back once the operator is done with it
+            ValueRef elementArray;
+            Int elementIndex = 0;
+            if (firstArg < funcExpr.subexpressions.size() && isArrayIndex(funcExpr.subexpressions[firstArg]) && isAssignment(fncRef)) {
+                auto& indexSubs = get<FunctionExpression>(funcExpr.subexpressions[firstArg]->expression).subexpressions;
+                auto container = getValue(indexSubs[0], scope, classs);
+                auto index = getValue(indexSubs[1], scope, classs);
+                if (container->getType() == Type::Array && index->getType() == Type::Int) {
+                    elementArray = container;
+                    elementIndex = index->getInt();
+                    args.push_back(makeNull());
+                    loadArrayElement(std::as_const(*container).getArray(), elementIndex, *args.back());
+                } else {
+                    args.push_back(callFunction(listIndexFunction, scope, { container, index }, classs));
+                }
+                ++firstArg;
                 isEq = false;
             }
-            return make_shared<Expression>(callFunction(fncRef, scope, args, classs));
+            for (auto i = firstArg; i < funcExpr.subexpressions.size(); ++i) {
+                auto val = getValue(funcExpr.subexpressions[i], scope, classs);
+                args.push_back((val->getType() == Type::ArrayMember && !isEq) ? val->getArrayMember().getValue() : std::move(val));
+                isEq = false;
+            }
+            auto result = callFunction(fncRef, scope, args, classs);
+            if (elementArray) {
+                storeArrayElement(elementArray->getArray(), elementIndex, *args.front());
+            }
+            return ReturnResult{ std::move(result) };
         }
         case ExpressionType::Loop: {
-            scope = newScope("loop", scope);
+            scope = acquireScope("loop", scope);
             auto& loopexp = get<Loop>(exp->expression);
             if (loopexp.initExpression) {
                 getValue(loopexp.initExpression, scope, classs);
             }
             ReturnResult returnVal;
-            while (!returnVal && getValue(loopexp.testExpression, scope, classs)->getBool()) {
+            while (!returnVal && getCondition(loopexp.testExpression, scope, classs)) {
                 returnVal = needsToReturn(loopexp.subexpressions, scope, classs);
                 if (!returnVal && loopexp.iterateExpression) {
                     getValue(loopexp.iterateExpression, scope, classs);
                 }
             }
-            closeScope(scope);
+            scope->clearSlots(loopexp.firstSlot, loopexp.endSlot);
+            releaseScope(scope);
             if (returnVal && returnVal.type == ExpressionType::Return) {
-                return make_shared<Expression>(returnVal.value, ExpressionType::Return);
+                return ReturnResult{ std::move(returnVal.value), ExpressionType::Return };
             } else {
-                return make_shared<Expression>(makeNull());
+                return ReturnResult{ makeNull() };
             }
         }
         case ExpressionType::ForEach: {
-            scope = newScope("loop", scope);
-            auto varr = resolveVariable(get<Foreach>(exp->expression).iterateName, scope);
-            auto list = getValue(get<Foreach>(exp->expression).listExpression, scope, classs);
-            auto& subs = get<Foreach>(exp->expression).subexpressions;
+            scope = acquireScope("loop", scope);
+            auto& foreach = get<Foreach>(exp->expression);
+            auto varr = (foreach.slot != NoSlot && scope->frame) ? scope->slot(foreach.slot) : resolveVariable(foreach.iterateName, scope);
+            ValueRef key;
+            if (foreach.keyName != Symbol()) {
+                key = (foreach.keySlot != NoSlot && scope->frame) ? scope->slot(foreach.keySlot) : resolveVariable(foreach.keyName, scope);
+            }
+            ForEachState state(varr, key, *getValue(foreach.listExpression, scope, classs));
             ReturnResult returnVal;
-            if (list->getType() == Type::Dictionary) {
-                for (auto&& in : *list->getDictionary().get()) {
-                    if (returnVal) break;
-                    *varr = *in.second;
-                    returnVal = needsToReturn(subs, scope, classs);
-                }
-            } else if (list->getType() == Type::List) {
-                for (auto&& in : list->getList()) {
-                    if (returnVal) break;
-                    *varr = *in;
-                    returnVal = needsToReturn(subs, scope, classs);
-                }
-            } else if (list->getType() == Type::Array) {
-                auto& arr = list->getArray();
-                switch (arr.getType()) {
-                case Type::Int: {
-                    auto vec = list->getStdVector<Int>();
-                    for (auto&& in : vec) {
-                        if (returnVal) break;
-                        *varr = Value(in);
-                        returnVal = needsToReturn(subs, scope, classs);
-                    }
-                }
-                              break;
-                case Type::Float: {
-                    auto vec = list->getStdVector<Float>();
-                    for (auto&& in : vec) {
-                        if (returnVal) break;
-                        *varr = Value(in);
-                        returnVal = needsToReturn(subs, scope, classs);
-                    }
-                }
-                                break;
-                case Type::Vec3: {
-                    auto vec = list->getStdVector<vec3>();
-                    for (auto&& in : vec) {
-                        if (returnVal) break;
-                        *varr = Value(in);
-                        returnVal = needsToReturn(subs, scope, classs);
-                    }
-                }
-                               break;
-                case Type::String: {
-                    auto vec = list->getStdVector<string>();
-                    for (auto&& in : vec) {
-                        if (returnVal) break;
-                        *varr = Value(in);
-                        returnVal = needsToReturn(subs, scope, classs);
-                    }
-                }
-                                 break;
-                case Type::Function: {
-                    auto vec = list->getStdVector<FunctionRef>();
-                    for (auto&& in : vec) {
-                        if (returnVal) break;
-                        *varr = Value(in);
-                        returnVal = needsToReturn(subs, scope, classs);
-                    }
-                }
-                                   break;
-
-                case Type::UserPointer: {
-                    auto vec = list->getStdVector<UserPointer>();
-                    for (auto&& in : vec) {
-                        if (returnVal) break;
-                        *varr = Value(in);
-                        returnVal = needsToReturn(subs, scope, classs);
-                    }
-                }
-                                      break;
-                default:
-                    break;
-                }
+            while (!returnVal && state.next()) {
+                returnVal = needsToReturn(foreach.subexpressions, scope, classs);
             }
-            closeScope(scope);
+            scope->clearSlots(foreach.firstSlot, foreach.endSlot);
+            releaseScope(scope);
             if (returnVal && returnVal.type == ExpressionType::Return) {
-                return make_shared<Expression>(returnVal.value, ExpressionType::Return);
+                return ReturnResult{ std::move(returnVal.value), ExpressionType::Return };
             } else {
-                return make_shared<Expression>(makeNull());
+                return ReturnResult{ makeNull() };
             }
         }
         case ExpressionType::IfElse: {
             ReturnResult returnVal;
             for (auto& express : get<IfElse>(exp->expression)) {
-                if (!express.testExpression || getValue(express.testExpression, scope, classs)->getBool()) {
-                    scope = newScope("ifelse", scope);
-                    returnVal = needsToReturn(express.subexpressions, scope, classs);
-                    closeScope(scope);
+                if (!express.testExpression || getCondition(express.testExpression, scope, classs)) {
+                    scope = acquireScope("ifelse", scope);
+                    // continue has to reach the enclosing loop, so it isn't swallowed here
+                    for (auto&& sub : express.subexpressions) {
+                        if ((returnVal = needsToReturn(sub, scope, classs))) {
+                            break;
+                        }
+                    }
+                    scope->clearSlots(express.firstSlot, express.endSlot);
+                    releaseScope(scope);
                     break;
                 }
             }
 
             if (returnVal) {
-                return make_shared<Expression>(returnVal.value, returnVal.type);
+                return returnVal;
             } else {
-                return make_shared<Expression>(makeNull());
+                return ReturnResult{ makeNull() };
             }
         }
         default:
             break;
         }
-        return make_shared<Expression>(get<ValueRef>(exp->expression));
+        return ReturnResult{ get<ValueRef>(exp->expression) };
+    }
+
+    // the handle a plain variable lives in, or null for anything else
+    ValueRef* KataScriptInterpreter::getVariable(const ExpressionRef& exp, ScopeRef scope) {
+        if (exp->type != ExpressionType::ResolveVar) {
+            return nullptr;
+        }
+        auto& resolveVar = get<ResolveVar>(exp->expression);
+        if (resolveVar.slot != NoSlot && scope->frame) {
+            return &scope->slot(resolveVar.slot);
+        }
+        return &resolveVariable(resolveVar.name, scope);
+    }
+
+    // constants, variables and builtin operators on other immediates are read or computed without boxing them
+    // returns null for anything else
+    const Value* KataScriptInterpreter::getImmediate(const ExpressionRef& exp, ScopeRef scope, Class* classs, Value& storage) {
+        if (exp->type == ExpressionType::Constant) {
+            auto& constant = get<Constant>(exp->expression);
+            return constant.stillFolded() ? &constant.val : nullptr;
+        }
+        if (auto var = getVariable(exp, scope)) {
+            return var->get();
+        }
+        if (exp->type != ExpressionType::FunctionCall) {
+            return nullptr;
+        }
+        auto& funcExpr = get<FunctionExpression>(exp->expression);
+        if (funcExpr.op == BuiltinOperator::None || funcExpr.subexpressions.size() != 2 || !isBuiltinOperator(funcExpr)) {
+            return nullptr;
+        }
+        ValueRef aRef, bRef;
+        Value aStorage, bStorage;
+        auto& a = getOperand(funcExpr.subexpressions[0], scope, classs, aRef, aStorage);
+        auto& b = getOperand(funcExpr.subexpressions[1], scope, classs, bRef, bStorage);
+        storage = evaluateBuiltinOperator(funcExpr.op, a, b);
+        return &storage;
+    }
+
+    // the truthiness of a test, without boxing it when it's an immediate
+    bool KataScriptInterpreter::getCondition(const ExpressionRef& exp, ScopeRef scope, Class* classs) {
+        Value storage;
+        if (auto val = getImmediate(exp, scope, classs, storage)) {
+            return val->getBool();
+        }
+        return getValue(exp, scope, classs)->getBool();
+    }
+
+    // the value of an operand, an element of an array is read into storage instead of being boxed
+    const Value& KataScriptInterpreter::getOperand(const ExpressionRef& exp, ScopeRef scope, Class* classs, ValueRef& ref, Value& storage) {
+        if (auto val = getImmediate(exp, scope, classs, storage)) {
+            return *val;
+        }
+        if (isArrayIndex(exp)) {
+            auto& subs = get<FunctionExpression>(exp->expression).subexpressions;
+            auto container = getValue(subs[0], scope, classs);
+            auto index = getValue(subs[1], scope, classs);
+            if (container->getType() == Type::Array && index->getType() == Type::Int) {
+                loadArrayElement(std::as_const(*container).getArray(), index->getInt(), storage);
+                return storage;
+            }
+            ref = callFunction(listIndexFunction, scope, { container, index }, classs);
+        } else {
+            ref = getValue(exp, scope, classs);
+        }
+        if (ref->getType() == Type::ArrayMember) {
+            storage = *ref->getArrayMember().getValue();
+            return storage;
+        }
+        return *ref;
     }
 
     // evaluate an expression from tokens
     ValueRef KataScriptInterpreter::getValue(const vector<string_view>& strings, ScopeRef scope, Class* classs) {
-        return getValue(getExpression(strings, scope, classs), scope, classs);
+        return execute(getExpression(strings, scope, classs), scope, classs);
     }
 
     // evaluate an expression from expressionRef
     ValueRef KataScriptInterpreter::getValue(ExpressionRef exp, ScopeRef scope, Class* classs) {
-        // copy the expression so that we don't lose it when we consolidate
-        return get<ValueRef>(consolidated(exp, scope, classs)->expression);
+        return consolidated(exp, scope, classs).value;
     }
 
     bool KataScriptInterpreter::closeCurrentExpression() {
         previousExpression = currentExpression;
         if (currentExpression) {
+            if (currentExpression->type == ExpressionType::FunctionDef) {
+                resolveSlots(get<FunctionExpression>(currentExpression->expression).function->getFunction());
+            }
             if (currentExpression->parent) {
                 currentExpression = currentExpression->parent;
             } else {
                 if (currentExpression->type != ExpressionType::FunctionDef
                     && currentExpression->type != ExpressionType::IfElse
                     ) {
-                    getValue(currentExpression, parseScope, nullptr);
+                    runStatement(currentExpression);
                 }
                 currentExpression = nullptr;
                 return true;
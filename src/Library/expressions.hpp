@@ -2,18 +2,55 @@
 #include "types.hpp"
 
 namespace KataScript {
+    // marks a variable that is looked up by name instead of by frame slot
+    constexpr size_t NoSlot = (size_t)-1;
+
+    // which function a member call found for the last few receiver classes
+    struct MethodCache {
+        struct Entry {
+            ScopeRef classScope;
+            size_t version = 0;
+            FunctionRef function;
+        };
+        array<Entry, 4> entries;
+        size_t next = 0;
+
+        FunctionRef find(const Scope* classScope, size_t version) const {
+            for (auto& entry : entries) {
+                if (entry.classScope.get() == classScope && entry.version == version) {
+                    return entry.function;
+                }
+            }
+            return nullptr;
+        }
+
+        void insert(const ScopeRef& classScope, size_t version, const FunctionRef& function) {
+            entries[next] = Entry{ classScope, version, function };
+            next = (next + 1) % entries.size();
+        }
+    };
+
+    // where a member variable was found in the last class instance it was read from
+    struct MemberCache {
+        uint64_t layoutId = 0;
+        ValueRef* location = nullptr;
+    };
+
     // describes an expression tree with a function at the root
 	struct FunctionExpression {
 		ValueRef function;
 		vector<ExpressionRef> subexpressions;
+        // set when function is a standard library operator, for as long as it still is
+        BuiltinOperator op = BuiltinOperator::None;
 
 		FunctionExpression(const FunctionExpression& o) {
 			function = o.function;
+            op = o.op;
 			for (auto sub : o.subexpressions) {
 				subexpressions.push_back(make_shared<Expression>(*sub));
 			}
 		}
-		FunctionExpression(FunctionRef fnc) : function(new Value(fnc)) {}
+		FunctionExpression(FunctionRef fnc) : function(makeValue(fnc)) {}
 		FunctionExpression(ValueRef fncvalue) : function(fncvalue) {}
 		FunctionExpression() {}
 
@@ -28,20 +65,24 @@ namespace KataScript {
 
     struct MemberVariable {
         ExpressionRef object;
-		string name;
+		Symbol name;
+        size_t slot = NoSlot;
+        MemberCache cache;
 
 		MemberVariable(const MemberVariable& o) {
             object = o.object;
 			name = o.name;
+            slot = o.slot;
 		}
-		MemberVariable(ExpressionRef ob, const string& name_) : object(ob), name(name_) {}
+		MemberVariable(ExpressionRef ob, Symbol name_) : object(ob), name(name_) {}
 		MemberVariable() {}
 	};
 
     struct MemberFunctionCall {
         ExpressionRef object;
-		string functionName;
+		Symbol functionName;
 		vector<ExpressionRef> subexpressions;
+        MethodCache cache;
 
 		MemberFunctionCall(const MemberFunctionCall& o) {
             object = o.object;
@@ -50,7 +91,7 @@ namespace KataScript {
 				subexpressions.push_back(make_shared<Expression>(*sub));
 			}
 		}
-		MemberFunctionCall(ExpressionRef ob, const string& fncvalue, const vector<ExpressionRef>& sub) 
+		MemberFunctionCall(ExpressionRef ob, Symbol fncvalue, const vector<ExpressionRef>& sub) 
             : object(ob), functionName(fncvalue), subexpressions(sub) {}
 		MemberFunctionCall() {}
 
@@ -84,9 +125,14 @@ namespace KataScript {
 	struct If {
 		ExpressionRef testExpression;
 		vector<ExpressionRef> subexpressions;
+        // slots declared inside this block, cleared when it closes
+        size_t firstSlot = 0;
+        size_t endSlot = 0;
 
 		If(const If& o) {
 			testExpression = o.testExpression ? make_shared<Expression>(*o.testExpression) : nullptr;
+            firstSlot = o.firstSlot;
+            endSlot = o.endSlot;
 			for (auto sub : o.subexpressions) {
 				subexpressions.push_back(make_shared<Expression>(*sub));
 			}
@@ -101,8 +147,12 @@ namespace KataScript {
 		ExpressionRef testExpression;
 		ExpressionRef iterateExpression;
 		vector<ExpressionRef> subexpressions;
+        size_t firstSlot = 0;
+        size_t endSlot = 0;
 
 		Loop(const Loop& o) {
+            firstSlot = o.firstSlot;
+            endSlot = o.endSlot;
 			initExpression = o.initExpression ? make_shared<Expression>(*o.initExpression) : nullptr;
 			testExpression = o.testExpression ? make_shared<Expression>(*o.testExpression) : nullptr;
 			iterateExpression = o.iterateExpression ? make_shared<Expression>(*o.iterateExpression) : nullptr;
@@ -115,12 +165,23 @@ namespace KataScript {
 
 	struct Foreach {
         ExpressionRef listExpression;
-		string iterateName;
+		Symbol iterateName;
+        // foreach (key, value; collection) also gets the key or index, the name is empty without one
+        Symbol keyName;
 		vector<ExpressionRef> subexpressions;
+        size_t slot = NoSlot;
+        size_t keySlot = NoSlot;
+        size_t firstSlot = 0;
+        size_t endSlot = 0;
 
 		Foreach(const Foreach& o) {
             listExpression = o.listExpression ? make_shared<Expression>(*o.listExpression) : nullptr;
 			iterateName = o.iterateName;
+            keyName = o.keyName;
+            slot = o.slot;
+            keySlot = o.keySlot;
+            firstSlot = o.firstSlot;
+            endSlot = o.endSlot;
 			for (auto sub : o.subexpressions) {
 				subexpressions.push_back(make_shared<Expression>(*sub));
 			}
@@ -129,33 +190,72 @@ namespace KataScript {
 	};
 
     struct ResolveVar {
-        string name;
+        Symbol name;
+        size_t slot = NoSlot;
 
         ResolveVar(const ResolveVar& o) {
             name = o.name;
+            slot = o.slot;
         }
         ResolveVar() {}
-        ResolveVar(const string& n) : name(n) {}
+        ResolveVar(Symbol n) : name(n) {}
     };
 
     struct DefineVar {
-        string name;
+        Symbol name;
         ExpressionRef defineExpression;
+        size_t slot = NoSlot;
 
         DefineVar(const DefineVar& o) {
             name = o.name;
+            slot = o.slot;
             defineExpression = o.defineExpression ? make_shared<Expression>(*o.defineExpression) : nullptr;
         }
         DefineVar() {}
-        DefineVar(const string& n) : name(n) {}
-        DefineVar(const string& n, ExpressionRef defExpr) : name(n), defineExpression(defExpr) {}
+        DefineVar(Symbol n) : name(n) {}
+        DefineVar(Symbol n, ExpressionRef defExpr) : name(n), defineExpression(defExpr) {}
     };
 
+    // an operator that a constant was folded through, and the function it held at the time
+    struct FoldedOperator {
+        ValueRef function;
+        FunctionRef folded;
+    };
+
+    // scripts can replace an operator at any time, so a folded result only stands until one of its operators changes
+    inline bool operatorsUnchanged(const vector<FoldedOperator>& operators) {
+        return std::all_of(operators.begin(), operators.end(), [](const FoldedOperator& op) {
+            auto fnc = std::get_if<FunctionRef>(&op.function->value);
+            return fnc && *fnc == op.folded;
+        });
+    }
+
     struct Constant {
         Value val;
+        // the last value handed out, reused once nothing else holds it
+        ValueRef recycled;
+        // for values folded from operator calls while parsing, the call they came from and every operator in it
+        ExpressionRef unfolded;
+        vector<FoldedOperator> operators;
 
         Constant() {}
         Constant(const Value& v) : val(v) {}
+        Constant(const Constant& o) : val(o.val), unfolded(o.unfolded), operators(o.operators) {}
+
+        // whether val can be used, or the unfolded call has to run instead
+        bool stillFolded() const {
+            return !unfolded || operatorsUnchanged(operators);
+        }
+
+        // every evaluation needs a fresh value since the result can be modified
+        ValueRef get() {
+            if (recycled && recycled.use_count() == 1) {
+                recycled->value = val.value;
+            } else {
+                recycled = makeValue(val);
+            }
+            return recycled;
+        }
     };
 
     enum class ExpressionType : uint8_t {
@@ -209,9 +309,9 @@ namespace KataScript {
         ExpressionType type;
 		ExpressionRef parent = nullptr;
         
-        Expression(ExpressionRef obj, const string& name) 
+        Expression(ExpressionRef obj, Symbol name) 
             : type(ExpressionType::MemberVariable), expression(MemberVariable(obj, name)), parent(nullptr) {}
-        Expression(ExpressionRef obj, const string& name, const vector<ExpressionRef> subs) 
+        Expression(ExpressionRef obj, Symbol name, const vector<ExpressionRef> subs) 
             : type(ExpressionType::MemberFunctionCall), expression(MemberFunctionCall(obj, name, subs)), parent(nullptr) {}
 		Expression(FunctionRef val, ExpressionRef par = nullptr) 
             : type(ExpressionType::FunctionDef), expression(FunctionExpression(val)), parent(par) {}
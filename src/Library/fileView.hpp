@@ -0,0 +1,123 @@
+#pragma once
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace KataScript {
+    // read only view of a whole file, regular files are memory mapped instead of copied
+    // anything else, like a pipe, is left closed unless readUnmappable asks to read it into memory
+    class FileView {
+        string_view contents;
+        string storage;
+        bool opened = false;
+        bool mapped = false;
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#else
+        void* address = nullptr;
+        size_t length = 0;
+#endif
+
+        bool map(const string& path) {
+#ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            LARGE_INTEGER size;
+            if (file == INVALID_HANDLE_VALUE || GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+                return false;
+            }
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mapping) {
+                return false;
+            }
+            auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if (!view) {
+                return false;
+            }
+            contents = string_view(static_cast<const char*>(view), (size_t)size.QuadPart);
+#else
+            auto fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat info;
+            if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {
+                close(fd);
+                return false;
+            }
+            length = (size_t)info.st_size;
+            address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            // the mapping stays valid after the descriptor is closed
+            close(fd);
+            if (address == MAP_FAILED) {
+                address = nullptr;
+                return false;
+            }
+            contents = string_view(static_cast<const char*>(address), length);
+#endif
+            return true;
+        }
+
+        void unmap() {
+#ifdef _WIN32
+            if (mapped) {
+                UnmapViewOfFile(contents.data());
+            }
+            if (mapping) {
+                CloseHandle(mapping);
+                mapping = nullptr;
+            }
+            if (file != INVALID_HANDLE_VALUE) {
+                CloseHandle(file);
+                file = INVALID_HANDLE_VALUE;
+            }
+#else
+            if (address) {
+                munmap(address, length);
+                address = nullptr;
+            }
+#endif
+        }
+
+    public:
+        FileView(const string& path, bool readUnmappable) {
+            mapped = map(path);
+            if (mapped) {
+                opened = true;
+                return;
+            }
+            unmap();
+            if (readUnmappable) {
+                auto stream = std::ifstream(path, std::ios::binary);
+                if (stream) {
+                    std::stringstream buffer;
+                    buffer << stream.rdbuf();
+                    storage = buffer.str();
+                    contents = storage;
+                    opened = true;
+                }
+            }
+        }
+        FileView(const FileView&) = delete;
+        FileView& operator=(const FileView&) = delete;
+        ~FileView() {
+            unmap();
+        }
+
+        bool isOpen() const { return opened; }
+        bool isMapped() const { return mapped; }
+        string_view data() const { return contents; }
+    };
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+namespace KataScript {
+    // where a running foreach is up to, both engines step through collections with this
+    // arrays, lists and strings are gone through as they were when the loop started
+    // the state holds a copy of the collection, which shares its data, so a body that changes it gets its own copy instead
+    // dictionaries are gone through live, keys the body adds are reached and keys it erases are skipped
+    struct ForEachState {
+        ValueRef var;
+        // gets the dictionary key, or the index for everything else, when the loop asks for it
+        ValueRef key;
+        Value collection;
+        Dictionary::Pin pin;
+        size_t index = 0;
+
+        ForEachState() = default;
+        ForEachState(ValueRef var_, ValueRef key_, const Value& collection_) : var(std::move(var_)), key(std::move(key_)), collection(collection_) {
+            if (collection.getType() == Type::ArrayMember) {
+                collection = *collection.getArrayMember().getValue();
+            }
+            if (collection.getType() == Type::Dictionary) {
+                pin = Dictionary::Pin(collection.getDictionary());
+            }
+        }
+
+        // assign the next element to the loop variable, false once there are none left
+        bool next() {
+            switch (collection.getType()) {
+            case Type::Dictionary: {
+                auto entry = collection.getDictionary()->next(index);
+                if (!entry) {
+                    return false;
+                }
+                if (key) {
+                    *key = entry->first;
+                }
+                *var = *entry->second;
+                return true;
+            }
+            case Type::List: {
+                auto& list = std::as_const(collection).getList();
+                if (index >= list.size()) {
+                    return false;
+                }
+                setIndex();
+                *var = *list[index++];
+                return true;
+            }
+            case Type::Array: {
+                // elements go straight into the loop variable
+                auto& arr = std::as_const(collection).getArray();
+                if (index >= arr.size()) {
+                    return false;
+                }
+                setIndex();
+                loadArrayElement(arr, (Int)index++, *var);
+                return true;
+            }
+            case Type::String: {
+                auto& str = std::as_const(collection).getString();
+                if (index >= str.size()) {
+                    return false;
+                }
+                setIndex();
+                // the loop variable's string is reused when nothing else holds it
+                if (var->getType() == Type::String && !get<CopyOnWrite<string>>(var->value).isShared()) {
+                    var->getString().assign(1, str[index++]);
+                } else {
+                    var->value = string(1, str[index++]);
+                }
+                return true;
+            }
+            default:
+                return false;
+            }
+        }
+
+    private:
+        void setIndex() {
+            if (key) {
+                key->value = (Int)index;
+            }
+        }
+    };
+}
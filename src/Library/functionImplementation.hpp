@@ -13,43 +13,201 @@ namespace KataScript {
         }
     }
 
+    // gives function arguments and var locals fixed slots in the call frame
+    // names are resolved lexically, anything not declared in the function stays a name lookup
+    struct SlotResolver {
+        vector<Symbol>& names;
+        // the declarations visible in each open block
+        vector<vector<size_t>> blocks;
+
+        SlotResolver(vector<Symbol>& slotNames) : names(slotNames) {}
+
+        size_t find(Symbol name) {
+            for (auto block = blocks.rbegin(); block != blocks.rend(); ++block) {
+                for (auto slot = block->rbegin(); slot != block->rend(); ++slot) {
+                    if (names[*slot] == name) {
+                        return *slot;
+                    }
+                }
+            }
+            return NoSlot;
+        }
+
+        size_t declare(Symbol name) {
+            // declaring the same name twice in a block reuses the variable
+            for (auto slot : blocks.back()) {
+                if (names[slot] == name) {
+                    return slot;
+                }
+            }
+            names.push_back(name);
+            blocks.back().push_back(names.size() - 1);
+            return names.size() - 1;
+        }
+
+        void resolveBlock(const vector<ExpressionRef>& subs, size_t& firstSlot, size_t& endSlot) {
+            blocks.emplace_back();
+            firstSlot = names.size();
+            resolve(subs);
+            endSlot = names.size();
+            blocks.pop_back();
+        }
+
+        void resolve(const vector<ExpressionRef>& subs) {
+            for (auto&& sub : subs) {
+                resolve(sub);
+            }
+        }
+
+        void resolve(const ExpressionRef& exp) {
+            if (!exp) {
+                return;
+            }
+            switch (exp->type) {
+            case ExpressionType::ResolveVar: {
+                auto& resolveVar = get<ResolveVar>(exp->expression);
+                resolveVar.slot = find(resolveVar.name);
+            }
+                break;
+            case ExpressionType::DefineVar: {
+                // the variable exists while its value is being computed, same as with names
+                auto& def = get<DefineVar>(exp->expression);
+                def.slot = declare(def.name);
+                resolve(def.defineExpression);
+            }
+                break;
+            case ExpressionType::MemberVariable: {
+                auto& expr = get<MemberVariable>(exp->expression);
+                if (expr.object) {
+                    resolve(expr.object);
+                } else {
+                    expr.slot = find(expr.name);
+                }
+            }
+                break;
+            case ExpressionType::MemberFunctionCall: {
+                auto& expr = get<MemberFunctionCall>(exp->expression);
+                resolve(expr.object);
+                resolve(expr.subexpressions);
+            }
+                break;
+            case ExpressionType::FunctionCall:
+                resolve(get<FunctionExpression>(exp->expression).subexpressions);
+                break;
+            case ExpressionType::Return:
+                resolve(get<Return>(exp->expression).expression);
+                break;
+            case ExpressionType::Loop: {
+                // the init, test, body and iterate expressions all share the loop scope
+                auto& loopexp = get<Loop>(exp->expression);
+                blocks.emplace_back();
+                loopexp.firstSlot = names.size();
+                resolve(loopexp.initExpression);
+                resolve(loopexp.testExpression);
+                resolve(loopexp.subexpressions);
+                resolve(loopexp.iterateExpression);
+                loopexp.endSlot = names.size();
+                blocks.pop_back();
+            }
+                break;
+            case ExpressionType::ForEach: {
+                // the loop variable only gets a slot if it already has one, otherwise it's created by name
+                auto& foreach = get<Foreach>(exp->expression);
+                foreach.slot = find(foreach.iterateName);
+                foreach.keySlot = foreach.keyName != Symbol() ? find(foreach.keyName) : NoSlot;
+                blocks.emplace_back();
+                foreach.firstSlot = names.size();
+                resolve(foreach.listExpression);
+                resolve(foreach.subexpressions);
+                foreach.endSlot = names.size();
+                blocks.pop_back();
+            }
+                break;
+            case ExpressionType::IfElse:
+                for (auto& express : get<IfElse>(exp->expression)) {
+                    resolve(express.testExpression);
+                    resolveBlock(express.subexpressions, express.firstSlot, express.endSlot);
+                }
+                break;
+            default:
+                // nested function definitions get their own frame
+                break;
+            }
+        }
+    };
+
+    void KataScriptInterpreter::resolveSlots(FunctionRef fnc) {
+        // constructors keep their arguments on the class scope
+        if (fnc->type == FunctionType::constructor || fnc->getBodyType() != FunctionBodyType::Subexpressions) {
+            return;
+        }
+        fnc->slotNames = fnc->argNames;
+        SlotResolver resolver(fnc->slotNames);
+        resolver.blocks.emplace_back();
+        for (size_t i = 0; i < fnc->argNames.size(); ++i) {
+            resolver.blocks.back().push_back(i);
+        }
+        resolver.resolve(get<vector<ExpressionRef>>(fnc->body));
+    }
+
+    // an immediate argument is a temporary nothing else holds, so its value is copied in instead of being boxed to share it
+    inline ValueRef argument(const ValueRef& arg) {
+        return arg.isImmediate() ? makeImmediate(*arg) : arg;
+    }
+
     ValueRef KataScriptInterpreter::callFunction(FunctionRef fnc, ScopeRef scope, const List& args, Class* classs) {
         switch (fnc->getBodyType()) {
             case FunctionBodyType::Subexpressions: {
+                if (fnc->unparsedBody) {
+                    parseSkippedBody(fnc);
+                }
                 auto& subexpressions = get<vector<ExpressionRef>>(fnc->body);
                 // get function scope
-                scope = fnc->type == FunctionType::constructor ? resolveScope(fnc->name, scope) : newScope(fnc->name, scope);
-                vector<string> newVars;
-                for (size_t i = 0; i < fnc->argNames.size(); ++i) {
-                    auto& ref = scope->variables[fnc->argNames[i]];
-                    if (ref == nullptr) {
-                        newVars.push_back(fnc->argNames[i]);
+                scope = fnc->type == FunctionType::constructor ? resolveScope(fnc->name, scope) : acquireScope(fnc->name, scope);
+                vector<Symbol> newVars;
+                if (fnc->slotNames.size()) {
+                    // arguments go straight into their slots
+                    scope->slots.assign(fnc->slotNames.size(), nullptr);
+                    scope->slotNames = &fnc->slotNames;
+                    scope->frame = scope.get();
+                    for (size_t i = 0; i < fnc->argNames.size(); ++i) {
+                        scope->slots[i] = i < args.size() ? argument(args[i]) : makeImmediate();
                     }
-                    if (i < args.size()) {
-                        ref = args[i];
-                    } else {
-                        ref = makeNull();
+                } else {
+                    for (size_t i = 0; i < fnc->argNames.size(); ++i) {
+                        auto& ref = scope->variables[fnc->argNames[i]];
+                        if (ref == nullptr) {
+                            newVars.push_back(fnc->argNames[i]);
+                        }
+                        if (i < args.size()) {
+                            ref = argument(args[i]);
+                        } else {
+                            ref = makeImmediate();
+                        }
                     }
                 }
 
                 ValueRef returnVal = nullptr;
 
-                if (fnc->type == FunctionType::constructor) {
-                    returnVal = make_shared<Value>(make_shared<Class>(scope));
+                if (engine == ExecutionEngine::Bytecode) {
+                    auto chunk = compileFunction(fnc);
+                    if (fnc->type == FunctionType::constructor) {
+                        returnVal = makeValue(make_shared<Class>(scope));
+                        runChunk(*chunk, scope, returnVal->getClass().get());
+                    } else {
+                        returnVal = runChunk(*chunk, scope, classs);
+                    }
+                } else if (fnc->type == FunctionType::constructor) {
+                    returnVal = makeValue(make_shared<Class>(scope));
                     for (auto&& sub : subexpressions) {
                         getValue(sub, scope, returnVal->getClass().get());
                     }
                 } else {
                     for (auto&& sub : subexpressions) {
-                        if (sub->type == ExpressionType::Return) {
-                            returnVal = getValue(sub, scope, classs);
+                        auto result = consolidated(sub, scope, classs);
+                        if (result.type == ExpressionType::Return) {
+                            returnVal = std::move(result.value);
                             break;
-                        } else {
-                            auto result = consolidated(sub, scope, classs);
-                            if (result->type == ExpressionType::Return) {
-                                returnVal = get<ValueRef>(result->expression);
-                                break;
-                            }
                         }
                     }
                 }
@@ -59,27 +217,27 @@ namespace KataScript {
                         scope->variables.erase(vr);
                         returnVal->getClass()->variables.erase(vr);
                     }
+                    closeScope(scope);
+                } else {
+                    releaseScope(scope);
                 }
-
-                closeScope(scope);
-                return returnVal ? returnVal : makeNull();
+                return returnVal ? std::move(returnVal) : makeNull();
             }
             case FunctionBodyType::Lambda: {
-                scope = newScope(fnc->name, scope);
+                // plain lambdas never see a scope, so they don't need one
                 auto returnVal = get<Lambda>(fnc->body)(args);
-                closeScope(scope);
-                return returnVal ? returnVal : makeNull();
+                return returnVal ? std::move(returnVal) : makeNull();
             }
             case FunctionBodyType::ScopedLambda: {
-                scope = newScope(fnc->name, scope);
+                scope = acquireScope(fnc->name, scope);
                 auto returnVal = get<ScopedLambda>(fnc->body)(scope, args);
-                closeScope(scope);
-                return returnVal ? returnVal : makeNull();
+                releaseScope(scope);
+                return returnVal ? std::move(returnVal) : makeNull();
             }
             case FunctionBodyType::ClassLambda: {
                 scope = resolveScope(fnc->name, scope);
                 if (fnc->type == FunctionType::constructor) {
-                    auto returnVal = make_shared<Value>(make_shared<Class>(scope));
+                    auto returnVal = makeValue(make_shared<Class>(scope));
                     get<ClassLambda>(fnc->body)(returnVal->getClass().get(), scope, args);
                     closeScope(scope);
                     return returnVal;
@@ -91,6 +249,16 @@ namespace KataScript {
                 closeScope(scope);
                 return ret;
             }
+            case FunctionBodyType::LazyLambda: {
+                // the arguments were already evaluated, so the thunks just hand them over
+                vector<Thunk> thunks;
+                thunks.reserve(args.size());
+                for (auto&& arg : args) {
+                    thunks.emplace_back([arg]() { return arg; });
+                }
+                auto returnVal = get<LazyLambda>(fnc->body)(thunks);
+                return returnVal ? std::move(returnVal) : makeNull();
+            }
         }
 
         //empty func
@@ -100,6 +268,7 @@ namespace KataScript {
     FunctionRef KataScriptInterpreter::newFunction(const string& name, ScopeRef scope, FunctionRef func) {
         auto& ref = scope->functions[name];
         ref = func;
+        ++scope->functionsVersion;
         if (ref->type == FunctionType::free && scope->isClassScope) {
             ref->type = FunctionType::member;
         }
@@ -119,6 +288,7 @@ namespace KataScript {
     FunctionRef KataScriptInterpreter::newConstructor(const string& name, ScopeRef scope, FunctionRef func) {
         auto& ref = scope->functions[name];
         ref = func;
+        ++scope->functionsVersion;
         ref->type = FunctionType::constructor;
         auto funcvar = resolveVariable(name, scope);
         funcvar->value = ref;
@@ -136,7 +306,9 @@ namespace KataScript {
     FunctionRef KataScriptInterpreter::newClass(const string& name, ScopeRef scope, const unordered_map<string, ValueRef>& variables, const ClassLambda& constructor, const unordered_map<string, ClassLambda>& functions) {
         scope = newClassScope(name, scope);
 
-        scope->variables = variables;
+        for (auto& var : variables) {
+            scope->variables[var.first] = var.second;
+        }
         FunctionRef ret = newConstructor(name, scope->parent, make_shared<Function>(name, constructor));
 
         for (auto& func : functions) {
@@ -149,12 +321,14 @@ namespace KataScript {
     }
 
     // name resolution for variables
-    ValueRef& KataScriptInterpreter::resolveVariable(const string& name, ScopeRef scope) {
+    ValueRef& KataScriptInterpreter::resolveVariable(Symbol name, ScopeRef scope) {
         auto initialScope = scope;
         while (scope) {
             auto iter = scope->variables.find(name);
             if (iter != scope->variables.end()) {
                 return iter->second;
+            } else if (auto slot = scope->findSlot(name)) {
+                return *slot;
             } else {
                 scope = scope->parent;
             }
@@ -170,7 +344,7 @@ namespace KataScript {
         return initialScope->insertVar(name, makeNull());
     }
 
-    ValueRef& KataScriptInterpreter::resolveVariable(const string& name, Class* classs, ScopeRef scope) {
+    ValueRef& KataScriptInterpreter::resolveVariable(Symbol name, Class* classs, ScopeRef scope) {
         if (classs) {
             auto iter = classs->variables.find(name);
             if (iter != classs->variables.end()) {
@@ -180,7 +354,7 @@ namespace KataScript {
         return resolveVariable(name, scope);
     }
 
-    FunctionRef KataScriptInterpreter::resolveFunction(const string& name, Class* classs, ScopeRef scope) {
+    FunctionRef KataScriptInterpreter::resolveFunction(Symbol name, Class* classs, ScopeRef scope) {
         if (classs) {
             auto iter = classs->functionScope->functions.find(name);
             if (iter != classs->functionScope->functions.end()) {
@@ -190,8 +364,38 @@ namespace KataScript {
         return resolveFunction(name, scope);
     }
 
+    // same as above, but remembers what the class lookup found for next time
+    FunctionRef KataScriptInterpreter::resolveFunction(Symbol name, Class* classs, ScopeRef scope, MethodCache& cache) {
+        if (classs) {
+            auto& classScope = classs->functionScope;
+            if (auto fnc = cache.find(classScope.get(), classScope->functionsVersion)) {
+                return fnc;
+            }
+            auto iter = classScope->functions.find(name);
+            if (iter != classScope->functions.end()) {
+                cache.insert(classScope, classScope->functionsVersion, iter->second);
+                return iter->second;
+            }
+        }
+        return resolveFunction(name, scope);
+    }
+
+    // find a member variable of a class instance, or nullptr if it doesn't have one
+    ValueRef* KataScriptInterpreter::findMember(Symbol name, Class* classs, MemberCache& cache) {
+        if (cache.layoutId == classs->variables.layoutId) {
+            return cache.location;
+        }
+        auto iter = classs->variables.find(name);
+        if (iter == classs->variables.end()) {
+            return nullptr;
+        }
+        cache.layoutId = classs->variables.layoutId;
+        cache.location = &iter->second;
+        return cache.location;
+    }
+
     // name lookup for callfunction api method
-    FunctionRef KataScriptInterpreter::resolveFunction(const string& name, ScopeRef scope) {
+    FunctionRef KataScriptInterpreter::resolveFunction(Symbol name, ScopeRef scope) {
         auto initialScope = scope;
         while (scope) {
             auto iter = scope->functions.find(name);
@@ -202,11 +406,12 @@ namespace KataScript {
             }
         }
         auto& func = initialScope->functions[name];
-        func = make_shared<Function>(name);
+        func = make_shared<Function>(name.getString());
+        ++initialScope->functionsVersion;
         return func;
     }
 
-    ScopeRef KataScriptInterpreter::resolveScope(const string& name, ScopeRef scope) {
+    ScopeRef KataScriptInterpreter::resolveScope(Symbol name, ScopeRef scope) {
         auto initialScope = scope;
         while (scope) {
             auto iter = scope->scopes.find(name);
@@ -217,7 +422,7 @@ namespace KataScript {
                 return iter->second;
             } else {
                 if (!scope->parent) {
-                    if (scope->name == name) {
+                    if (scope->name == name.getString()) {
                         if (initialScope != scope) {
                             scope->parent = initialScope;
                         }
@@ -227,6 +432,6 @@ namespace KataScript {
                 scope = scope->parent;
             }
         }
-        return initialScope->insertScope(make_shared<Scope>(name, initialScope));
+        return initialScope->insertScope(make_shared<Scope>(name.getString(), initialScope));
     }
 }
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+#include <filesystem>
+
+namespace KataScript {
+    // one version of a file on disk, editing the file gives it a different stamp
+    struct FileStamp {
+        string path;
+        int64_t modified = 0;
+        uintmax_t size = 0;
+
+        bool operator==(const FileStamp& o) const = default;
+
+        // the same file reached through different relative paths or links gets the same name
+        static std::filesystem::path canonical(const string& path) {
+            std::error_code error;
+            auto canonical = std::filesystem::weakly_canonical(path, error);
+            return error ? std::filesystem::path(path) : canonical;
+        }
+
+        // false if there is no such file
+        static bool get(const string& path, FileStamp& stamp) {
+            std::error_code error;
+            auto canonical = FileStamp::canonical(path);
+            auto modified = std::filesystem::last_write_time(canonical, error);
+            if (error) {
+                return false;
+            }
+            auto size = std::filesystem::file_size(canonical, error);
+            if (error) {
+                return false;
+            }
+            stamp.path = canonical.string();
+            stamp.modified = (int64_t)modified.time_since_epoch().count();
+            stamp.size = size;
+            return true;
+        }
+    };
+
+    // imported files in their parsed form, keyed by canonical path
+    // an entry is only used while the file still has the stamp it was parsed with
+    // one cache can be shared by any number of interpreters, see KataScriptInterpreter::setImportCache
+    class ImportCache {
+        struct Entry {
+            FileStamp stamp;
+            ProgramRef program;
+        };
+        unordered_map<string, Entry> entries;
+#ifndef KATASCRIPT_THREAD_UNSAFE
+        std::mutex lock;
+        std::atomic<uint64_t> hits = 0;
+        std::atomic<uint64_t> misses = 0;
+#else
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+#endif
+
+    public:
+        // the parsed file if it hasn't changed since, nullptr otherwise
+        ProgramRef find(const FileStamp& stamp) {
+#ifndef KATASCRIPT_THREAD_UNSAFE
+            auto l = std::unique_lock(lock);
+#endif
+            auto iter = entries.find(stamp.path);
+            if (iter != entries.end() && iter->second.stamp == stamp) {
+                ++hits;
+                return iter->second.program;
+            }
+            ++misses;
+            return nullptr;
+        }
+
+        void insert(const FileStamp& stamp, ProgramRef program) {
+#ifndef KATASCRIPT_THREAD_UNSAFE
+            auto l = std::unique_lock(lock);
+#endif
+            entries[stamp.path] = Entry{ stamp, program };
+        }
+
+        // imports that are skipped because the interpreter already has the file still count as hits
+        void countHit() {
+            ++hits;
+        }
+
+        // forget a file so the next import parses it again
+        void invalidate(const string& path) {
+            auto key = FileStamp::canonical(path).string();
+#ifndef KATASCRIPT_THREAD_UNSAFE
+            auto l = std::unique_lock(lock);
+#endif
+            entries.erase(key);
+        }
+
+        void clear() {
+#ifndef KATASCRIPT_THREAD_UNSAFE
+            auto l = std::unique_lock(lock);
+#endif
+            entries.clear();
+        }
+
+        size_t size() {
+#ifndef KATASCRIPT_THREAD_UNSAFE
+            auto l = std::unique_lock(lock);
+#endif
+            return entries.size();
+        }
+
+        uint64_t getHits() const { return hits; }
+        uint64_t getMisses() const { return misses; }
+        void resetCounters() {
+            hits = 0;
+            misses = 0;
+        }
+    };
+
+    using ImportCacheRef = shared_ptr<ImportCache>;
+}
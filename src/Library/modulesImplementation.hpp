@@ -50,7 +50,7 @@ namespace KataScript {
                 if (args.size() == 1) {
                     return args[0];
                 }
-                return make_shared<Value>(*args[0] + *args[1]);
+                return makeImmediate(*args[0] + *args[1]);
                 }},
 
             {"-", [this](const List& args) {
@@ -60,9 +60,9 @@ namespace KataScript {
                 if (args.size() == 1) {
                     auto zero = Value(Int(0));
                     upconvert(*args[0], zero);
-                    return make_shared<Value>(zero - *args[0]);
+                    return makeImmediate(zero - *args[0]);
                 }
-                return make_shared<Value>(*args[0] - *args[1]);
+                return makeImmediate(*args[0] - *args[1]);
                 }},
 
             {"*", [this](const List& args) {
@@ -72,7 +72,7 @@ namespace KataScript {
                 if (args.size() < 2) {
                     return makeNull();
                 }
-                return make_shared<Value>(*args[0] * *args[1]);
+                return makeImmediate(*args[0] * *args[1]);
                 }},
 
             {"/", [this](const List& args) {
@@ -82,7 +82,7 @@ namespace KataScript {
                 if (args.size() < 2) {
                     return makeNull();
                 }
-                return make_shared<Value>(*args[0] / *args[1]);
+                return makeImmediate(*args[0] / *args[1]);
                 }},
 
             {"%", [this](const List& args) {
@@ -92,7 +92,7 @@ namespace KataScript {
                 if (args.size() < 2) {
                     return makeNull();
                 }
-                return make_shared<Value>(*args[0] % *args[1]);
+                return makeImmediate(*args[0] % *args[1]);
                 }},
 
             {"==", [this](const List& args) {
@@ -100,9 +100,9 @@ namespace KataScript {
                     return resolveVariable("==");
                 }
                 if (args.size() < 2) {
-                    return make_shared<Value>(Int(0));
+                    return makeImmediate(Int(0));
                 }
-                return make_shared<Value>((Int)(*args[0] == *args[1]));
+                return makeImmediate((Int)(*args[0] == *args[1]));
                 }},
 
             {"!=", [this](const List& args) {
@@ -110,29 +110,9 @@ namespace KataScript {
                     return resolveVariable("!=");
                 }
                 if (args.size() < 2) {
-                    return make_shared<Value>(Int(0));
+                    return makeImmediate(Int(0));
                 }
-                return make_shared<Value>((Int)(*args[0] != *args[1]));
-                }},
-
-            {"||", [this](const List& args) {
-                if (args.size() == 0) {
-                    return resolveVariable("||");
-                }
-                if (args.size() < 2) {
-                    return make_shared<Value>(Int(1));
-                }
-                return make_shared<Value>((Int)(*args[0] || *args[1]));
-                }},
-
-            {"&&", [this](const List& args) {
-                if (args.size() == 0) {
-                    return resolveVariable("&&");
-                }
-                if (args.size() < 2) {
-                    return make_shared<Value>(Int(0));
-                }
-                return make_shared<Value>((Int)(*args[0] && *args[1]));
+                return makeImmediate((Int)(*args[0] != *args[1]));
                 }},
 
             {"++", [](const List& args) {
@@ -146,7 +126,7 @@ namespace KataScript {
                     return args[i];
                 } else {
                     // postfix
-                    auto val = make_shared<Value>(args[i]->value);
+                    auto val = makeImmediate(args[i]->value);
                     *args[i] += Value(Int(1));
                     return val;
                 }
@@ -163,7 +143,7 @@ namespace KataScript {
                     return args[i];
                 } else {
                     // postfix
-                    auto val = make_shared<Value>(args[i]->value);
+                    auto val = makeImmediate(args[i]->value);
                     *args[i] -= Value(Int(1));
                     return val;
                 }
@@ -218,9 +198,9 @@ namespace KataScript {
                     return resolveVariable(">");
                 }
                 if (args.size() < 2) {
-                    return make_shared<Value>(Int(0));
+                    return makeImmediate(Int(0));
                 }
-                return make_shared<Value>((Int)(*args[0] > *args[1]));
+                return makeImmediate((Int)(*args[0] > *args[1]));
                 }},
 
             {"<", [this](const List& args) {
@@ -228,9 +208,9 @@ namespace KataScript {
                     return resolveVariable("<");
                 }
                 if (args.size() < 2) {
-                    return make_shared<Value>(Int(0));
+                    return makeImmediate(Int(0));
                 }
-                return make_shared<Value>((Int)(*args[0] < *args[1]));
+                return makeImmediate((Int)(*args[0] < *args[1]));
                 }},
 
             {">=", [this](const List& args) {
@@ -238,9 +218,9 @@ namespace KataScript {
                     return resolveVariable(">=");
                 }
                 if (args.size() < 2) {
-                    return make_shared<Value>(Int(0));
+                    return makeImmediate(Int(0));
                 }
-                return make_shared<Value>((Int)(*args[0] >= *args[1]));
+                return makeImmediate((Int)(*args[0] >= *args[1]));
                 }},
 
             {"<=", [this](const List& args) {
@@ -248,14 +228,14 @@ namespace KataScript {
                     return resolveVariable("<=");
                 }
                 if (args.size() < 2) {
-                    return make_shared<Value>(Int(0));
+                    return makeImmediate(Int(0));
                 }
-                return make_shared<Value>((Int)(*args[0] <= *args[1]));
+                return makeImmediate((Int)(*args[0] <= *args[1]));
                 }},
 
             {"!", [](const List& args) {
                 if (args.size() == 0) {
-                    return make_shared<Value>(Int(0));
+                    return makeImmediate(Int(0));
                 }
                 if (args.size() == 1) {
                     if (args[0]->getType() != Type::Int) return makeNull();
@@ -263,10 +243,10 @@ namespace KataScript {
                     for (auto i = Int(1); i <= args[0]->getInt(); ++i) {
                         val *= i;
                     }
-                    return make_shared<Value>(val);
+                    return makeImmediate(val);
                 }
                 if (args.size() == 2) {
-                    return make_shared<Value>((Int)(!args[1]->getBool()));
+                    return makeImmediate((Int)(!args[1]->getBool()));
                 }
                 return makeNull();
                 }},
@@ -279,14 +259,23 @@ namespace KataScript {
                 return args[0];
                 }},
 
+            {"listliteral", [](const List& args) {
+                auto list = makeValue(List());
+                for (auto& arg : args) {
+                    list->getList().push_back(makeImmediate(arg->getType() == Type::ArrayMember ? arg->getArrayMember().getValue()->value : arg->value));
+                }
+                narrowListLiteral(*list);
+                return list;
+                }},
+
             {"copy", [](const List& args) {
                 if (args.size() == 0) {
                     return makeNull();
                 }
                 if (args[0]->getType() == Type::Class) {
-                    return make_shared<Value>(make_shared<Class>(*args[0]->getClass()));
+                    return makeImmediate(make_shared<Class>(*args[0]->getClass()));
                 }
-                return make_shared<Value>(args[0]->value);
+                return makeImmediate(args[0]->value);
                 }},
 
             {"listindex", [](const List& args) {
@@ -302,16 +291,21 @@ namespace KataScript {
 
                     switch (var->getType()) {
                     case Type::Array:
-                        return make_shared<Value>(ArrayMember{ var, args[1]->getInt() });
+                    {
+                        // elements are read by value, assignments to them are stored back by the caller
+                        auto element = makeImmediate();
+                        loadArrayElement(std::as_const(*var).getArray(), args[1]->getInt(), *element);
+                        return element;
+                    }
                     default:
-                        var = make_shared<Value>(var->value);
+                        var = makeValue(var->value);
                         var->upconvert(Type::List);
                         [[fallthrough]];
                     case Type::List:
                     {
                         auto ival = args[1]->getInt();
 
-                        auto& list = var->getList();
+                        auto& list = std::as_const(*var).getList();
                         if (ival < 0 || ival >= (Int)list.size()) {
                             throw Exception("Out of bounds list access index "s + std::to_string(ival) + ", list length " + std::to_string(list.size()));
                         } else {
@@ -323,7 +317,7 @@ namespace KataScript {
                     {
                         auto strval = args[1]->getString();
                         auto& struc = var->getClass();
-                        auto iter = struc->variables.find(strval);
+                        auto iter = struc->variables.find(Symbol::find(strval));
                         if (iter == struc->variables.end()) {
                             throw Exception("Class `"s + struc->name + "` does not contain member `" + strval + "`");
                         } else {
@@ -334,7 +328,7 @@ namespace KataScript {
                     case Type::Dictionary:
                     {
                         auto& dict = var->getDictionary();
-                        auto& ref = (*dict)[args[1]->getHash()];
+                        auto& ref = (*dict)[*args[1]];
                         if (ref == nullptr) {
                             ref = makeNull();
                         }
@@ -348,40 +342,40 @@ namespace KataScript {
         // casting
             {"bool", [](const List& args) {
                 if (args.size() == 0) {
-                    return make_shared<Value>(Int(0));
+                    return makeImmediate(Int(0));
                 }
                 auto val = *args[0];
                 val.hardconvert(Type::Int);
                 val.value = (Int)args[0]->getBool();
-                return make_shared<Value>(val);
+                return makeImmediate(val);
                 }},
 
             {"int", [](const List& args) {
                 if (args.size() == 0) {
-                    return make_shared<Value>(Int(0));
+                    return makeImmediate(Int(0));
                 }
                 auto val = *args[0];
                 val.hardconvert(Type::Int);
-                return make_shared<Value>(val);
+                return makeImmediate(val);
                 }},
 
             {"float", [](const List& args) {
                 if (args.size() == 0) {
-                    return make_shared<Value>(Float(0.0));
+                    return makeImmediate(Float(0.0));
                 }
                 auto val = *args[0];
                 val.hardconvert(Type::Float);
-                return make_shared<Value>(val);
+                return makeImmediate(val);
                 }},
 
             {"vec3", [](const List& args) {
                 if (args.size() == 0) {
-                    return make_shared<Value>(vec3());
+                    return makeImmediate(vec3());
                 }
                 if (args.size() < 3) {
                     auto val = *args[0];
                     val.hardconvert(Type::Float);
-                    return make_shared<Value>(vec3((float)val.getFloat()));
+                    return makeImmediate(vec3((float)val.getFloat()));
                 }
                 auto x = *args[0];
                 x.hardconvert(Type::Float);
@@ -389,44 +383,44 @@ namespace KataScript {
                 y.hardconvert(Type::Float);
                 auto z = *args[2];
                 z.hardconvert(Type::Float);
-                return make_shared<Value>(vec3((float)x.getFloat(), (float)y.getFloat(), (float)z.getFloat()));
+                return makeImmediate(vec3((float)x.getFloat(), (float)y.getFloat(), (float)z.getFloat()));
                 }},
 
             {"string", [](const List& args) {
                 if (args.size() == 0) {
-                    return make_shared<Value>(""s);
+                    return makeImmediate(""s);
                 }
                 auto val = *args[0];
                 val.hardconvert(Type::String);
-                return make_shared<Value>(val);
+                return makeImmediate(val);
                 }},
 
             {"array", [](const List& args) {
                 if (args.size() == 0) {
-                    return make_shared<Value>(Array());
+                    return makeImmediate(Array());
                 }
-                auto list = make_shared<Value>(args);
+                auto list = makeValue(args);
                 list->hardconvert(Type::Array);
                 return list;
                 }},
 
             {"list", [](const List& args) {
                 if (args.size() == 0) {
-                    return make_shared<Value>(List());
+                    return makeImmediate(List());
                 }
-                return make_shared<Value>(args);
+                return makeImmediate(args);
                 }},
 
             {"dictionary", [](const List& args) {
                 if (args.size() == 0) {
-                    return make_shared<Value>(make_shared<Dictionary>());
+                    return makeImmediate(make_shared<Dictionary>());
                 }
                 if (args.size() == 1) {
                     auto val = *args[0];
                     val.hardconvert(Type::Dictionary);
-                    return make_shared<Value>(val);
+                    return makeImmediate(val);
                 }
-                auto dict = make_shared<Value>(make_shared<Dictionary>());
+                auto dict = makeValue(make_shared<Dictionary>());
                 for (auto&& arg : args) {
                     auto val = *arg;
                     val.hardconvert(Type::Dictionary);
@@ -437,20 +431,20 @@ namespace KataScript {
 
             {"toarray", [](const List& args) {
                 if (args.size() == 0) {
-                    return make_shared<Value>(Array());
+                    return makeImmediate(Array());
                 }
                 auto val = *args[0];
                 val.hardconvert(Type::Array);
-                return make_shared<Value>(val);  
+                return makeImmediate(val);  
                 }},
 
             {"tolist", [](const List& args) {
                 if (args.size() == 0) {
-                    return make_shared<Value>(List());
+                    return makeImmediate(List());
                 }
                 auto val = *args[0];
                 val.hardconvert(Type::List);
-                return make_shared<Value>(val);
+                return makeImmediate(val);
                 }},
 
         // overal stdlib
@@ -460,11 +454,11 @@ namespace KataScript {
                 }
                 auto mainType = args[0]->getType();
                 if (mainType == Type::Array) {
-                    return make_shared<Value>(getTypeName(mainType) + "<"s + getTypeName(args[0]->getArray().getType()) + ">"s);
+                    return makeImmediate(getTypeName(mainType) + "<"s + getTypeName(std::as_const(*args[0]).getArray().getType()) + ">"s);
                 } else if (mainType == Type::Class) {
-                    return make_shared<Value>(args[0]->getClass()->name);
+                    return makeImmediate(args[0]->getClass()->name);
                 }
-                return make_shared<Value>(getTypeName(mainType));
+                return makeImmediate(getTypeName(mainType));
                 }},
 
             {"sqrt", [](const List& args) {
@@ -473,7 +467,7 @@ namespace KataScript {
                 }
                 auto val = *args[0];
                 val.hardconvert(Type::Float);
-                return make_shared<Value>(sqrt(val.getFloat()));
+                return makeImmediate(sqrt(val.getFloat()));
                 }},
 
             {"sin", [](const List& args) {
@@ -482,7 +476,7 @@ namespace KataScript {
                 }
                 auto val = *args[0];
                 val.hardconvert(Type::Float);
-                return make_shared<Value>(sin(val.getFloat()));
+                return makeImmediate(sin(val.getFloat()));
                 }},
 
             {"cos", [](const List& args) {
@@ -491,7 +485,7 @@ namespace KataScript {
                 }
                 auto val = *args[0];
                 val.hardconvert(Type::Float);
-                return make_shared<Value>(cos(val.getFloat()));
+                return makeImmediate(cos(val.getFloat()));
                 }},
 
             {"tan", [](const List& args) {
@@ -500,18 +494,18 @@ namespace KataScript {
                 }
                 auto val = *args[0];
                 val.hardconvert(Type::Float);
-                return make_shared<Value>(tan(val.getFloat()));
+                return makeImmediate(tan(val.getFloat()));
                 }},
 
             {"pow", [](const List& args) {
                 if (args.size() < 2) {
-                    return make_shared<Value>(Float(0));
+                    return makeImmediate(Float(0));
                 }
                 auto val = *args[0];
                 val.hardconvert(Type::Float);
                 auto val2 = *args[1];
                 val2.hardconvert(Type::Float);
-                return make_shared<Value>(pow(val.getFloat(), val2.getFloat()));
+                return makeImmediate(pow(val.getFloat(), val2.getFloat()));
                 }},
 
             {"abs", [](const List& args) {
@@ -520,10 +514,10 @@ namespace KataScript {
                 }
                 switch (args[0]->getType()) {
                 case Type::Int:
-                    return make_shared<Value>(Int(abs(args[0]->getInt())));
+                    return makeImmediate(Int(abs(args[0]->getInt())));
                     break;
                 case Type::Float:
-                    return make_shared<Value>(Float(fabs(args[0]->getFloat())));
+                    return makeImmediate(Float(fabs(args[0]->getFloat())));
                     break;
                 default:
                     return makeNull();
@@ -539,9 +533,9 @@ namespace KataScript {
                 auto val2 = *args[1];
                 upconvertThrowOnNonNumberToNumberCompare(val, val2);
                 if (val > val2) {
-                    return make_shared<Value>(val2.value);
+                    return makeImmediate(val2.value);
                 }
-                return make_shared<Value>(val.value);
+                return makeImmediate(val.value);
                 }},
 
             {"max", [](const List& args) {
@@ -552,9 +546,9 @@ namespace KataScript {
                 auto val2 = *args[1];
                 upconvertThrowOnNonNumberToNumberCompare(val, val2);
                 if (val < val2) {
-                    return make_shared<Value>(val2.value);
+                    return makeImmediate(val2.value);
                 }
-                return make_shared<Value>(val.value);
+                return makeImmediate(val.value);
                 }},
 
             {"swap", [](const List& args) {
@@ -583,17 +577,17 @@ namespace KataScript {
                 if (args.size() > 0) {
                     args[0]->value = s;
                 }
-                return make_shared<Value>(s);
+                return makeImmediate(s);
                 }},
 
             {"map", [this](const List& args) {
                 if (args.size() < 2 || args[1]->getType() != Type::Function) {
                     return makeNull();
                 }
-                auto ret = make_shared<Value>(List());
+                auto ret = makeValue(List());
                 auto& retList = ret->getList();
                 auto func = args[1]->getFunction();
-                List* list;
+                const List* list;
                 std::unique_ptr<Value> val;
                 List curryArgs = { makeNull() };
                 curryArgs.insert(curryArgs.end(), std::next(std::next(args.begin())), args.end());
@@ -604,7 +598,7 @@ namespace KataScript {
                     val->upconvert(Type::List);
                     list = &val->getList();
                 } else {
-                    list = &args[0]->getList();
+                    list = &std::as_const(*args[0]).getList();
                 }
 
                 retList.reserve(list->size());
@@ -634,21 +628,21 @@ namespace KataScript {
                     return iter;
                 }
 
-                for (auto&& v : args[0]->getList()) {
+                for (auto&& v : std::as_const(*args[0]).getList()) {
                     iter = callFunction(func, { iter, v });
                 }
                 return iter;
                 }},
 
             {"clock", [](const List&) {
-                return make_shared<Value>(Int(std::chrono::high_resolution_clock::now().time_since_epoch().count()));
+                return makeImmediate(Int(std::chrono::high_resolution_clock::now().time_since_epoch().count()));
                 }},
 
             {"getduration", [](const List& args) {
                 if (args.size() == 2 && args[0]->getType() == Type::Int && args[1]->getType() == Type::Int) {
                     std::chrono::duration<double> duration = std::chrono::high_resolution_clock::time_point(std::chrono::nanoseconds(args[1]->getInt())) -
                         std::chrono::high_resolution_clock::time_point(std::chrono::nanoseconds(args[0]->getInt()));
-                    return make_shared<Value>(Float(duration.count()));
+                    return makeImmediate(Float(duration.count()));
                 }
                 return makeNull();
                 }},
@@ -657,7 +651,7 @@ namespace KataScript {
                 if (args.size() == 1 && args[0]->getType() == Type::Int) {
                     std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - 
                         std::chrono::high_resolution_clock::time_point(std::chrono::nanoseconds(args[0]->getInt()));
-                    return make_shared<Value>(Float(duration.count()));
+                    return makeImmediate(Float(duration.count()));
                 }
                 return makeNull();
                 }},
@@ -665,22 +659,22 @@ namespace KataScript {
         // collection functions
             {"length", [](const List& args) {
                 if (args.size() == 0 || (int)args[0]->getType() < (int)Type::String) {
-                    return make_shared<Value>(Int(0));
+                    return makeImmediate(Int(0));
                 }
                 if (args[0]->getType() == Type::String) {
-                    return make_shared<Value>((Int)args[0]->getString().size());
+                    return makeImmediate((Int)std::as_const(*args[0]).getString().size());
                 } else
                 if (args[0]->getType() == Type::Array) {
-                    return make_shared<Value>((Int)args[0]->getArray().size());
+                    return makeImmediate((Int)std::as_const(*args[0]).getArray().size());
                 } else
                 if (args[0]->getType() == Type::List) {
-                    return make_shared<Value>((Int)args[0]->getList().size());
+                    return makeImmediate((Int)std::as_const(*args[0]).getList().size());
                 } else
                 if (args[0]->getType() == Type::List) {
-                    return make_shared<Value>((Int)args[0]->getList().size());
+                    return makeImmediate((Int)std::as_const(*args[0]).getList().size());
                 } else
                 if (args[0]->getType() == Type::Dictionary) {
-                    return make_shared<Value>((Int)args[0]->getDictionary()->size());
+                    return makeImmediate((Int)args[0]->getDictionary()->size());
                 }
 
                 return makeNull();
@@ -691,56 +685,56 @@ namespace KataScript {
                     return makeNull();
                 }
                 if (args[0]->getType() == Type::Array) {
-                    if (args[1]->getType() == args[0]->getArray().getType()) {
-                        switch (args[0]->getArray().getType()) {
+                    if (args[1]->getType() == std::as_const(*args[0]).getArray().getType()) {
+                        switch (std::as_const(*args[0]).getArray().getType()) {
                         case Type::Int:
                         {
-                            auto& arry = args[0]->getStdVector<Int>();
+                            auto& arry = std::as_const(*args[0]).getStdVector<Int>();
                             auto iter = find(arry.begin(), arry.end(), args[1]->getInt());
                             if (iter == arry.end()) {
                                 return makeNull();
                             }
-                            return make_shared<Value>((Int)(iter - arry.begin()));
+                            return makeImmediate((Int)(iter - arry.begin()));
                         }
                         break;
                         case Type::Float:
                         {
-                            auto& arry = args[0]->getStdVector<Float>();
+                            auto& arry = std::as_const(*args[0]).getStdVector<Float>();
                             auto iter = find(arry.begin(), arry.end(), args[1]->getFloat());
                             if (iter == arry.end()) {
                                 return makeNull();
                             }
-                            return make_shared<Value>((Int)(iter - arry.begin()));
+                            return makeImmediate((Int)(iter - arry.begin()));
                         }
                         break;
                         case Type::Vec3:
                         {
-                            auto& arry = args[0]->getStdVector<vec3>();
+                            auto& arry = std::as_const(*args[0]).getStdVector<vec3>();
                             auto iter = find(arry.begin(), arry.end(), args[1]->getVec3());
                             if (iter == arry.end()) {
                                 return makeNull();
                             }
-                            return make_shared<Value>((Int)(iter - arry.begin()));
+                            return makeImmediate((Int)(iter - arry.begin()));
                         }
                         break;
                         case Type::String:
                         {
-                            auto& arry = args[0]->getStdVector<string>();
-                            auto iter = find(arry.begin(), arry.end(), args[1]->getString());
+                            auto& arry = std::as_const(*args[0]).getStdVector<string>();
+                            auto iter = find(arry.begin(), arry.end(), std::as_const(*args[1]).getString());
                             if (iter == arry.end()) {
                                 return makeNull();
                             }
-                            return make_shared<Value>((Int)(iter - arry.begin()));
+                            return makeImmediate((Int)(iter - arry.begin()));
                         }
                         break;
                         case Type::Function:
                         {
-                            auto& arry = args[0]->getStdVector<FunctionRef>();
+                            auto& arry = std::as_const(*args[0]).getStdVector<FunctionRef>();
                             auto iter = find(arry.begin(), arry.end(), args[1]->getFunction());
                             if (iter == arry.end()) {
                                 return makeNull();
                             }
-                            return make_shared<Value>((Int)(iter - arry.begin()));
+                            return makeImmediate((Int)(iter - arry.begin()));
                         }
                         break;
                         default:
@@ -749,10 +743,19 @@ namespace KataScript {
                     }
                     return makeNull();
                 }
-                auto& list = args[0]->getList();
+                if (args[0]->getType() == Type::Dictionary) {
+                    // the index of a dictionary item is its key
+                    for (auto&& item : *args[0]->getDictionary()) {
+                        if (*item.second == *args[1]) {
+                            return makeImmediate(item.first.value);
+                        }
+                    }
+                    return makeNull();
+                }
+                auto& list = std::as_const(*args[0]).getList();
                 for (size_t i = 0; i < list.size(); ++i) {
                     if (*list[i] == *args[1]) {
-                        return make_shared<Value>((Int)i);
+                        return makeImmediate((Int)i);
                     }
                 }
                 return makeNull();
@@ -792,7 +795,7 @@ namespace KataScript {
                     }
                     args[0]->getList().erase(args[0]->getList().begin() + args[1]->getInt());
                 } else if (args[0]->getType() == Type::Dictionary) {
-                    args[0]->getDictionary()->erase(args[1]->getHash());
+                    args[0]->getDictionary()->erase(*args[1]);
                 }
                 return makeNull();
                 }},
@@ -895,23 +898,23 @@ namespace KataScript {
                     return makeNull();
                 }
                 if (args[0]->getType() == Type::Array) {
-                    switch (args[0]->getArray().getType()) {
+                    switch (std::as_const(*args[0]).getArray().getType()) {
                     case Type::Int:
-                        return make_shared<Value>(args[0]->getStdVector<Int>().front());
+                        return makeImmediate(std::as_const(*args[0]).getStdVector<Int>().front());
                     case Type::Float:
-                        return make_shared<Value>(args[0]->getStdVector<Float>().front());
+                        return makeImmediate(std::as_const(*args[0]).getStdVector<Float>().front());
                     case Type::Vec3:
-                        return make_shared<Value>(args[0]->getStdVector<vec3>().front());
+                        return makeImmediate(std::as_const(*args[0]).getStdVector<vec3>().front());
                     case Type::Function:
-                        return make_shared<Value>(args[0]->getStdVector<FunctionRef>().front());
+                        return makeImmediate(std::as_const(*args[0]).getStdVector<FunctionRef>().front());
                     case Type::String:
-                        return make_shared<Value>(args[0]->getStdVector<string>().front());
+                        return makeImmediate(std::as_const(*args[0]).getStdVector<string>().front());
                     default:
                         break;
                     }
                     return makeNull();
                 } else {
-                    return args[0]->getList().front();
+                    return std::as_const(*args[0]).getList().front();
                 }
                 }},
 
@@ -920,23 +923,23 @@ namespace KataScript {
                     return makeNull();
                 }
                 if (args[0]->getType() == Type::Array) {
-                    switch (args[0]->getArray().getType()) {
+                    switch (std::as_const(*args[0]).getArray().getType()) {
                     case Type::Int:
-                        return make_shared<Value>(args[0]->getStdVector<Int>().back());
+                        return makeImmediate(std::as_const(*args[0]).getStdVector<Int>().back());
                     case Type::Float:
-                        return make_shared<Value>(args[0]->getStdVector<Float>().back());
+                        return makeImmediate(std::as_const(*args[0]).getStdVector<Float>().back());
                     case Type::Vec3:
-                        return make_shared<Value>(args[0]->getStdVector<vec3>().back());
+                        return makeImmediate(std::as_const(*args[0]).getStdVector<vec3>().back());
                     case Type::Function:
-                        return make_shared<Value>(args[0]->getStdVector<FunctionRef>().back());
+                        return makeImmediate(std::as_const(*args[0]).getStdVector<FunctionRef>().back());
                     case Type::String:
-                        return make_shared<Value>(args[0]->getStdVector<string>().back());
+                        return makeImmediate(std::as_const(*args[0]).getStdVector<string>().back());
                     default:
                         break;
                     }
                     return makeNull();
                 } else {
-                    return args[0]->getList().back();
+                    return std::as_const(*args[0]).getList().back();
                 }
                 }},
 
@@ -944,7 +947,7 @@ namespace KataScript {
                 if (args.size() < 1 || (int)args[0]->getType() < (int)Type::String) {
                     return makeNull();
                 }
-                auto copy = make_shared<Value>(args[0]->value);
+                auto copy = makeValue(args[0]->value);
 
                 if (args[0]->getType() == Type::String) {
                     auto& str = copy->getString();
@@ -1001,7 +1004,7 @@ namespace KataScript {
             {"range", [](const List& args) {
                 if (args.size() == 2 && args[0]->getType() == args[1]->getType()) {
                     if (args[0]->getType() == Type::Int) {
-                        auto ret = make_shared<Value>(Array(vector<Int>{}));
+                        auto ret = makeValue(Array(vector<Int>{}));
                         auto& arry = ret->getStdVector<Int>();
                         auto a = args[0]->getInt();
                         auto b = args[1]->getInt();
@@ -1018,7 +1021,7 @@ namespace KataScript {
                         }
                         return ret;
                     } else if (args[0]->getType() == Type::Float) {
-                        auto ret = make_shared<Value>(Array(vector<Float>{}));
+                        auto ret = makeValue(Array(vector<Float>{}));
                         auto& arry = ret->getStdVector<Float>();
                         Float a = args[0]->getFloat();
                         Float b = args[1]->getFloat();
@@ -1047,31 +1050,31 @@ namespace KataScript {
                 auto intdexB = indexB.getInt();
 
                 if (args[0]->getType() == Type::String) {
-                    return make_shared<Value>(args[0]->getString().substr(intdexA, intdexB + 1 - intdexA));
+                    return makeImmediate(std::as_const(*args[0]).getString().substr(intdexA, intdexB + 1 - intdexA));
                 } else if (args[0]->getType() == Type::Array) {
-                    if (args[0]->getArray().getType() == args[1]->getType()) {
-                        switch (args[0]->getArray().getType()) {
+                    if (std::as_const(*args[0]).getArray().getType() == args[1]->getType()) {
+                        switch (std::as_const(*args[0]).getArray().getType()) {
                         case Type::Int:
-                            return make_shared<Value>(Array(vector<Int>(args[0]->getStdVector<Int>().begin() + intdexA, args[0]->getStdVector<Int>().begin() + intdexB)));
+                            return makeImmediate(Array(vector<Int>(std::as_const(*args[0]).getStdVector<Int>().begin() + intdexA, std::as_const(*args[0]).getStdVector<Int>().begin() + intdexB)));
                             break;
                         case Type::Float:
-                            return make_shared<Value>(Array(vector<Float>(args[0]->getStdVector<Float>().begin() + intdexA, args[0]->getStdVector<Float>().begin() + intdexB)));
+                            return makeImmediate(Array(vector<Float>(std::as_const(*args[0]).getStdVector<Float>().begin() + intdexA, std::as_const(*args[0]).getStdVector<Float>().begin() + intdexB)));
                             break;
                         case Type::Vec3:
-                            return make_shared<Value>(Array(vector<vec3>(args[0]->getStdVector<vec3>().begin() + intdexA, args[0]->getStdVector<vec3>().begin() + intdexB)));
+                            return makeImmediate(Array(vector<vec3>(std::as_const(*args[0]).getStdVector<vec3>().begin() + intdexA, std::as_const(*args[0]).getStdVector<vec3>().begin() + intdexB)));
                             break;
                         case Type::String:
-                            return make_shared<Value>(Array(vector<string>(args[0]->getStdVector<string>().begin() + intdexA, args[0]->getStdVector<string>().begin() + intdexB)));
+                            return makeImmediate(Array(vector<string>(std::as_const(*args[0]).getStdVector<string>().begin() + intdexA, std::as_const(*args[0]).getStdVector<string>().begin() + intdexB)));
                             break;
                         case Type::Function:
-                            return make_shared<Value>(Array(vector<FunctionRef>(args[0]->getStdVector<FunctionRef>().begin() + intdexA, args[0]->getStdVector<FunctionRef>().begin() + intdexB)));
+                            return makeImmediate(Array(vector<FunctionRef>(std::as_const(*args[0]).getStdVector<FunctionRef>().begin() + intdexA, std::as_const(*args[0]).getStdVector<FunctionRef>().begin() + intdexB)));
                             break;
                         default:
                             break;
                         }
                     }
                 } else {
-                    return make_shared<Value>(List(args[0]->getList().begin() + intdexA, args[0]->getList().begin() + intdexB));
+                    return makeImmediate(List(std::as_const(*args[0]).getList().begin() + intdexA, std::as_const(*args[0]).getList().begin() + intdexB));
                 }
                 return makeNull();
                 }},
@@ -1091,69 +1094,69 @@ namespace KataScript {
                     lpos = pos + replacewith.size();
                 }
                     
-                return make_shared<Value>(input);
+                return makeImmediate(input);
                 }},
 
             {"startswith", [](const List& args) {
                 if (args.size() < 2 || args[0]->getType() != Type::String || args[1]->getType() != Type::String) {
                     return makeNull();
                 }
-                return make_shared<Value>(Int(startswith(args[0]->getString(), args[1]->getString())));
+                return makeImmediate(Int(startswith(std::as_const(*args[0]).getString(), std::as_const(*args[1]).getString())));
                 }},
 
             {"endswith", [](const List& args) {
                 if (args.size() < 2 || args[0]->getType() != Type::String || args[1]->getType() != Type::String) {
                     return makeNull();
                 }
-                return make_shared<Value>(Int(endswith(args[0]->getString(), args[1]->getString())));
+                return makeImmediate(Int(endswith(std::as_const(*args[0]).getString(), std::as_const(*args[1]).getString())));
                 }},
 
             {"contains", [](const List& args) {
                 if (args.size() < 2 || (int)args[0]->getType() < (int)Type::Array) {
-                    return make_shared<Value>(Int(0));
+                    return makeImmediate(Int(0));
                 }
                 if (args[0]->getType() == Type::Array) {
                     auto item = *args[1];
-                    switch (args[0]->getArray().getType()) {
+                    switch (std::as_const(*args[0]).getArray().getType()) {
                     case Type::Int:
                         item.hardconvert(Type::Int);
-                        return make_shared<Value>((Int)contains(args[0]->getStdVector<Int>(), item.getInt()));
+                        return makeImmediate((Int)contains(std::as_const(*args[0]).getStdVector<Int>(), item.getInt()));
                     case Type::Float:
                         item.hardconvert(Type::Float);
-                        return make_shared<Value>((Int)contains(args[0]->getStdVector<Float>(), item.getFloat()));
+                        return makeImmediate((Int)contains(std::as_const(*args[0]).getStdVector<Float>(), item.getFloat()));
                     case Type::Vec3:
                         item.hardconvert(Type::Vec3);
-                        return make_shared<Value>((Int)contains(args[0]->getStdVector<vec3>(), item.getVec3()));
+                        return makeImmediate((Int)contains(std::as_const(*args[0]).getStdVector<vec3>(), item.getVec3()));
                     case Type::String:
                         item.hardconvert(Type::String);
-                        return make_shared<Value>((Int)contains(args[0]->getStdVector<string>(), item.getString()));
+                        return makeImmediate((Int)contains(std::as_const(*args[0]).getStdVector<string>(), item.getString()));
                     default:
                         break;
                     }
-                    return make_shared<Value>(Int(0));
+                    return makeImmediate(Int(0));
                 } else if (args[0]->getType() == Type::List) {
-                    auto& list = args[0]->getList();
+                    auto& list = std::as_const(*args[0]).getList();
                     for (size_t i = 0; i < list.size(); ++i) {
                         if (*list[i] == *args[1]) {
-                            return make_shared<Value>(Int(1));
+                            return makeImmediate(Int(1));
                         }
                     }
                 } else if (args[0]->getType() == Type::Dictionary) {
-                    return make_shared<Value>(Int(args[0]->getDictionary()->contains(args[1]->getHash())));
+                    return makeImmediate(Int(args[0]->getDictionary()->contains(*args[1])));
                 }
-                return make_shared<Value>(Int(0));
+                return makeImmediate(Int(0));
                 }},
 
             {"split", [](const List& args) {
                 if (args.size() > 0 && args[0]->getType() == Type::String) {
-                    if (args.size() == 1 || (args[1]->getType() == Type::String && args[1]->getString().size() == 0)) {
+                    if (args.size() == 1 || (args[1]->getType() == Type::String && std::as_const(*args[1]).getString().size() == 0)) {
                         vector<string> chars;
-                        for (auto c : args[0]->getString()) {
+                        for (auto c : std::as_const(*args[0]).getString()) {
                             chars.push_back(string(1,c));
                         }
-                        return make_shared<Value>(Array(chars));
+                        return makeImmediate(Array(chars));
                     }
-                    return make_shared<Value>(Array(split(args[0]->getString(), args[1]->getPrintString())));
+                    return makeImmediate(Array(split(std::as_const(*args[0]).getString(), args[1]->getPrintString())));
                 }
                 return makeNull();
                 }},
@@ -1199,6 +1202,9 @@ namespace KataScript {
                 }},
             { "applyfunction", [this](const List& args) {
                 if (args.size() < 2 || args[1]->getType() != Type::Class) {
+                    if (args[0]->getType() == Type::String && !Symbol::find(args[0]->getString()).exists()) {
+                        throw Exception("Cannot call non existant function: "s + args[0]->getString());
+                    }
                     auto func = args[0]->getType() == Type::Function ? args[0] : args[0]->getType() == Type::String ? resolveVariable(args[0]->getString()) : throw Exception("Cannot call non existant function: null");
                     auto list = List();
                     for (size_t i = 1; i < args.size(); ++i) {
@@ -1210,8 +1216,43 @@ namespace KataScript {
                 }},
         });
 
+        // boolean operators short circuit, so they only evaluate the right side when they need it
+        newFunction("||", modules.back().scope, [this](const vector<Thunk>& args) {
+            if (args.size() == 0) {
+                return resolveVariable("||");
+            }
+            if (args.size() < 2) {
+                return makeImmediate(Int(1));
+            }
+            return makeImmediate((Int)(args[0]()->getBool() || args[1]()->getBool()));
+            });
+
+        newFunction("&&", modules.back().scope, [this](const vector<Thunk>& args) {
+            if (args.size() == 0) {
+                return resolveVariable("&&");
+            }
+            if (args.size() < 2) {
+                return makeImmediate(Int(0));
+            }
+            return makeImmediate((Int)(args[0]()->getBool() && args[1]()->getBool()));
+            });
+
         listIndexFunctionVarLocation = resolveVariable("listindex", modules.back().scope);
+        listLiteralFunctionVarLocation = resolveVariable("listliteral", modules.back().scope);
         identityFunctionVarLocation = resolveVariable("identity", modules.back().scope);
         setFunctionVarLocation = resolveVariable("=", modules.back().scope);
+        listIndexFunction = listIndexFunctionVarLocation->getFunction();
+
+        for (auto name : { "=", "+=", "-=", "*=", "/=", "++", "--" }) {
+            assignmentOperators.push_back(resolveFunction(name, modules.back().scope));
+        }
+
+        for (auto name : { "+", "-", "*", "/", "%", "==", "!=", ">", "<", ">=", "<=", "!", "&&", "||", "identity" }) {
+            pureOperators.push_back(resolveFunction(name, modules.back().scope));
+            auto op = getBuiltinOperator(name);
+            if (op != BuiltinOperator::None) {
+                builtinOperators[(size_t)op] = pureOperators.back();
+            }
+        }
 	}
 }
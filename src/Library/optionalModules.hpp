@@ -14,15 +14,15 @@ namespace KataScript {
                     auto t = std::ofstream(args[1]->getString(), std::ofstream::out);
                     t << args[0]->getString();
                     t.flush();
-                    return make_shared<Value>(true);
+                    return makeValue(true);
                 }
-                return make_shared<Value>(false);
+                return makeValue(false);
             }},
             { "readFile", [](const List& args) {
                 if (args.size() == 1 && args[0]->getType() == Type::String) {
                     std::stringstream buffer;
                     buffer << std::ifstream(args[0]->getString()).rdbuf();
-                    return make_shared<Value>(buffer.str());
+                    return makeValue(buffer.str());
                 }
                 return makeNull();
             }},
@@ -36,7 +36,7 @@ namespace KataScript {
                     auto ptr = new std::thread([this, func]() {
                         callFunction(func, {});
                     });
-                    return make_shared<Value>(ptr);
+                    return makeValue(ptr);
                 }
                 return makeNull();
             }},
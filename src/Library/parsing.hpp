@@ -1,79 +1,6 @@
 #pragma once
 
 namespace KataScript {
-    // tokenizer special characters
-    const string WhitespaceChars = " \t\n"s;
-    const string GrammarChars = " \t\n,.(){}[];+-/*%<>=!&|\""s;
-    const string MultiCharTokenStartChars = "+-/*<>=!&|"s;
-    const string NumericChars = "0123456789."s;
-    const string NumericStartChars = "0123456789."s;
-    const string DisallowedIdentifierStartChars = "0123456789.- \t\n,.(){}[];+-/*%<>=!&|\""s;
-
-    vector<string_view> ViewTokenize(string_view input) {
-        vector<string_view> ret;
-        if (input.empty()) return ret;
-        bool exitFromComment = false;
-
-        size_t pos = 0;
-        size_t lpos = 0;
-        while ((pos = input.find_first_of(GrammarChars, lpos)) != string::npos) {
-            size_t len = pos - lpos;
-            // differentiate between decimals and dot syntax for function calls
-            if (input[pos] == '.' && pos + 1 < input.size() && contains(NumericChars, input[pos + 1])) {
-                pos = input.find_first_of(GrammarChars, pos + 1);
-                ret.push_back(input.substr(lpos, pos - lpos));
-                lpos = pos;
-                continue;
-            }
-            if (len) {
-                ret.push_back(input.substr(lpos, pos - lpos));
-                lpos = pos;
-            } else {
-                // handle strings and escaped strings
-                if (input[pos] == '\"') {
-                    auto originalPos = pos;
-                    auto testpos = lpos + 1;
-                    pos = input.find('\"', testpos);
-                    if (pos == string::npos) {
-                        throw Exception("Quote mismatch at "s + string(input.substr(lpos, input.size() - lpos)));
-                    }
-
-                    lpos = pos + 1;
-                    ret.push_back(input.substr(originalPos, lpos - originalPos));                    
-                    continue;
-                }
-            }
-            // special case for negative numbers
-            if (input[pos] == '-' && contains(NumericChars, input[pos + 1])
-                && (ret.size() == 0 || contains(MultiCharTokenStartChars, ret.back().back()))) {
-                pos = input.find_first_of(GrammarChars, pos + 1);
-                if (input[pos] == '.' && pos + 1 < input.size() && contains(NumericChars, input[pos + 1])) {
-                    pos = input.find_first_of(GrammarChars, pos + 1);
-                }
-                ret.push_back(input.substr(lpos, pos - lpos));
-                lpos = pos;
-            } else if (!contains(WhitespaceChars, input[pos])) {
-                // process multicharacter special tokens like ++, //, -=, etc
-                auto stride = 1;
-                if (contains(MultiCharTokenStartChars, input[pos]) && pos + 1 < input.size() && contains(MultiCharTokenStartChars, input[pos + 1])) {
-                    if (input[pos] == '/' && input[pos + 1] == '/') {
-                        exitFromComment = true;
-                        break;
-                    }
-                    ++stride;
-                }
-                ret.push_back(input.substr(lpos, stride));
-                lpos += stride;
-            } else {
-                ++lpos;
-            }
-        }
-        if (!exitFromComment && lpos < input.length()) {
-            ret.push_back(input.substr(lpos, input.length()));
-        }
-        return ret;
-    }
-
     // functions for figuring out the type of token
 
     bool isStringLiteral(string_view test) {
@@ -85,12 +12,12 @@ namespace KataScript {
     }
 
     bool isVarOrFuncToken(string_view test) {
-        return (test.size() > 0 && !contains(DisallowedIdentifierStartChars, test[0]));
+        return (test.size() > 0 && !isCharClass(test[0], CharClass::DisallowedIdentifierStart));
     }
 
     bool isNumeric(string_view test) {
-        if (test.size() > 1 && test[0] == '-') contains(NumericStartChars, test[1]);
-        return (test.size() > 0 && contains(NumericStartChars, test[0]));
+        if (test.size() > 1 && test[0] == '-') isCharClass(test[1], CharClass::Numeric);
+        return (test.size() > 0 && isCharClass(test[0], CharClass::Numeric));
     }
 
     bool isMathOperator(string_view test) {
@@ -98,7 +25,7 @@ namespace KataScript {
             return contains("+-*/%<>=!"s, test[0]);
         }
         if (test.size() == 2) {
-            return contains("=+-&|"s, test[1]) && contains(MultiCharTokenStartChars, test[0]);
+            return contains("=+-&|"s, test[1]) && isCharClass(test[0], CharClass::MultiCharTokenStart);
         }
         return false;
     }
@@ -128,12 +55,27 @@ namespace KataScript {
         return (test.size() == 1 && (test[0] == ']' || test[0] == ')'));
     }
 
-    bool needsUnaryPlacementFix(const vector<string_view>& strings, size_t i) {
-        return (isUnaryMathOperator(strings[i]) && (i == 0 || !(isClosingBracketOrParen(strings[i - 1]) || isVarOrFuncToken(strings[i - 1]) || isNumeric(strings[i - 1]))));
+    BuiltinOperator getBuiltinOperator(string_view token) {
+        static const unordered_map<string_view, BuiltinOperator> operators = {
+            {"+", BuiltinOperator::Add},
+            {"-", BuiltinOperator::Subtract},
+            {"*", BuiltinOperator::Multiply},
+            {"/", BuiltinOperator::Divide},
+            {"%", BuiltinOperator::Modulo},
+            {"==", BuiltinOperator::Equal},
+            {"!=", BuiltinOperator::NotEqual},
+            {"<", BuiltinOperator::Less},
+            {">", BuiltinOperator::Greater},
+            {"<=", BuiltinOperator::LessEqual},
+            {">=", BuiltinOperator::GreaterEqual},
+        };
+        auto iter = operators.find(token);
+        return iter == operators.end() ? BuiltinOperator::None : iter->second;
     }
 
-    bool checkPrecedence(OperatorPrecedence curr, OperatorPrecedence neww) {
-        return (int)curr < (int)neww || (neww == curr && neww == OperatorPrecedence::incdec);
+    // operators bind by the precedence of the function they call, anything else binds like a function call
+    OperatorPrecedence getOperatorPrecedence(const ValueRef& function) {
+        return function->getType() == Type::Function ? function->getFunction()->opPrecedence : OperatorPrecedence::func;
     }
 
     ExpressionRef KataScriptInterpreter::getResolveVarExpression(const string& name, bool classScope) {
@@ -144,396 +86,303 @@ namespace KataScript {
         }
     }
 
-    // recursively build an expression tree from a list of tokens
+    // build an expression tree from a list of tokens
     ExpressionRef KataScriptInterpreter::getExpression(const vector<string_view>& strings, ScopeRef scope, Class* classs) {
-        ExpressionRef root = nullptr;
         size_t i = 0;
-        while (i < strings.size()) {
-            if (isMathOperator(strings[i])) {
-                auto prev = root;
-                root = make_shared<Expression>(FunctionExpression(resolveVariable(string(strings[i]), modules[0].scope)));
-                auto curr = prev;
-                if (curr) {
-                    // find operations of lesser precedence
-                    if (curr->type == ExpressionType::FunctionCall) {
-                        auto& rootExpression = get<FunctionExpression>(root->expression);
-                        auto& funcExpr = get<FunctionExpression>(curr->expression).function;
-                        if (funcExpr->getType() != Type::Function) {
-                            rootExpression.subexpressions.push_back(curr);
-                        } else {
-                            auto curfunc = funcExpr->getFunction();
-                            auto newfunc = rootExpression.function->getFunction();
-                            if (curfunc && checkPrecedence(curfunc->opPrecedence, newfunc->opPrecedence)) {
-                                while (get<FunctionExpression>(curr->expression).subexpressions.back()->type == ExpressionType::FunctionCall) {
-                                    auto fnc = get<FunctionExpression>(get<FunctionExpression>(curr->expression).subexpressions.back()->expression).function;
-                                    if (fnc->getType() != Type::Function) {
-                                        break;
-                                    }
-                                    curfunc = fnc->getFunction();
-                                    if (curfunc && checkPrecedence(curfunc->opPrecedence, newfunc->opPrecedence)) {
-                                        curr = get<FunctionExpression>(curr->expression).subexpressions.back();
-                                    } else {
-                                        break;
-                                    }
-                                }
-                                auto& currExpression = get<FunctionExpression>(curr->expression);
-                                // swap values around to correct the otherwise incorect order of operations (except unary)
-                                if (needsUnaryPlacementFix(strings, i)) {
-                                    rootExpression.subexpressions.insert(rootExpression.subexpressions.begin(), make_shared<Expression>(makeNull(), root));
-                                } else {
-                                    rootExpression.subexpressions.push_back(currExpression.subexpressions.back());
-                                    currExpression.subexpressions.pop_back();
-                                }
-
-                                // gather any subexpressions from list literals/indexing or function call args
-                                if (i + 1 < strings.size() && !isMathOperator(strings[i + 1])) {
-                                    vector<string_view> minisub = { strings[++i] };
-                                    // list literal or parenthesis expression
-                                    char checkstr = 0;
-                                    if (isOpeningBracketOrParen(strings[i])) {
-                                        checkstr = strings[i][0];
-                                    }
-                                    // list index or function call
-                                    else if (strings.size() > i + 1 && isOpeningBracketOrParen(strings[i + 1])) {
-                                        ++i;
-                                        checkstr = strings[i][0];
-                                        minisub.push_back(strings[i]);
-                                    }
-                                    // gather tokens until the end of the sub expression
-                                    if (checkstr != 0) {
-                                        auto endstr = checkstr == '[' ? ']' : ')';
-                                        int nestLayers = 1;
-                                        while (nestLayers > 0 && ++i < strings.size()) {
-                                            if (strings[i].size() == 1) {
-                                                if (strings[i][0] == endstr) {
-                                                    --nestLayers;
-                                                } else if (strings[i][0] == checkstr) {
-                                                    ++nestLayers;
-                                                }
-                                            }
-                                            minisub.push_back(strings[i]);
-                                            if (nestLayers == 0) {
-                                                if (i + 1 < strings.size() && isOpeningBracketOrParen(strings[i + 1])) {
-                                                    ++nestLayers;
-                                                    checkstr = strings[++i][0];
-                                                    endstr = checkstr == '[' ? ']' : ')';
-                                                }
-                                            }
-                                        }
-                                    }
-                                    rootExpression.subexpressions.push_back(getExpression(std::move(minisub), scope, classs));
-                                }
-                                currExpression.subexpressions.push_back(root);
-                                root = prev;
-                            } else {
-                                rootExpression.subexpressions.push_back(curr);
-                            }
-                        }
-                    } else {
-                        get<FunctionExpression>(root->expression).subexpressions.push_back(curr);
-                    }
-                } else {
-                    if (needsUnaryPlacementFix(strings, i)) {
-                        auto& rootExpression = get<FunctionExpression>(root->expression);
-                        rootExpression.subexpressions.insert(rootExpression.subexpressions.begin(), make_shared<Expression>(makeNull(), root));
-                    }
-                }
-            } else if (strings[i] == "(" || strings[i] == "[" || isVarOrFuncToken(strings[i])) {
-                if (strings[i] == "(" || i + 2 < strings.size() && strings[i + 1] == "(") {
-                    // function
-                    ExpressionRef cur = nullptr;
-                    if (strings[i] == "(") {
-                        if (root) {
-                            if (root->type == ExpressionType::FunctionCall) {
-                                if (get<FunctionExpression>(root->expression).function->getFunction()->opPrecedence == OperatorPrecedence::func) {
-                                    cur = make_shared<Expression>(FunctionExpression(makeNull()));
-                                    get<FunctionExpression>(cur->expression).subexpressions.push_back(root);
-                                    root = cur;
-                                } else {
-                                    get<FunctionExpression>(root->expression).subexpressions.push_back(make_shared<Expression>(FunctionExpression(identityFunctionVarLocation)));
-                                    cur = get<FunctionExpression>(root->expression).subexpressions.back();
-                                }
-                            } else {
-                                get<MemberFunctionCall>(root->expression).subexpressions.push_back(make_shared<Expression>(FunctionExpression(identityFunctionVarLocation)));
-                                cur = get<MemberFunctionCall>(root->expression).subexpressions.back();
-                            }
-                        } else {
-                            root = make_shared<Expression>(FunctionExpression(identityFunctionVarLocation));
-                            cur = root;
-                        }
-                    } else {
-                        auto funccall = make_shared<Expression>(FunctionExpression(make_shared<Value>(string(strings[i]))));
-                        if (root) {
-                            get<FunctionExpression>(root->expression).subexpressions.push_back(funccall);
-                            cur = get<FunctionExpression>(root->expression).subexpressions.back();
-                        } else {
-                            root = funccall;
-                            cur = root;
-                        }
-                        ++i;
-                    }
-                    vector<string_view> minisub;
-                    int nestLayers = 1;
-                    while (nestLayers > 0 && ++i < strings.size()) {
-                        if (nestLayers == 1 && strings[i] == ",") {
-                            if (minisub.size()) {
-                                get<FunctionExpression>(cur->expression).subexpressions.push_back(getExpression(std::move(minisub), scope, classs));
-                                minisub.clear();
-                            }
-                        } else if (isClosingBracketOrParen(strings[i])) {
-                            if (--nestLayers > 0) {
-                                minisub.push_back(strings[i]);
-                            } else {
-                                if (minisub.size()) {
-                                    get<FunctionExpression>(cur->expression).subexpressions.push_back(getExpression(std::move(minisub), scope, classs));
-                                    minisub.clear();
-                                }
-                            }
-                        } else if (isOpeningBracketOrParen(strings[i]) || !(strings[i].size() == 1 && contains("+-*%/"s, strings[i][0])) && i + 2 < strings.size() && strings[i + 1] == "(") {
-                            ++nestLayers;
-                            if (strings[i] == "(") {
-                                minisub.push_back(strings[i]);
-                            } else {
-                                minisub.push_back(strings[i]);
-                                ++i;
-                                if (isClosingBracketOrParen(strings[i])) {
-                                    --nestLayers;
-                                }
-                                if (nestLayers > 0) {
-                                    minisub.push_back(strings[i]);
-                                }
-                            }
-                        } else {
-                            minisub.push_back(strings[i]);
-                        }
-                    }
-                } else if (strings[i] == "[" || i + 2 < strings.size() && strings[i + 1] == "[") {
-                    // list
-                    bool indexOfIndex = i > 0 && (isClosingBracketOrParen(strings[i-1]) || strings[i - 1].back() == '\"') || (i > 1 && strings[i - 2] == ".");
-                    ExpressionRef cur = nullptr;
-                    if (!indexOfIndex && strings[i] == "[") {
-                        // list literal / collection literal
-                        if (root) {
-                            get<FunctionExpression>(root->expression).subexpressions.push_back(
-                                make_shared<Expression>(make_shared<Value>(List())));
-                            cur = get<FunctionExpression>(root->expression).subexpressions.back();
-                        } else {
-                            root = make_shared<Expression>(make_shared<Value>(List()));
-                            cur = root;
-                        }
-                        vector<string_view> minisub;
-                        int nestLayers = 1;
-                        while (nestLayers > 0 && ++i < strings.size()) {
-                            if (nestLayers == 1 && strings[i] == ",") {
-                                if (minisub.size()) {
-                                    auto val = *getValue(std::move(minisub), scope, classs);
-                                    get<ValueRef>(cur->expression)->getList().push_back(make_shared<Value>(val.value));
-                                    minisub.clear();
-                                }
-                            } else if (isClosingBracketOrParen(strings[i])) {
-                                if (--nestLayers > 0) {
-                                    minisub.push_back(strings[i]);
-                                } else {
-                                    if (minisub.size()) {
-                                        auto val = *getValue(std::move(minisub), scope, classs);
-                                        get<ValueRef>(cur->expression)->getList().push_back(make_shared<Value>(val.value));
-                                        minisub.clear();
-                                    }
-                                }
-                            } else if (isOpeningBracketOrParen(strings[i])) {
-                                ++nestLayers;
-                                minisub.push_back(strings[i]);
-                            } else {
-                                minisub.push_back(strings[i]);
-                            }
-                        }
-                        auto& list = get<ValueRef>(cur->expression)->getList();
-                        if (list.size()) {
-                            bool canBeArray = true;
-                            auto type = list[0]->getType();
-                            for (auto& val : list) {
-                                if (val->getType() == Type::Null || val->getType() != type || (int)val->getType() >= (int)Type::Array) {
-                                    canBeArray = false;
-                                    break;
-                                }
-                            }
-                            if (canBeArray) {
-                                get<ValueRef>(cur->expression)->hardconvert(Type::Array);
-                            }
-                        }
-                    } else {
-                        // list access
-                        auto indexexpr = make_shared<Expression>(FunctionExpression(listIndexFunctionVarLocation));
-                        if (indexOfIndex) {
-                            cur = root;
-                            auto parent = root;
-                            while (cur->type == ExpressionType::FunctionCall
-                                && get<FunctionExpression>(cur->expression).function->getType() == Type::Function 
-                                && get<FunctionExpression>(cur->expression).function->getFunction()->opPrecedence != OperatorPrecedence::func) {
-                                parent = cur;
-                                cur = get<FunctionExpression>(cur->expression).subexpressions.back();
-                            }
-                            get<FunctionExpression>(indexexpr->expression).subexpressions.push_back(cur);
-                            if (cur == root) {
-                                root = indexexpr;
-                                cur = indexexpr;
-                            } else {
-                                get<FunctionExpression>(parent->expression).subexpressions.pop_back();
-                                get<FunctionExpression>(parent->expression).subexpressions.push_back(indexexpr);
-                                cur = get<FunctionExpression>(parent->expression).subexpressions.back();
-                            }
-                        } else {
-                            if (root) {
-                                get<FunctionExpression>(root->expression).subexpressions.push_back(indexexpr);
-                                cur = get<FunctionExpression>(root->expression).subexpressions.back();
-                            } else {
-                                root = indexexpr;
-                                cur = root;
-                            }
-                            get<FunctionExpression>(cur->expression).subexpressions.push_back(getResolveVarExpression(string(strings[i]), parseScope->isClassScope));
-                            ++i;
-                        }
+        auto root = parseExpression(strings, i, OperatorPrecedence::assign, scope, classs);
+        // stray closing brackets and commas are ignored
+        while (i < strings.size() && (isClosingBracketOrParen(strings[i]) || strings[i] == ",")) {
+            ++i;
+        }
+        if (i < strings.size()) {
+            throw Exception("Syntax Error: unexpected series of values at "s + string(strings[i]) + ", possible missing `,`");
+        }
 
-                        vector<string_view> minisub;
-                        int nestLayers = 1;
-                        while (nestLayers > 0 && ++i < strings.size()) {
-                            if (strings[i] == "]") {
-                                if (--nestLayers > 0) {
-                                    minisub.push_back(strings[i]);
-                                } else {
-                                    if (minisub.size()) {
-                                        get<FunctionExpression>(cur->expression).subexpressions.push_back(getExpression(std::move(minisub), scope, classs));
-                                        minisub.clear();
-                                    }
-                                }
-                            } else if (strings[i] == "[") {
-                                ++nestLayers;
-                                minisub.push_back(strings[i]);
-                            } else {
-                                minisub.push_back(strings[i]);
-                            }
-                        }
-                    }
-                } else {
-                    // variable
-                    ExpressionRef newExpr;
-                    if (strings[i] == "true") {
-                        newExpr = make_shared<Expression>(make_shared<Value>(Int(1)));
-                    } else if (strings[i] == "false") {
-                        newExpr = make_shared<Expression>(make_shared<Value>(Int(0)));
-                    } else if (strings[i] == "null") {
-                        newExpr = make_shared<Expression>(makeNull());
-                    } else {
-                        newExpr = getResolveVarExpression(string(strings[i]), parseScope->isClassScope);
-                    }
+        if (constantFolding && root) {
+            foldedConstants += foldConstants(root);
+        }
+        return root;
+    }
 
-                    if (root) {
-                        if (root->type == ExpressionType::ResolveVar || root->type == ExpressionType::MemberVariable) {
-                            throw Exception("Syntax Error: unexpected series of values at "s + string(strings[i]) +", possible missing `,`");
-                        }
-                        get<FunctionExpression>(root->expression).subexpressions.push_back(newExpr);
-                    } else {
-                        root = newExpr;
-                    }
+    ExpressionRef KataScriptInterpreter::getOperatorExpression(string_view token, const ValueRef& function) {
+        auto expr = make_shared<Expression>(FunctionExpression(function));
+        get<FunctionExpression>(expr->expression).op = getBuiltinOperator(token);
+        return expr;
+    }
+
+    // list literals holding a single primitive type are arrays
+    void narrowListLiteral(Value& literal) {
+        auto& values = literal.getList();
+        if (values.empty()) {
+            return;
+        }
+        auto type = values[0]->getType();
+        for (auto& val : values) {
+            if (val->getType() == Type::Null || val->getType() != type || (int)val->getType() >= (int)Type::Array) {
+                return;
+            }
+        }
+        literal.hardconvert(Type::Array);
+    }
+
+    // precedence climbing, reads operands joined by operators that bind at least as tight as minPrecedence
+    // operators of equal precedence group to the left
+    ExpressionRef KataScriptInterpreter::parseExpression(const vector<string_view>& strings, size_t& i, OperatorPrecedence minPrecedence, ScopeRef scope, Class* classs) {
+        auto left = parseOperand(strings, i, scope, classs);
+        while (i < strings.size() && isMathOperator(strings[i])) {
+            auto function = resolveVariable(string(strings[i]), modules[0].scope);
+            auto precedence = getOperatorPrecedence(function);
+            if ((int)precedence < (int)minPrecedence) {
+                break;
+            }
+            auto expr = getOperatorExpression(strings[i], function);
+            auto& subexpressions = get<FunctionExpression>(expr->expression).subexpressions;
+            if (left) {
+                subexpressions.push_back(left);
+            }
+            // unary operators after an operand are postfix, like x++
+            if (!isUnaryMathOperator(strings[i++])) {
+                if (auto right = parseExpression(strings, i, (OperatorPrecedence)((int)precedence + 1), scope, classs)) {
+                    subexpressions.push_back(right);
                 }
-            } else if (isMemberCall(strings[i])) {
-                // member var
-                bool isfunc = strings.size() > i + 2 && strings[i + 2] == "("s;
-                if (isfunc) {
-                    ExpressionRef expr;
-                    if (root->type == ExpressionType::FunctionCall 
-                        && get<FunctionExpression>(root->expression).subexpressions.size()
-                        && get<FunctionExpression>(root->expression).function != listIndexFunctionVarLocation) {
-                        expr = make_shared<Expression>(get<FunctionExpression>(root->expression).subexpressions.back(), string(strings[++i]), vector<ExpressionRef>());
-                        get<FunctionExpression>(root->expression).subexpressions.pop_back();
-                        get<FunctionExpression>(root->expression).subexpressions.push_back(expr);
-                    } else {
-                        expr = make_shared<Expression>(root, string(strings[++i]), vector<ExpressionRef>());
-                        root = expr;
-                    }
-                    ++i;
-                    vector<string_view> minisub;
-                    int nestLayers = 1;
-                    while (nestLayers > 0 && ++i < strings.size()) {
-                        if (nestLayers == 1 && strings[i] == ",") {
-                            if (minisub.size()) {
-                                get<MemberFunctionCall>(expr->expression).subexpressions.push_back(getExpression(std::move(minisub), scope, classs));
-                                minisub.clear();
-                            }
-                        } else if (strings[i] == ")") {
-                            if (--nestLayers > 0) {
-                                minisub.push_back(strings[i]);
-                            } else {
-                                if (minisub.size()) {
-                                    get<MemberFunctionCall>(expr->expression).subexpressions.push_back(getExpression(std::move(minisub), scope, classs));
-                                    minisub.clear();
-                                }
-                            }
-                        } else if (strings[i] == "(") {
-                            ++nestLayers;
-                            minisub.push_back(strings[i]);
-                        } else {
-                            minisub.push_back(strings[i]);
-                        }
-                    }
-                } else {
-                    auto isfunction = root->type == ExpressionType::FunctionCall;
-                    auto size = isfunction ? get<FunctionExpression>(root->expression).subexpressions.size() : 0;
-                    if (isfunction && size && get<FunctionExpression>(root->expression).function->getFunction()->opPrecedence < OperatorPrecedence::func) {
-                        auto expr = make_shared<Expression>(get<FunctionExpression>(root->expression).subexpressions.back(), string(strings[++i]));
-                        get<FunctionExpression>(root->expression).subexpressions.pop_back();
-                        get<FunctionExpression>(root->expression).subexpressions.push_back(expr);                       
-                    } else {
-                        root = make_shared<Expression>(root, string(strings[++i]));
-                    }
+            }
+            left = expr;
+        }
+        return left;
+    }
+
+    // a single value with any calls, indexing and member access after it
+    ExpressionRef KataScriptInterpreter::parseOperand(const vector<string_view>& strings, size_t& i, ScopeRef scope, Class* classs) {
+        if (i >= strings.size() || isClosingBracketOrParen(strings[i]) || strings[i] == ",") {
+            return nullptr;
+        }
+        auto token = strings[i++];
+        ExpressionRef expr;
+        if (isMathOperator(token)) {
+            // prefix operators take everything that binds tighter than they do
+            auto function = resolveVariable(string(token), modules[0].scope);
+            expr = getOperatorExpression(token, function);
+            auto& subexpressions = get<FunctionExpression>(expr->expression).subexpressions;
+            // prefix unary operators get a null first argument to tell them apart from postfix ones
+            if (isUnaryMathOperator(token)) {
+                subexpressions.push_back(make_shared<Expression>(makeNull(), expr));
+            }
+            if (auto operand = parseExpression(strings, i, (OperatorPrecedence)((int)getOperatorPrecedence(function) + 1), scope, classs)) {
+                subexpressions.push_back(operand);
+            }
+            return expr;
+        } else if (token == "(") {
+            // parenthesis expression
+            expr = make_shared<Expression>(FunctionExpression(identityFunctionVarLocation));
+            parseArguments(strings, i, get<FunctionExpression>(expr->expression).subexpressions, scope, classs);
+        } else if (token == "[") {
+            // list literal / collection literal
+            vector<ExpressionRef> items;
+            parseArguments(strings, i, items, scope, classs);
+            bool constant = std::all_of(items.begin(), items.end(), [](const ExpressionRef& item) {
+                return item->type == ExpressionType::Constant || item->type == ExpressionType::Value;
+            });
+            if (constant) {
+                auto list = makeValue(List());
+                for (auto& item : items) {
+                    list->getList().push_back(makeValue(execute(item, scope, classs)->value));
                 }
-            } else if (isStringLiteral(strings[i])) {
-                // trim quotation marks
-                auto stringLiteral = string(strings[i].substr(1, strings[i].size() - 2));
-                replaceEscapedLiterals(stringLiteral);
-                auto newExpr = make_shared<Expression>(Constant(Value(stringLiteral)));
-                if (root) {
-                    get<FunctionExpression>(root->expression).subexpressions.push_back(newExpr);
+                narrowListLiteral(*list);
+                expr = make_shared<Expression>(list);
+            } else {
+                // anything else can only be known when the literal runs
+                expr = make_shared<Expression>(FunctionExpression(listLiteralFunctionVarLocation));
+                get<FunctionExpression>(expr->expression).subexpressions = std::move(items);
+            }
+        } else if (isStringLiteral(token)) {
+            // trim quotation marks
+            auto stringLiteral = string(token.substr(1, token.size() - 2));
+            replaceEscapedLiterals(stringLiteral);
+            expr = make_shared<Expression>(Constant(Value(stringLiteral)));
+        } else if (isVarOrFuncToken(token)) {
+            if (i < strings.size() && strings[i] == "(") {
+                // function call by name, resolved when it runs
+                expr = make_shared<Expression>(FunctionExpression(makeValue(string(token))));
+                parseArguments(strings, ++i, get<FunctionExpression>(expr->expression).subexpressions, scope, classs);
+            } else if (auto keyword = getKeyword(token); keyword == Keyword::True) {
+                expr = make_shared<Expression>(makeValue(Int(1)));
+            } else if (keyword == Keyword::False) {
+                expr = make_shared<Expression>(makeValue(Int(0)));
+            } else if (keyword == Keyword::Null) {
+                expr = make_shared<Expression>(makeNull());
+            } else {
+                expr = getResolveVarExpression(string(token), parseScope->isClassScope);
+            }
+        } else {
+            // number
+            auto [ val, valid ] = fromChars(token);
+            if (!valid) {
+                return nullptr;
+            }
+            bool isFloat = contains(token, '.');
+            expr = make_shared<Expression>(Constant(isFloat ? Value((Float)val) : Value((Int)val)));
+        }
+
+        while (i < strings.size()) {
+            if (strings[i] == "(") {
+                // call whatever the expression evaluates to
+                auto call = make_shared<Expression>(FunctionExpression(makeNull()));
+                get<FunctionExpression>(call->expression).subexpressions.push_back(expr);
+                parseArguments(strings, ++i, get<FunctionExpression>(call->expression).subexpressions, scope, classs);
+                expr = call;
+            } else if (strings[i] == "[") {
+                // list access
+                auto index = make_shared<Expression>(FunctionExpression(listIndexFunctionVarLocation));
+                get<FunctionExpression>(index->expression).subexpressions.push_back(expr);
+                parseArguments(strings, ++i, get<FunctionExpression>(index->expression).subexpressions, scope, classs);
+                expr = index;
+            } else if (isMemberCall(strings[i]) && i + 1 < strings.size()) {
+                // member var or member function
+                auto name = string(strings[i + 1]);
+                i += 2;
+                if (i < strings.size() && strings[i] == "(") {
+                    expr = make_shared<Expression>(expr, name, vector<ExpressionRef>());
+                    parseArguments(strings, ++i, get<MemberFunctionCall>(expr->expression).subexpressions, scope, classs);
                 } else {
-                    root = newExpr;
+                    expr = make_shared<Expression>(expr, name);
                 }
             } else {
-                // number
-                auto [ val, valid ] = fromChars(strings[i]);
-                if (valid) {
-                    bool isFloat = contains(strings[i], '.');
-                    auto newExpr = make_shared<Expression>(Constant(isFloat ? Value((Float)val) : Value((Int)val)));
-                    if (root) {
-                        get<FunctionExpression>(root->expression).subexpressions.push_back(newExpr);
-                    } else {
-                        root = newExpr;
+                break;
+            }
+        }
+        return expr;
+    }
+
+    // comma separated expressions up to and including the closing bracket
+    void KataScriptInterpreter::parseArguments(const vector<string_view>& strings, size_t& i, vector<ExpressionRef>& args, ScopeRef scope, Class* classs) {
+        while (i < strings.size()) {
+            if (isClosingBracketOrParen(strings[i])) {
+                ++i;
+                return;
+            }
+            if (strings[i] == ",") {
+                ++i;
+                continue;
+            }
+            if (auto arg = parseExpression(strings, i, OperatorPrecedence::assign, scope, classs)) {
+                args.push_back(arg);
+            }
+            if (i < strings.size() && !isClosingBracketOrParen(strings[i]) && strings[i] != ",") {
+                throw Exception("Syntax Error: unexpected series of values at "s + string(strings[i]) + ", possible missing `,`");
+            }
+        }
+    }
+
+    // a literal that folding can read at parse time
+    bool isFoldableConstant(const ExpressionRef& exp) {
+        if (exp->type == ExpressionType::Constant) {
+            return true;
+        }
+        // true, false, null and the placeholder for unary operators are shared scalar values
+        if (exp->type == ExpressionType::Value) {
+            switch (get<ValueRef>(exp->expression)->getType()) {
+            case Type::Null:
+            case Type::Int:
+            case Type::Float:
+            case Type::Vec3:
+            case Type::String:
+                return true;
+            default:
+                break;
+            }
+        }
+        return false;
+    }
+
+    // replace calls to pure operators that only have constant arguments with their result
+    // this only descends through function calls, anything else was folded when its own tokens were parsed
+    size_t KataScriptInterpreter::foldConstants(const ExpressionRef& exp) {
+        if (exp->type != ExpressionType::FunctionCall) {
+            return 0;
+        }
+        size_t folded = 0;
+        for (auto&& sub : get<FunctionExpression>(exp->expression).subexpressions) {
+            folded += foldConstants(sub);
+        }
+        return folded + foldCall(exp);
+    }
+
+    // fold a single call whose arguments have already been folded
+    // the call is kept with the result, and runs instead whenever an operator it went through has been replaced
+    size_t KataScriptInterpreter::foldCall(const ExpressionRef& exp) {
+        if (exp->type != ExpressionType::FunctionCall) {
+            return 0;
+        }
+        auto& funcExpr = get<FunctionExpression>(exp->expression);
+        if (funcExpr.subexpressions.empty() || !funcExpr.function || funcExpr.function->getType() != Type::Function
+            || !std::all_of(funcExpr.subexpressions.begin(), funcExpr.subexpressions.end(), isFoldableConstant)) {
+            return 0;
+        }
+        auto fnc = funcExpr.function->getFunction();
+        if (std::find(pureOperators.begin(), pureOperators.end(), fnc) == pureOperators.end()) {
+            return 0;
+        }
+
+        List args;
+        args.reserve(funcExpr.subexpressions.size());
+        vector<FoldedOperator> operators{ FoldedOperator{ funcExpr.function, fnc } };
+        for (auto&& sub : funcExpr.subexpressions) {
+            if (sub->type == ExpressionType::Constant) {
+                auto& constant = get<Constant>(sub->expression);
+                args.push_back(makeValue(constant.val));
+                for (auto&& op : constant.operators) {
+                    if (std::none_of(operators.begin(), operators.end(), [&](const FoldedOperator& o) { return o.function == op.function; })) {
+                        operators.push_back(op);
                     }
                 }
+            } else {
+                args.push_back(makeValue(get<ValueRef>(sub->expression)->value));
             }
-            ++i;
+        }
+        // integer division by zero is left for the program to hit when it runs
+        if ((fnc->name == "/" || fnc->name == "%") && args.back()->getType() == Type::Int && args.back()->getInt() == 0) {
+            return 0;
         }
 
-        return root;
+        ValueRef result;
+        try {
+            result = callFunction(fnc, globalScope, args);
+        } catch (const Exception&) {
+            // errors should still happen when and if the expression runs
+            return 0;
+        }
+        // fill the unfolded node in place, copying it would copy its whole subtree
+        auto unfolded = make_shared<Expression>(FunctionExpression(funcExpr.function));
+        auto& call = get<FunctionExpression>(unfolded->expression);
+        call.op = funcExpr.op;
+        call.subexpressions = std::move(funcExpr.subexpressions);
+
+        Constant constant(*result);
+        constant.unfolded = std::move(unfolded);
+        constant.operators = std::move(operators);
+        exp->expression = std::move(constant);
+        exp->type = ExpressionType::Constant;
+        return 1;
     }
 
     // parse one token at a time, uses the state machine
-    void KataScriptInterpreter::parse(string_view token) {
+    void KataScriptInterpreter::parse(string_view token, Keyword keyword) {
         auto tempState = parseState;
         switch (parseState) {
         case ParseState::beginExpression:
         {            
             if (lastStatementClosedScope && previousExpression) {
-                if (token != "else" && token != "if") {
-                    getValue(previousExpression, parseScope, nullptr);
+                if (keyword != Keyword::Else && keyword != Keyword::If) {
+                    runStatement(previousExpression);
                 }
             }
             bool closedExpr = false;
 
-            if (token == "fn" || token == "func" || token == "function") {
+            if (keyword == Keyword::Function) {
                 parseState = ParseState::defineFunc;
-            } else if (token == "var") {
+            } else if (keyword == Keyword::Var) {
                 parseState = ParseState::defineVar;
-            } else if (token == "for" || token == "while") {
+            } else if (keyword == Keyword::Loop) {
                 parseState = ParseState::loopCall;
                 if (currentExpression) {
                     auto newexpr = make_shared<Expression>(Loop(), currentExpression);
@@ -542,7 +391,7 @@ namespace KataScript {
                 } else {
                     currentExpression = make_shared<Expression>(Loop());
                 }
-            } else if (token == "foreach") {
+            } else if (keyword == Keyword::Foreach) {
                 parseState = ParseState::forEach;
                 if (currentExpression) {
                     auto newexpr = make_shared<Expression>(Foreach(), currentExpression);
@@ -551,7 +400,7 @@ namespace KataScript {
                 } else {
                     currentExpression = make_shared<Expression>(Foreach());
                 }
-            } else if (token == "if") {
+            } else if (keyword == Keyword::If) {
                 parseState = ParseState::ifCall;
                 if (currentExpression) {
                     auto newexpr = make_shared<Expression>(IfElse(), currentExpression);
@@ -560,29 +409,35 @@ namespace KataScript {
                 } else {
                     currentExpression = make_shared<Expression>(IfElse());
                 }
-            } else if (token == "else") {
+            } else if (keyword == Keyword::Else) {
                 parseState = ParseState::expectIfEnd;
                 currentExpression = previousExpression;
-            } else if (token == "class") {
+            } else if (keyword == Keyword::Class) {
                 parseState = ParseState::defineClass;
             } else if (token == "{") {
                 parseScope = newScope("__anon"s, parseScope);
+                if (recording) {
+                    recording->steps.emplace_back(ProgramStepType::OpenScope, "__anon"s);
+                }
                 clearParseStacks();
             } else if (token == "}") {
                 closedExpr = closeCurrentExpression();
                 if ((!closedExpr) || parseScope->name == "__anon") {
                     closeScope(parseScope);
+                    if (recording) {
+                        recording->steps.emplace_back(ProgramStepType::CloseScope);
+                    }
                 }
                 if (previousExpression && previousExpression->type != ExpressionType::IfElse) {
                     closedExpr = false;
                 }
-            } else if (token == "return") {
+            } else if (keyword == Keyword::Return) {
                 parseState = ParseState::returnLine;
-            } else if (token == "break") {
+            } else if (keyword == Keyword::Break) {
                 parseState = ParseState::breakLine;
-            } else if (token == "continue") {
+            } else if (keyword == Keyword::Continue) {
                 parseState = ParseState::continueLine;
-            } else if (token == "import") {
+            } else if (keyword == Keyword::Import) {
                 parseState = ParseState::importModule;
             } else if (token == ";") {
                 clearParseStacks();
@@ -658,7 +513,16 @@ namespace KataScript {
                         throw Exception("Syntax error, `foreach` requires 2 statements, "s + std::to_string(exprs.size()) + " statements supplied instead");
                     }
 
-                    get<Foreach>(currentExpression->expression).iterateName = string(exprs[0][0]);
+                    auto& names = exprs[0];
+                    if (names.size() == 3 && names[1] == ",") {
+                        get<Foreach>(currentExpression->expression).keyName = names[0];
+                        get<Foreach>(currentExpression->expression).iterateName = names[2];
+                    } else if (names.size() == 1) {
+                        get<Foreach>(currentExpression->expression).iterateName = names[0];
+                    } else {
+                        clearParseStacks();
+                        throw Exception("Syntax error, `foreach` takes a variable name, or a key name and a variable name separated by a comma");
+                    }
                     get<Foreach>(currentExpression->expression).listExpression = getExpression(exprs[1], parseScope, nullptr);
 
                     clearParseStacks();
@@ -699,7 +563,7 @@ namespace KataScript {
                 clearParseStacks();
                 // we clear before evaluating lines so any exceptions can clear the offending code
                 if (!currentExpression) {
-                    getValue(line, parseScope, nullptr);
+                    runStatement(getExpression(line, parseScope, nullptr));
                 } else {
                     currentExpression->push_back(getExpression(line, parseScope, nullptr));
                 }
@@ -739,11 +603,14 @@ namespace KataScript {
             }
             break;
         case ParseState::expectIfEnd:
-            if (token == "if") {
+            if (keyword == Keyword::If) {
                 clearParseStacks();
                 parseState = ParseState::ifCall;
             } else if (token == "{") {
                 parseScope = newScope("__anon"s, parseScope);
+                if (recording) {
+                    recording->steps.emplace_back(ProgramStepType::OpenScope, "__anon"s);
+                }
                 currentExpression->push_back(If());
                 clearParseStacks();
             } else {
@@ -766,7 +633,7 @@ namespace KataScript {
                 if (currentExpression) {
                     currentExpression->push_back(make_shared<Expression>(DefineVar(string(name), defineExpr)));
                 } else {
-                    getValue(make_shared<Expression>(DefineVar(string(name), defineExpr)), parseScope, nullptr);
+                    runStatement(make_shared<Expression>(DefineVar(string(name), defineExpr)));
                 }
                 clearParseStacks();
             } else {
@@ -775,22 +642,21 @@ namespace KataScript {
             break;
         case ParseState::defineClass:
             parseScope = newClassScope(string(token), parseScope);
+            if (recording) {
+                recording->steps.emplace_back(ProgramStepType::OpenClassScope, string(token));
+            }
             parseState = ParseState::classArgs;
             parseStrings.clear();
             break;
         case ParseState::classArgs:
             if (token == ",") {
                 if (parseStrings.size()) {
-                    auto otherscope = resolveScope(string(parseStrings.back()), parseScope);
-                    parseScope->variables.insert(otherscope->variables.begin(), otherscope->variables.end());
-                    parseScope->functions.insert(otherscope->functions.begin(), otherscope->functions.end());
+                    inheritScope(string(parseStrings.back()));
                     parseStrings.clear();
                 }
             } else if (token == "{") {
                 if (parseStrings.size()) {
-                    auto otherscope = resolveScope(string(parseStrings.back()), parseScope);
-                    parseScope->variables.insert(otherscope->variables.begin(), otherscope->variables.end());
-                    parseScope->functions.insert(otherscope->functions.begin(), otherscope->functions.end());
+                    inheritScope(string(parseStrings.back()));
                 }
                 clearParseStacks();
             } else {
@@ -804,22 +670,28 @@ namespace KataScript {
         case ParseState::importModule:
             clearParseStacks();
             if (token.size() > 2 && token.front() == '\"' && token.back() == '\"') {
-                // import file       
-                evaluateFile(string(token.substr(1, token.size() - 2)));
-                clearParseStacks();
-            } else {
-                auto modName = string(token);
-                auto iter = std::find_if(modules.begin(), modules.end(), [&modName](auto& mod) {return mod.scope->name == modName; });
-                if (iter == modules.end()) {
-                    auto newMod = getOptionalModule(modName);
-                    if (newMod) {
-                        if (shouldAllow(allowedModulePrivileges, newMod->requiredPermissions)) {
-                            modules.emplace_back(newMod->requiredPermissions, newMod->scope);
-                        } else {
-                            throw Exception("Error: Cannot import restricted module: "s + modName);
-                        }
+                // import file
+                auto path = string(token.substr(1, token.size() - 2));
+                if (recording) {
+                    // compiled scripts import the file when they run, but its classes still need to be known here
+                    recording->steps.emplace_back(ProgramStepType::ImportFile, path);
+                    auto outer = recording;
+                    ProgramTree imported;
+                    recording = &imported;
+                    string_view bundled;
+                    if (findBundled(path, bundled)) {
+                        Tokenizer tokenizer(bundled);
+                        parseTokens(tokenizer, false, true);
+                    } else {
+                        evaluateFile(path);
                     }
+                    recording = outer;
+                } else {
+                    importFile(path);
                 }
+                clearParseStacks();
+            } else {
+                importModule(string(token));
             }
             break;
         case ParseState::funcArgs:
@@ -835,6 +707,10 @@ namespace KataScript {
                 }
                 auto isConstructor = parseScope->isClassScope && parseScope->name == fncName;
                 auto newfunc = isConstructor ? newConstructor(string(fncName), parseScope->parent, args) : newFunction(string(fncName), parseScope, args);
+                if (recording) {
+                    recording->functions.push_back(newfunc);
+                    recording->steps.emplace_back(isConstructor ? ProgramStepType::DefineConstructor : ProgramStepType::DefineFunction, newfunc);
+                }
                 if (currentExpression) {
                     auto newexpr = make_shared<Expression>(newfunc, currentExpression);
                     currentExpression->push_back(newexpr);
@@ -844,10 +720,41 @@ namespace KataScript {
                 }
             } else if (token == "{") {
                 clearParseStacks();
+                // compiling needs every body, and nested functions are parsed along with the body around them
+                auto fnc = get<FunctionExpression>(currentExpression->expression).function->getFunction();
+                if (lazyParsing && !recording && !currentExpression->parent && fnc->type != FunctionType::constructor) {
+                    parseState = ParseState::skipFunctionBody;
+                    outerNestLayer = 1;
+                    skippedBody = make_shared<UnparsedBody>();
+                    skippedBody->firstLine = skippedBodyLine = tokenLine;
+                    skippedBody->classScope = parseScope->isClassScope;
+                    skippedBodyDefines = false;
+                }
             } else {
                 parseStrings.push_back(token);
             }
             break;
+        case ParseState::skipFunctionBody:
+            if (token == "{") {
+                ++outerNestLayer;
+            } else if (token == "}" && --outerNestLayer == 0) {
+                finishSkippedBody();
+                break;
+            }
+            // definitions and imports have to happen when the script runs, not when the function does
+            if (keyword == Keyword::Function || keyword == Keyword::Class || keyword == Keyword::Import) {
+                skippedBodyDefines = true;
+            }
+            // every token stays on its own line, so the tokenizer reads the body the same way again
+            if (tokenLine > skippedBodyLine) {
+                skippedBody->source.append(tokenLine - skippedBodyLine, '\n');
+                skippedBodyLine = tokenLine;
+            } else if (skippedBody->source.size()) {
+                skippedBody->source += ' ';
+            }
+            skippedBody->source += token;
+            skippedBodyLine += std::count(token.begin(), token.end(), '\n');
+            break;
         default:
             break;
         }
@@ -855,63 +762,313 @@ namespace KataScript {
         prevState = tempState;
     }
 
-    bool KataScriptInterpreter::readLine(string_view text) {
-        ++currentLine;
-        auto tokenCount = 0;
-        auto tokens = ViewTokenize(text);
-        bool didExcept = false;
-        try {            
-            for (auto& token : tokens) {
-                parse(token);
-                ++tokenCount;
+    // import "file", a file is only parsed again once it changes
+    // the parsed file is a program, so any interpreter sharing the cache can run it without parsing
+    bool KataScriptInterpreter::importFile(const string& path) {
+        FileStamp stamp;
+        string_view bundled;
+        auto bundle = findBundled(path, bundled);
+        if (bundle) {
+            // a bundled file changes only when the bundle does
+            stamp = bundle->stamp;
+            stamp.path += '/';
+            stamp.path += bundlePath(path);
+            stamp.size = bundled.size();
+        } else if (!FileStamp::get(path, stamp)) {
+            return evaluateFile(path);
+        }
+        auto imported = importedFiles.find(stamp.path);
+        if (imported != importedFiles.end()) {
+            if (imported->second.stamp == stamp) {
+                // everything it defined is still visible from here
+                auto loadedInto = imported->second.scope.lock();
+                for (auto scope = parseScope; loadedInto && scope; scope = scope->parent) {
+                    if (scope == loadedInto) {
+                        importCache->countHit();
+                        return false;
+                    }
+                }
+            } else if (imported->second.program) {
+                programs.erase(imported->second.program->id);
+            }
+        }
+
+        auto program = importCache->find(stamp);
+        if (!program && bundle) {
+            // the bundle stays mapped while it's mounted, so the source is read straight from it
+            program = compile(bundled);
+            if (!program) {
+                return true;
+            }
+            importCache->insert(stamp, program);
+        } else if (!program) {
+            FileView file(path, true);
+            auto script = file.data();
+            // compiled files are already quick to load
+            if (!file.isOpen() || script.starts_with(string_view(CompiledMagic, sizeof(CompiledMagic)))) {
+                importedFiles[stamp.path] = ImportedFile{ stamp, parseScope, nullptr };
+                return evaluateFile(path);
+            }
+            size_t firstLine = 1;
+            if (endswith(path, ".sh")) {
+                auto newline = script.find('\n');
+                script.remove_prefix(newline == string::npos ? script.size() : newline + 1);
+                ++firstLine;
+            }
+            program = compile(script, firstLine);
+            if (!program) {
+                return true;
+            }
+            importCache->insert(stamp, program);
+        }
+        importedFiles[stamp.path] = ImportedFile{ stamp, parseScope, program };
+        return run(*program, parseScope);
+    }
+
+    BundleRef KataScriptInterpreter::findBundled(const string& path, string_view& source) const {
+        if (bundles.empty()) {
+            return nullptr;
+        }
+        auto name = bundlePath(path);
+        for (auto& bundle : bundles) {
+            if (bundle->find(name, source)) {
+                return bundle;
+            }
+        }
+        return nullptr;
+    }
+
+    bool KataScriptInterpreter::mountBundle(const string& path) {
+        try {
+            bundles.push_back(make_shared<Bundle>(path));
+        } catch (const Exception& e) {
+            printf("Error mounting %s: %s\n", path.c_str(), e.wh.c_str());
+            return true;
+        }
+        return false;
+    }
+
+    void KataScriptInterpreter::invalidateImport(const string& path) {
+        auto imported = importedFiles.find(FileStamp::canonical(path).string());
+        if (imported != importedFiles.end()) {
+            if (imported->second.program) {
+                programs.erase(imported->second.program->id);
+            }
+            importedFiles.erase(imported);
+        }
+        importCache->invalidate(path);
+    }
+
+    void KataScriptInterpreter::invalidateImports() {
+        for (auto& imported : importedFiles) {
+            if (imported.second.program) {
+                programs.erase(imported.second.program->id);
+            }
+        }
+        importedFiles.clear();
+        importCache->clear();
+    }
+
+    // the closing brace of a skipped function body
+    void KataScriptInterpreter::finishSkippedBody() {
+        auto body = std::move(skippedBody);
+        clearParseStacks();
+        if (skippedBodyDefines) {
+            // parse it now, just like it was never skipped
+            Tokenizer tokenizer(body->source, body->firstLine);
+            Token token;
+            while (tokenizer.next(token)) {
+                tokenLine = token.line;
+                parse(token.text, token.keyword);
+            }
+        } else {
+            get<FunctionExpression>(currentExpression->expression).function->getFunction()->unparsedBody = body;
+        }
+        parse("}", Keyword::None);
+    }
+
+    // a skipped body is parsed the first time its function is called
+    // that can be in the middle of parsing something else, so the parser is put back the way it was afterwards
+    void KataScriptInterpreter::parseSkippedBody(const FunctionRef& fnc) {
+        auto body = std::move(fnc->unparsedBody);
+        auto outerState = parseState;
+        auto outerStrings = std::move(parseStrings);
+        auto outerNest = outerNestLayer;
+        auto outerClosed = lastStatementClosedScope;
+        auto outerLine = tokenLine;
+        auto outerScope = parseScope;
+        auto outerCurrent = std::move(currentExpression);
+        auto outerPrevious = std::move(previousExpression);
+        auto restore = [&]() {
+            parseState = outerState;
+            parseStrings = std::move(outerStrings);
+            outerNestLayer = outerNest;
+            lastStatementClosedScope = outerClosed;
+            tokenLine = outerLine;
+            parseScope = outerScope;
+            currentExpression = std::move(outerCurrent);
+            previousExpression = std::move(outerPrevious);
+        };
+
+        clearParseStacks();
+        lastStatementClosedScope = false;
+        // blocks in the body open their scopes in here instead of wherever the parser was
+        parseScope = make_shared<Scope>(fnc->name, globalScope);
+        parseScope->isClassScope = body->classScope;
+        currentExpression = make_shared<Expression>(fnc, nullptr);
+        Tokenizer tokenizer(body->source, body->firstLine);
+        Token token;
+        try {
+            while (tokenizer.next(token)) {
+                tokenLine = token.line;
+                parse(token.text, token.keyword);
+            }
+            parse("}", Keyword::None);
+        } catch (Exception& e) {
+            // keep the source so the next call reports the error again
+            get<vector<ExpressionRef>>(fnc->body).clear();
+            fnc->unparsedBody = body;
+            restore();
+            throw Exception("Error at line "s + std::to_string(token.line) + " of function `" + fnc->name + "`: " + e.wh);
+        } catch (...) {
+            get<vector<ExpressionRef>>(fnc->body).clear();
+            fnc->unparsedBody = body;
+            restore();
+            throw;
+        }
+        restore();
+    }
+
+    // top level statements run as soon as they are parsed, unless we are compiling
+    void KataScriptInterpreter::runStatement(ExpressionRef expr) {
+        if (recording) {
+            recording->steps.emplace_back(expr);
+        } else {
+            execute(expr, parseScope, nullptr);
+        }
+    }
+
+    // classes get a copy of everything in the classes they inherit from
+    void KataScriptInterpreter::inheritScope(const string& name) {
+        auto otherscope = resolveScope(name, parseScope);
+        parseScope->variables.insert(otherscope->variables.begin(), otherscope->variables.end());
+        parseScope->functions.insert(otherscope->functions.begin(), otherscope->functions.end());
+        if (recording) {
+            recording->steps.emplace_back(ProgramStepType::InheritScope, name);
+        }
+    }
+
+    void KataScriptInterpreter::importModule(const string& name) {
+        if (recording) {
+            recording->steps.emplace_back(ProgramStepType::ImportModule, name);
+        }
+        auto iter = std::find_if(modules.begin(), modules.end(), [&name](auto& mod) {return mod.scope->name == name; });
+        if (iter == modules.end()) {
+            auto newMod = getOptionalModule(name);
+            if (newMod) {
+                if (shouldAllow(allowedModulePrivileges, newMod->requiredPermissions)) {
+                    modules.emplace_back(newMod->requiredPermissions, newMod->scope);
+                } else {
+                    throw Exception("Error: Cannot import restricted module: "s + name);
+                }
+            }
+        }
+    }
+
+    // feed every token to the parser, returns true if parsing hit an error
+    bool KataScriptInterpreter::parseTokens(Tokenizer& tokenizer, bool holdTokens, bool closeDanglingExpressions) {
+        Token token;
+        // streamed token text is overwritten by the next read, so keep copies while the parser still refers to them
+        std::deque<string> heldTokens;
+        try {
+            while (tokenizer.next(token)) {
+                if (holdTokens) {
+                    if (parseStrings.empty()) {
+                        heldTokens.clear();
+                    }
+                    token.text = heldTokens.emplace_back(token.text);
+                }
+                tokenLine = token.line;
+                parse(token.text, token.keyword);
+            }
+            if (closeDanglingExpressions) {
+                // close any dangling if-expressions that may exist
+                token.text = ";";
+                token.keyword = Keyword::None;
+                parse(token.text, token.keyword);
             }
         } catch (Exception e) {
 #if defined KATASCRIPT_DO_INTERNAL_PRINT
-            callFunctionWithArgs(resolveFunction("print"), "Error at line "s + std::to_string(currentLine) + ", at: " + std::to_string(tokenCount) + string(tokens[tokenCount]) + ": " + e.wh + "\n");
+            callFunctionWithArgs(resolveFunction("print"), "Error at line "s + std::to_string(token.line) + ", column " + std::to_string(token.column) + ": " + string(token.text) + ": " + e.wh + "\n");
 #else
-            printf("Error at line %llu at %i: %s : %s\n", currentLine, tokenCount, string(tokens[tokenCount]).c_str(), e.wh.c_str());
+            printf("Error at line %llu, column %llu: %s : %s\n", (unsigned long long)token.line, (unsigned long long)token.column, string(token.text).c_str(), e.wh.c_str());
 #endif		
             clearParseStacks();
             parseScope = globalScope;
             currentExpression = nullptr;
-            didExcept = true;
+            return true;
         } catch (std::exception& e) {
 #if defined KATASCRIPT_DO_INTERNAL_PRINT
-            callFunctionWithArgs(resolveFunction("print"), "Error at line "s + std::to_string(currentLine)  + ", at: " + std::to_string(tokenCount) + string(tokens[tokenCount]) +  ": " + e.what()  + "\n");
+            callFunctionWithArgs(resolveFunction("print"), "Error at line "s + std::to_string(token.line) + ", column " + std::to_string(token.column) + ": " + string(token.text) + ": " + e.what() + "\n");
 #else
-            printf("Error at line %llu at %i: %s : %s\n", currentLine, tokenCount, string(tokens[tokenCount]).c_str(), e.what());
+            printf("Error at line %llu, column %llu: %s : %s\n", (unsigned long long)token.line, (unsigned long long)token.column, string(token.text).c_str(), e.what());
 #endif		
             clearParseStacks();
             parseScope = globalScope;
             currentExpression = nullptr;
-            didExcept = true;
+            return true;
         }
-        return didExcept;
+        return false;
+    }
+
+    bool KataScriptInterpreter::readLine(string_view text) {
+        Tokenizer tokenizer(text, ++currentLine);
+        return parseTokens(tokenizer, false, false);
     }
 
     bool KataScriptInterpreter::evaluate(string_view script) {
-        for (auto& line : split(script, '\n')) {
-            if (readLine(line)) {
-                return true;
-            }
-        }
-        // close any dangling if-expressions that may exist
-        return readLine(";"s);
+        Tokenizer tokenizer(script);
+        return parseTokens(tokenizer, false, true);
+    }
+
+    bool KataScriptInterpreter::evaluate(std::istream& script) {
+        Tokenizer tokenizer(script);
+        return parseTokens(tokenizer, true, true);
     }
 
     bool KataScriptInterpreter::evaluateFile(const string& path) {
-        string s;
-        auto file = std::ifstream(path);
+        // bash kata scripts have a header line we need to skip
+        auto skipHeader = endswith(path, ".sh");
+        FileView view(path, false);
+        if (view.isMapped()) {
+            auto script = view.data();
+            // compiled scripts don't need the tokenizer or the parser
+            if (script.starts_with(string_view(CompiledMagic, sizeof(CompiledMagic)))) {
+                return evaluateCompiled(script, path);
+            }
+            if (skipHeader) {
+                auto newline = script.find('\n');
+                script.remove_prefix(newline == string::npos ? script.size() : newline + 1);
+            }
+            // the mapping outlives parsing, so tokens can point straight into it
+            Tokenizer tokenizer(script, skipHeader ? 2 : 1);
+            return parseTokens(tokenizer, false, true);
+        }
+
+        // pipes and other files that can't be mapped are streamed
+        auto file = std::ifstream(path, std::ios::binary);
         if (file) {
-            file.seekg(0, std::ios::end);
-            s.reserve(file.tellg());
-            file.seekg(0, std::ios::beg);
-            // bash kata scripts have a header line we need to skip
-            if (endswith(path, ".sh")) {
-                getline(file, s);
+            if (file.peek() == CompiledMagic[0]) {
+                std::stringstream compiled;
+                compiled << file.rdbuf();
+                return evaluateCompiled(compiled.str(), path);
+            }
+            if (skipHeader) {
+                string header;
+                getline(file, header);
             }
-            s.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-            return evaluate(s);
+            Tokenizer tokenizer(file, Tokenizer::DefaultChunkSize, skipHeader ? 2 : 1);
+            return parseTokens(tokenizer, true, true);
         } else {
             printf("file: %s not found\n", path.c_str());
             return 1;
@@ -934,6 +1091,14 @@ namespace KataScript {
         return result;
     }
 
+    bool KataScriptInterpreter::evaluate(std::istream& script, ScopeRef scope) {
+        auto temp = parseScope;
+        parseScope = scope;
+        auto result = evaluate(script);
+        parseScope = temp;
+        return result;
+    }
+
     bool KataScriptInterpreter::evaluateFile(const string& path, ScopeRef scope) {
         auto temp = parseScope;
         parseScope = scope;
@@ -956,9 +1121,9 @@ namespace KataScript {
         globalScope = make_shared<Scope>(this);
         parseScope = globalScope;
         currentExpression = nullptr;
-        if (modules.size() > 1) {
-            modules.erase(modules.begin() + 1, modules.end());
-        }
+        // imported modules go, the ones every interpreter starts with stay
+        std::erase_if(modules, [](const Module& mod) { return mod.requiredPermissions != 0; });
+        importedFiles.clear();
     }
 
     // general purpose clear to reset state machine for next statement
@@ -0,0 +1,78 @@
+#pragma once
+#include "types.hpp"
+#include "expressions.hpp"
+
+namespace KataScript {
+    // compiled scripts start with a byte no source file can, then the format version
+    // bump the version whenever the layout below changes, older files then fall back to their source
+    constexpr char CompiledMagic[4] = { '\0', 'K', 'S', 'C' };
+    constexpr uint32_t CompiledFormatVersion = 3;
+
+    // what a script does to the interpreter, in the order the parser would have done it
+    enum class ProgramStepType : uint8_t {
+        Execute,            // run expression in the current scope
+        DefineFunction,     // register function in the current scope
+        DefineConstructor,  // register function as the constructor of the current class scope
+        OpenScope,          // enter the block scope name
+        OpenClassScope,     // enter the class scope name
+        CloseScope,
+        InheritScope,       // copy the variables and functions of the class name into the current scope
+        ImportModule,       // import the optional module name
+        ImportFile          // evaluate the script at name
+    };
+
+    struct ProgramStep {
+        ProgramStepType type;
+        ExpressionRef expression;
+        FunctionRef function;
+        string name;
+
+        ProgramStep(ProgramStepType t) : type(t) {}
+        ProgramStep(ExpressionRef expr) : type(ProgramStepType::Execute), expression(expr) {}
+        ProgramStep(ProgramStepType t, FunctionRef fnc) : type(t), function(fnc) {}
+        ProgramStep(ProgramStepType t, const string& n) : type(t), name(n) {}
+    };
+
+    // the steps of a parsed script, loaded into one interpreter
+    struct ProgramTree {
+        // every script function, function definitions in the expression trees refer to these
+        vector<FunctionRef> functions;
+        vector<ProgramStep> steps;
+    };
+
+    // a parsed script that runs without tokenizing or parsing it again
+    // it only holds the compiled format, so it never changes and any number of interpreters can share it
+    // each interpreter loads its own tree the first time it runs a program
+    struct Program {
+        uint64_t id = newProgramId();
+        string data;
+        // interpreters watch this to drop their tree once the program is gone
+        shared_ptr<const bool> alive = make_shared<const bool>(true);
+
+        static uint64_t newProgramId() {
+#ifndef KATASCRIPT_THREAD_UNSAFE
+            static std::atomic<uint64_t> next = 1;
+#else
+            static uint64_t next = 1;
+#endif
+            return next++;
+        }
+    };
+
+    using ProgramRef = shared_ptr<const Program>;
+
+    // an interpreter's tree for a program, kept while the program is alive
+    struct LoadedProgram {
+        std::weak_ptr<const bool> alive;
+        ProgramTree tree;
+    };
+
+    // fnv-1a, tells a compiled file whether its source changed since
+    inline uint64_t hashSource(string_view source) {
+        uint64_t hash = 14695981039346656037ull;
+        for (auto c : source) {
+            hash = (hash ^ (uint8_t)c) * 1099511628211ull;
+        }
+        return hash;
+    }
+}
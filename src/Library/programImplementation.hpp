@@ -0,0 +1,667 @@
+#pragma once
+
+namespace KataScript {
+    // compiled scripts are laid out as
+    //   header: magic, format version, hash of the source, path of the source
+    //   function table: name, type and argument names of every function, then all their bodies
+    //   steps: the program steps in order
+    // numbers are written in native byte order, ints and floats always at 64 bits
+    // frame slots aren't saved, they are resolved again when the functions load
+    struct ProgramWriter {
+        std::ostream& out;
+        unordered_map<const Function*, uint32_t> functionIndices;
+
+        ProgramWriter(std::ostream& o) : out(o) {}
+
+        template <typename T>
+        void write(T value) {
+            out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        void writeString(const string& str) {
+            write((uint32_t)str.size());
+            out.write(str.data(), str.size());
+        }
+
+        // symbol ids only mean something to this process, so names are saved as text
+        void writeString(Symbol symbol) {
+            writeString(symbol.getString());
+        }
+
+        void writeList(const List& list) {
+            write((uint32_t)list.size());
+            for (auto& item : list) {
+                writeValue(*item);
+            }
+        }
+
+        void writeValue(const Value& value) {
+            write(value.getType());
+            switch (value.getType()) {
+            case Type::Null:
+                break;
+            case Type::Int:
+                write((int64_t)value.getInt());
+                break;
+            case Type::Float:
+                write((double)value.getFloat());
+                break;
+            case Type::Vec3: {
+                auto& vec = value.getVec3();
+                write(vec.x);
+                write(vec.y);
+                write(vec.z);
+            }
+                break;
+            case Type::String:
+                writeString(value.getString());
+                break;
+            case Type::Array: {
+                // arrays are saved as lists and narrowed back on load
+                auto list = value;
+                list.hardconvert(Type::List);
+                writeList(list.getList());
+            }
+                break;
+            case Type::List:
+                writeList(value.getList());
+                break;
+            default:
+                throw Exception("Cannot compile a constant of type "s + getTypeName(value.getType()));
+            }
+        }
+
+        void writeFunction(const FunctionRef& fnc) {
+            auto iter = functionIndices.find(fnc.get());
+            if (iter == functionIndices.end()) {
+                throw Exception("Cannot compile a reference to function "s + fnc->name);
+            }
+            write(iter->second);
+        }
+
+        void writeExpressions(const vector<ExpressionRef>& exprs) {
+            write((uint32_t)exprs.size());
+            for (auto& expr : exprs) {
+                writeExpression(expr);
+            }
+        }
+
+        void writeExpression(const ExpressionRef& expr) {
+            if (!expr) {
+                write(ExpressionType::None);
+                return;
+            }
+            // folded constants are saved as the call they came from, and folded again when they load
+            if (expr->type == ExpressionType::Constant && get<Constant>(expr->expression).unfolded) {
+                writeExpression(get<Constant>(expr->expression).unfolded);
+                return;
+            }
+            write(expr->type);
+            switch (expr->type) {
+            case ExpressionType::Value:
+                writeValue(*get<ValueRef>(expr->expression));
+                break;
+            case ExpressionType::Constant:
+                writeValue(get<Constant>(expr->expression).val);
+                break;
+            case ExpressionType::ResolveVar:
+                writeString(get<ResolveVar>(expr->expression).name);
+                break;
+            case ExpressionType::DefineVar: {
+                auto& def = get<DefineVar>(expr->expression);
+                writeString(def.name);
+                writeExpression(def.defineExpression);
+            }
+                break;
+            case ExpressionType::FunctionDef:
+                writeFunction(get<FunctionExpression>(expr->expression).function->getFunction());
+                break;
+            case ExpressionType::FunctionCall: {
+                auto& call = get<FunctionExpression>(expr->expression);
+                // standard library functions are looked up again by name, named and indirect calls keep their value
+                bool library = call.function->getType() == Type::Function;
+                write((uint8_t)library);
+                if (library) {
+                    writeString(call.function->getFunction()->name);
+                } else {
+                    writeValue(*call.function);
+                }
+                write(call.op);
+                writeExpressions(call.subexpressions);
+            }
+                break;
+            case ExpressionType::MemberFunctionCall: {
+                auto& call = get<MemberFunctionCall>(expr->expression);
+                writeExpression(call.object);
+                writeString(call.functionName);
+                writeExpressions(call.subexpressions);
+            }
+                break;
+            case ExpressionType::MemberVariable: {
+                auto& member = get<MemberVariable>(expr->expression);
+                writeExpression(member.object);
+                writeString(member.name);
+            }
+                break;
+            case ExpressionType::Return:
+                writeExpression(get<Return>(expr->expression).expression);
+                break;
+            case ExpressionType::Break:
+            case ExpressionType::Continue:
+                break;
+            case ExpressionType::Loop: {
+                auto& loop = get<Loop>(expr->expression);
+                writeExpression(loop.initExpression);
+                writeExpression(loop.testExpression);
+                writeExpression(loop.iterateExpression);
+                writeExpressions(loop.subexpressions);
+            }
+                break;
+            case ExpressionType::ForEach: {
+                auto& foreach = get<Foreach>(expr->expression);
+                writeExpression(foreach.listExpression);
+                writeString(foreach.iterateName);
+                writeString(foreach.keyName);
+                writeExpressions(foreach.subexpressions);
+            }
+                break;
+            case ExpressionType::IfElse: {
+                auto& ifelse = get<IfElse>(expr->expression);
+                write((uint32_t)ifelse.size());
+                for (auto& branch : ifelse) {
+                    writeExpression(branch.testExpression);
+                    writeExpressions(branch.subexpressions);
+                }
+            }
+                break;
+            default:
+                throw Exception("Cannot compile expression");
+            }
+        }
+
+        void writeHeader(uint64_t sourceHash, const string& sourcePath) {
+            out.write(CompiledMagic, sizeof(CompiledMagic));
+            write(CompiledFormatVersion);
+            write(sourceHash);
+            writeString(sourcePath);
+        }
+
+        void writeProgram(const ProgramTree& program) {
+            write((uint32_t)program.functions.size());
+            for (auto& fnc : program.functions) {
+                functionIndices[fnc.get()] = (uint32_t)functionIndices.size();
+                writeString(fnc->name);
+                write(fnc->type);
+                write((uint32_t)fnc->argNames.size());
+                for (auto& arg : fnc->argNames) {
+                    writeString(arg);
+                }
+            }
+            // bodies come after every function is known, since they can refer to each other
+            for (auto& fnc : program.functions) {
+                writeExpressions(get<vector<ExpressionRef>>(fnc->body));
+            }
+
+            write((uint32_t)program.steps.size());
+            for (auto& step : program.steps) {
+                write(step.type);
+                switch (step.type) {
+                case ProgramStepType::Execute:
+                    writeExpression(step.expression);
+                    break;
+                case ProgramStepType::DefineFunction:
+                case ProgramStepType::DefineConstructor:
+                    writeFunction(step.function);
+                    break;
+                case ProgramStepType::CloseScope:
+                    break;
+                default:
+                    writeString(step.name);
+                    break;
+                }
+            }
+        }
+    };
+
+    struct ProgramReader {
+        string_view data;
+        size_t position = 0;
+        // where standard library functions are looked up by name
+        ScopeRef library;
+        vector<FunctionRef> functions;
+        // every call read, arguments before the calls they belong to, so they can be folded in order
+        vector<ExpressionRef> calls;
+
+        ProgramReader(string_view d, ScopeRef lib) : data(d), library(lib) {}
+
+        string_view take(size_t size) {
+            if (size > data.size() - position) {
+                throw Exception("Compiled script ends early");
+            }
+            auto bytes = data.substr(position, size);
+            position += size;
+            return bytes;
+        }
+
+        template <typename T>
+        T read() {
+            T value;
+            std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+            return value;
+        }
+
+        // a count of things that each take at least minSize bytes, checked before anything is allocated for them
+        size_t readCount(size_t minSize) {
+            auto count = read<uint32_t>();
+            if (count > (data.size() - position) / minSize) {
+                throw Exception("Compiled script ends early");
+            }
+            return count;
+        }
+
+        string readString() {
+            return string(take(read<uint32_t>()));
+        }
+
+        Symbol readSymbol() {
+            return Symbol(take(read<uint32_t>()));
+        }
+
+        List readList() {
+            List list(readCount(sizeof(Type)));
+            for (auto& item : list) {
+                item = makeValue(readValue());
+            }
+            return list;
+        }
+
+        Value readValue() {
+            auto type = read<Type>();
+            switch (type) {
+            case Type::Null:
+                return Value();
+            case Type::Int:
+                return Value((Int)read<int64_t>());
+            case Type::Float:
+                return Value((Float)read<double>());
+            case Type::Vec3: {
+                auto x = read<float>();
+                auto y = read<float>();
+                auto z = read<float>();
+                return Value(vec3(x, y, z));
+            }
+            case Type::String:
+                return Value(readString());
+            case Type::Array: {
+                auto list = Value(readList());
+                if (list.getList().empty()) {
+                    return Value(Array());
+                }
+                list.hardconvert(Type::Array);
+                return list;
+            }
+            case Type::List:
+                return Value(readList());
+            default:
+                throw Exception("Compiled script has a constant of type "s + getTypeName(type));
+            }
+        }
+
+        FunctionRef readFunction() {
+            auto index = read<uint32_t>();
+            if (index >= functions.size()) {
+                throw Exception("Compiled script refers to a missing function");
+            }
+            return functions[index];
+        }
+
+        vector<ExpressionRef> readExpressions() {
+            vector<ExpressionRef> exprs(readCount(sizeof(ExpressionType)));
+            for (auto& expr : exprs) {
+                expr = readExpression();
+            }
+            return exprs;
+        }
+
+        ExpressionRef readExpression() {
+            auto type = read<ExpressionType>();
+            switch (type) {
+            case ExpressionType::None:
+                return nullptr;
+            case ExpressionType::Value:
+                return make_shared<Expression>(makeValue(readValue()));
+            case ExpressionType::Constant:
+                return make_shared<Expression>(Constant(readValue()));
+            case ExpressionType::ResolveVar:
+                return make_shared<Expression>(ResolveVar(readSymbol()));
+            case ExpressionType::DefineVar: {
+                auto expr = make_shared<Expression>(DefineVar(readSymbol()));
+                get<DefineVar>(expr->expression).defineExpression = readExpression();
+                return expr;
+            }
+            case ExpressionType::FunctionDef:
+                return make_shared<Expression>(readFunction());
+            case ExpressionType::FunctionCall: {
+                ValueRef function;
+                if (read<uint8_t>()) {
+                    auto name = readString();
+                    auto iter = library->variables.find(name);
+                    if (iter == library->variables.end()) {
+                        throw Exception("Compiled script calls unknown library function "s + name);
+                    }
+                    function = iter->second;
+                } else {
+                    function = makeValue(readValue());
+                }
+                // fill nodes in place, copying them would copy their whole subtree
+                auto expr = make_shared<Expression>(FunctionExpression(function));
+                auto& call = get<FunctionExpression>(expr->expression);
+                call.op = read<BuiltinOperator>();
+                call.subexpressions = readExpressions();
+                calls.push_back(expr);
+                return expr;
+            }
+            case ExpressionType::MemberFunctionCall: {
+                auto object = readExpression();
+                auto name = readSymbol();
+                auto expr = make_shared<Expression>(object, name, vector<ExpressionRef>());
+                get<MemberFunctionCall>(expr->expression).subexpressions = readExpressions();
+                return expr;
+            }
+            case ExpressionType::MemberVariable: {
+                auto object = readExpression();
+                return make_shared<Expression>(object, readSymbol());
+            }
+            case ExpressionType::Return:
+            {
+                auto expr = make_shared<Expression>(Return());
+                get<Return>(expr->expression).expression = readExpression();
+                return expr;
+            }
+            case ExpressionType::Break:
+                return make_shared<Expression>(Break());
+            case ExpressionType::Continue:
+                return make_shared<Expression>(Continue());
+            case ExpressionType::Loop: {
+                auto expr = make_shared<Expression>(Loop());
+                auto& loop = get<Loop>(expr->expression);
+                loop.initExpression = readExpression();
+                loop.testExpression = readExpression();
+                loop.iterateExpression = readExpression();
+                loop.subexpressions = readExpressions();
+                return expr;
+            }
+            case ExpressionType::ForEach: {
+                auto expr = make_shared<Expression>(Foreach());
+                auto& foreach = get<Foreach>(expr->expression);
+                foreach.listExpression = readExpression();
+                foreach.iterateName = readSymbol();
+                foreach.keyName = readSymbol();
+                foreach.subexpressions = readExpressions();
+                return expr;
+            }
+            case ExpressionType::IfElse: {
+                auto expr = make_shared<Expression>(IfElse(readCount(sizeof(ExpressionType) + sizeof(uint32_t))));
+                for (auto& branch : get<IfElse>(expr->expression)) {
+                    branch.testExpression = readExpression();
+                    branch.subexpressions = readExpressions();
+                }
+                return expr;
+            }
+            default:
+                throw Exception("Compiled script has an unknown expression");
+            }
+        }
+
+        void readHeader(uint32_t& version, uint64_t& sourceHash, string& sourcePath) {
+            if (!data.starts_with(string_view(CompiledMagic, sizeof(CompiledMagic)))) {
+                throw Exception("Not a compiled script");
+            }
+            position = sizeof(CompiledMagic);
+            version = read<uint32_t>();
+            sourceHash = read<uint64_t>();
+            sourcePath = readString();
+        }
+
+        void readProgram(ProgramTree& program) {
+            // a name, a type and an argument count each
+            functions.resize(readCount(sizeof(uint32_t) + sizeof(FunctionType) + sizeof(uint32_t)));
+            for (auto& fnc : functions) {
+                auto name = readString();
+                auto type = read<FunctionType>();
+                vector<string> argNames(readCount(sizeof(uint32_t)));
+                for (auto& arg : argNames) {
+                    arg = readString();
+                }
+                fnc = make_shared<Function>(name, argNames);
+                fnc->type = type;
+            }
+            for (auto& fnc : functions) {
+                fnc->body = readExpressions();
+            }
+            program.functions = functions;
+
+            auto stepCount = readCount(sizeof(ProgramStepType));
+            program.steps.reserve(stepCount);
+            for (size_t i = 0; i < stepCount; ++i) {
+                auto type = read<ProgramStepType>();
+                switch (type) {
+                case ProgramStepType::Execute:
+                    program.steps.emplace_back(readExpression());
+                    break;
+                case ProgramStepType::DefineFunction:
+                case ProgramStepType::DefineConstructor:
+                    program.steps.emplace_back(type, readFunction());
+                    break;
+                case ProgramStepType::CloseScope:
+                    program.steps.emplace_back(type);
+                    break;
+                case ProgramStepType::OpenScope:
+                case ProgramStepType::OpenClassScope:
+                case ProgramStepType::InheritScope:
+                case ProgramStepType::ImportModule:
+                case ProgramStepType::ImportFile:
+                    program.steps.emplace_back(type, readString());
+                    break;
+                default:
+                    throw Exception("Compiled script has an unknown step");
+                }
+            }
+        }
+    };
+
+    // parse a script without running it, the result can run any number of times in any interpreter
+    ProgramRef KataScriptInterpreter::compile(string_view script, size_t firstLine) {
+        // a scratch interpreter does the parsing so compiling leaves this one as it was
+        KataScriptInterpreter compiler(allowedModulePrivileges);
+        compiler.constantFolding = constantFolding;
+        compiler.bundles = bundles;
+        ProgramTree tree;
+        compiler.recording = &tree;
+        Tokenizer tokenizer(script, firstLine);
+        if (compiler.parseTokens(tokenizer, false, true)) {
+            return nullptr;
+        }
+
+        std::ostringstream out;
+        try {
+            ProgramWriter writer(out);
+            writer.writeProgram(tree);
+        } catch (const Exception& e) {
+            printf("Error compiling: %s\n", e.wh.c_str());
+            return nullptr;
+        }
+        auto program = make_shared<Program>();
+        program->data = out.str();
+        return program;
+    }
+
+    bool KataScriptInterpreter::run(const Program& program) {
+        return run(program, globalScope);
+    }
+
+    bool KataScriptInterpreter::run(const Program& program, ScopeRef scope) {
+        auto iter = programs.find(program.id);
+        if (iter == programs.end()) {
+            // trees of programs that were destroyed since the last load go first
+            std::erase_if(programs, [](const auto& entry) { return entry.second.alive.expired(); });
+            LoadedProgram loaded{ program.alive, {} };
+            try {
+                loadProgram(program.data, loaded.tree);
+            } catch (const Exception& e) {
+                printf("Error loading program: %s\n", e.wh.c_str());
+                return true;
+            }
+            iter = programs.emplace(program.id, std::move(loaded)).first;
+        }
+        auto temp = parseScope;
+        parseScope = scope;
+        auto result = runProgram(iter->second.tree);
+        parseScope = temp;
+        return result;
+    }
+
+    // parse a script file without running it and save the result
+    bool KataScriptInterpreter::compileFile(const string& sourcePath, const string& outPath) {
+        FileView file(sourcePath, true);
+        if (!file.isOpen()) {
+            printf("file: %s not found\n", sourcePath.c_str());
+            return 1;
+        }
+        auto source = file.data();
+        auto script = source;
+        size_t firstLine = 1;
+        // bash kata scripts have a header line we need to skip
+        if (endswith(sourcePath, ".sh")) {
+            auto newline = script.find('\n');
+            script.remove_prefix(newline == string::npos ? script.size() : newline + 1);
+            ++firstLine;
+        }
+        auto program = compile(script, firstLine);
+        if (!program) {
+            return true;
+        }
+
+        auto out = std::ofstream(outPath, std::ios::binary);
+        if (!out) {
+            printf("file: %s could not be written\n", outPath.c_str());
+            return true;
+        }
+        ProgramWriter writer(out);
+        writer.writeHeader(hashSource(source), sourcePath);
+        out.write(program->data.data(), program->data.size());
+        return false;
+    }
+
+    // load a compiled script and run it, or run its source if the compiled file is out of date
+    bool KataScriptInterpreter::evaluateCompiledFile(const string& path) {
+        FileView file(path, true);
+        if (!file.isOpen()) {
+            printf("file: %s not found\n", path.c_str());
+            return 1;
+        }
+        return evaluateCompiled(file.data(), path);
+    }
+
+    bool KataScriptInterpreter::evaluateCompiled(string_view data, const string& path) {
+        ProgramTree tree;
+        string sourcePath;
+        // a compiled file that can't be loaded is treated like a stale one, as long as its source is there
+        auto loadFailed = [&](const string& error) {
+            if (!sourcePath.empty() && FileView(sourcePath, true).isOpen()) {
+                return evaluateFile(sourcePath);
+            }
+            printf("Error loading %s: %s\n", path.c_str(), error.c_str());
+            return true;
+        };
+        try {
+            ProgramReader reader(data, modules[0].scope);
+            uint32_t version;
+            uint64_t sourceHash;
+            reader.readHeader(version, sourceHash, sourcePath);
+            // without the source there is nothing to check against, so a readable format is trusted as is
+            FileView source(sourcePath, true);
+            if (source.isOpen()) {
+                if (version != CompiledFormatVersion || sourceHash != hashSource(source.data())) {
+                    return evaluateFile(sourcePath);
+                }
+            } else if (version != CompiledFormatVersion) {
+                throw Exception("Compiled with format version "s + std::to_string(version) + " and the source " + sourcePath + " is missing");
+            }
+            loadProgram(data.substr(reader.position), tree);
+        } catch (const Exception& e) {
+            return loadFailed(e.wh);
+        } catch (const std::exception& e) {
+            return loadFailed(e.what());
+        }
+        return runProgram(tree);
+    }
+
+    // build this interpreter's own copy of a compiled program
+    void KataScriptInterpreter::loadProgram(string_view data, ProgramTree& tree) {
+        ProgramReader reader(data, modules[0].scope);
+        reader.readProgram(tree);
+        if (constantFolding) {
+            for (auto& call : reader.calls) {
+                foldedConstants += foldCall(call);
+            }
+        }
+        for (auto& fnc : tree.functions) {
+            resolveSlots(fnc);
+        }
+    }
+
+    // do everything the parser would have done for a script, in the current parse scope
+    bool KataScriptInterpreter::runProgram(const ProgramTree& tree) {
+        try {
+            for (auto& step : tree.steps) {
+                switch (step.type) {
+                case ProgramStepType::Execute:
+                    runStatement(step.expression);
+                    break;
+                case ProgramStepType::DefineFunction:
+                    newFunction(step.function->name, parseScope, step.function);
+                    break;
+                case ProgramStepType::DefineConstructor:
+                    newConstructor(step.function->name, parseScope->parent, step.function);
+                    break;
+                case ProgramStepType::OpenScope:
+                    parseScope = newScope(step.name, parseScope);
+                    break;
+                case ProgramStepType::OpenClassScope:
+                    parseScope = newClassScope(step.name, parseScope);
+                    break;
+                case ProgramStepType::CloseScope:
+                    closeScope(parseScope);
+                    break;
+                case ProgramStepType::InheritScope:
+                    inheritScope(step.name);
+                    break;
+                case ProgramStepType::ImportModule:
+                    importModule(step.name);
+                    break;
+                case ProgramStepType::ImportFile:
+                    importFile(step.name);
+                    break;
+                }
+            }
+        } catch (const Exception& e) {
+#if defined KATASCRIPT_DO_INTERNAL_PRINT
+            callFunctionWithArgs(resolveFunction("print"), "Error: "s + e.wh + "\n");
+#else
+            printf("Error: %s\n", e.wh.c_str());
+#endif
+            parseScope = globalScope;
+            return true;
+        } catch (std::exception& e) {
+#if defined KATASCRIPT_DO_INTERNAL_PRINT
+            callFunctionWithArgs(resolveFunction("print"), "Error: "s + e.what() + "\n");
+#else
+            printf("Error: %s\n", e.what());
+#endif
+            parseScope = globalScope;
+            return true;
+        }
+        return false;
+    }
+}
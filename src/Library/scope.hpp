@@ -12,12 +12,19 @@ namespace KataScript {
         std::mutex scopeInsert;
         std::mutex fncInsert;
 #endif
-        unordered_map<string, ValueRef> variables;
-        unordered_map<string, ScopeRef> scopes;
-        unordered_map<string, FunctionRef> functions;
+        unordered_map<Symbol, ValueRef> variables;
+        unordered_map<Symbol, ScopeRef> scopes;
+        unordered_map<Symbol, FunctionRef> functions;
+        // bumped whenever functions changes, so cached method lookups know when they're stale
+        size_t functionsVersion = 0;
         bool isClassScope = false;
+        // a function call keeps its arguments and var locals in slots instead of the maps above
+        vector<ValueRef> slots;
+        const vector<Symbol>* slotNames = nullptr;
+        // the function scope whose slots expressions in this scope use
+        Scope* frame = nullptr;
 
-        ValueRef& insertVar(const string& n, ValueRef val) {
+        ValueRef& insertVar(Symbol n, ValueRef val) {
 #ifndef KATASCRIPT_THREAD_UNSAFE
             auto l = std::unique_lock(varInsert);
 #endif
@@ -26,6 +33,35 @@ namespace KataScript {
             return ref;
         }
 
+        // name lookup into the slots, for code that wasn't resolved against this frame
+        ValueRef* findSlot(Symbol n) {
+            if (slotNames) {
+                for (auto i = slots.size(); i > 0; --i) {
+                    if (slots[i - 1] && (*slotNames)[i - 1] == n) {
+                        return &slots[i - 1];
+                    }
+                }
+            }
+            return nullptr;
+        }
+
+        ValueRef& slot(size_t index) {
+            auto& ref = frame->slots[index];
+            if (!ref) {
+                ref = makeNull();
+            }
+            return ref;
+        }
+
+        // forget the slots a closing block declared
+        void clearSlots(size_t first, size_t end) {
+            if (frame) {
+                for (; first < end; ++first) {
+                    frame->slots[first] = nullptr;
+                }
+            }
+        }
+
         ScopeRef insertScope(ScopeRef val) {
 #ifndef KATASCRIPT_THREAD_UNSAFE
             auto l = std::unique_lock(scopeInsert);
@@ -36,13 +72,17 @@ namespace KataScript {
 
         Scope(KataScriptInterpreter* interpereter) : name("global"), parent(nullptr), host(interpereter) {}
         Scope(const string& name_, KataScriptInterpreter* interpereter) : name(name_), parent(nullptr), host(interpereter) {}
-        Scope(const string& name_, ScopeRef scope) : name(name_), parent(scope), host(scope->host) {}
+        Scope(const string& name_, ScopeRef scope) : name(name_), parent(scope), host(scope->host), frame(scope->frame) {}
         Scope(const Scope& o) : name(o.name), parent(o.parent), scopes(o.scopes), functions(o.functions), host(o.host) {
             // copy vars by value when cloning a scope
             for (auto&& v : o.variables) {
-                variables[v.first] = make_shared<Value>(v.second->value);
+                variables[v.first] = makeValue(v.second->value);
+            }
+        }
+        Scope(const string& name_, const unordered_map<string, ValueRef>& variables_) : name(name_) {
+            for (auto&& v : variables_) {
+                variables[v.first] = v.second;
             }
         }
-        Scope(const string& name_, const unordered_map<string, ValueRef>& variables_) : name(name_), variables(variables_) {}
     };
 }
\ No newline at end of file
@@ -24,14 +24,49 @@ namespace KataScript {
             } else {
                 auto name = scope->name;
                 scope->functions.clear();
+                ++scope->functionsVersion;
                 scope->variables.clear();
                 scope->scopes.clear();
+                scope->slots.clear();
+                scope->slotNames = nullptr;
                 scope = scope->parent;
                 scope->scopes.erase(name);
             }
         }
     }
 
+    // function calls and blocks get a scope that isn't registered with its parent
+    // it is recycled when the call is over, unless something still holds on to it
+    ScopeRef KataScriptInterpreter::acquireScope(const string& name, ScopeRef scope) {
+        if (freeScopes.empty()) {
+            return make_shared<Scope>(name, scope);
+        }
+        auto ref = std::move(freeScopes.back());
+        freeScopes.pop_back();
+        ref->name = name;
+        ref->parent = scope;
+        ref->host = scope->host;
+        ref->frame = scope->frame;
+        return ref;
+    }
+
+    void KataScriptInterpreter::releaseScope(ScopeRef& scope) {
+        if (scope.use_count() == 1) {
+            auto parent = std::move(scope->parent);
+            scope->functions.clear();
+            ++scope->functionsVersion;
+            scope->variables.clear();
+            scope->scopes.clear();
+            scope->slots.clear();
+            scope->slotNames = nullptr;
+            freeScopes.push_back(std::move(scope));
+            scope = std::move(parent);
+        } else {
+            // it outlives the call, like a lazy argument that was kept, so it keeps its variables and its place in the chain
+            scope = scope->parent;
+        }
+    }
+
     ScopeRef KataScriptInterpreter::newClassScope(const string& name, ScopeRef scope) {
         auto ref = newScope(name, scope);
         ref->isClassScope = true;
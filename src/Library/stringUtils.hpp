@@ -3,6 +3,7 @@
 #include <vector>
 #include <string>
 #include <charconv>
+#include <algorithm>
 
 namespace KataScript {
     using std::string_view;
@@ -11,7 +12,7 @@ namespace KataScript {
 
     // Convert a string into a double
     inline std::pair<double, bool> fromChars(const string& token) {
-        double x;
+        double x = 0;
         bool b;
 #ifdef _MSC_VER
         // std::from_chars is amazing, but only works properly in MSVC
@@ -29,7 +30,7 @@ namespace KataScript {
     }
 
     inline std::pair<double, bool> fromChars(string_view token) {
-        double x;
+        double x = 0;
         bool b;
 #ifdef _MSC_VER
         // std::from_chars is amazing, but only works properly in MSVC
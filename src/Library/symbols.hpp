@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <deque>
+#include <shared_mutex>
+#include <mutex>
+
+namespace KataScript {
+    // every identifier gets interned once into a small integer id
+    // one table serves every interpreter and ids are never reused, so a symbol stays valid anywhere
+    class SymbolTable {
+        std::unordered_map<std::string_view, uint32_t> ids;
+        // a deque never moves its strings, so the views in ids stay good
+        std::deque<std::string> names;
+#ifndef KATASCRIPT_THREAD_UNSAFE
+        mutable std::shared_mutex lock;
+#endif
+
+        // id 0 is the empty name, so default constructed symbols have a name too
+        SymbolTable() {
+            ids.emplace(names.emplace_back(), 0);
+        }
+
+    public:
+        static SymbolTable& get() {
+            static SymbolTable table;
+            return table;
+        }
+
+        uint32_t intern(std::string_view name) {
+            {
+#ifndef KATASCRIPT_THREAD_UNSAFE
+                auto l = std::shared_lock(lock);
+#endif
+                auto iter = ids.find(name);
+                if (iter != ids.end()) {
+                    return iter->second;
+                }
+            }
+#ifndef KATASCRIPT_THREAD_UNSAFE
+            auto l = std::unique_lock(lock);
+#endif
+            // another thread might have added it while we waited
+            auto iter = ids.find(name);
+            if (iter != ids.end()) {
+                return iter->second;
+            }
+            auto id = (uint32_t)names.size();
+            ids.emplace(names.emplace_back(name), id);
+            return id;
+        }
+
+        // the id find gives a name that was never interned
+        static constexpr uint32_t missing = UINT32_MAX;
+
+        // look a name up without interning it
+        uint32_t find(std::string_view name) const {
+#ifndef KATASCRIPT_THREAD_UNSAFE
+            auto l = std::shared_lock(lock);
+#endif
+            auto iter = ids.find(name);
+            return iter != ids.end() ? iter->second : missing;
+        }
+
+        const std::string& name(uint32_t id) const {
+#ifndef KATASCRIPT_THREAD_UNSAFE
+            auto l = std::shared_lock(lock);
+#endif
+            return names[id];
+        }
+
+        size_t size() const {
+#ifndef KATASCRIPT_THREAD_UNSAFE
+            auto l = std::shared_lock(lock);
+#endif
+            return names.size();
+        }
+    };
+
+    // an interned name, hashing and comparing one is just the id
+    // strings convert implicitly so the maps keyed by symbol still take plain names
+    struct Symbol {
+        uint32_t id = 0;
+
+        Symbol() = default;
+        Symbol(std::string_view name) : id(SymbolTable::get().intern(name)) {}
+        Symbol(const std::string& name) : Symbol(std::string_view(name)) {}
+        Symbol(const char* name) : Symbol(std::string_view(name)) {}
+
+        // for names that come from runtime data, which would otherwise fill the table forever
+        // a name that was never interned can't be in any map, so it gets an id that matches nothing
+        static Symbol find(std::string_view name) {
+            Symbol symbol;
+            symbol.id = SymbolTable::get().find(name);
+            return symbol;
+        }
+
+        bool exists() const {
+            return id != SymbolTable::missing;
+        }
+
+        const std::string& getString() const {
+            return SymbolTable::get().name(id);
+        }
+
+        bool operator==(const Symbol& o) const {
+            return id == o.id;
+        }
+    };
+}
+
+template<>
+struct std::hash<KataScript::Symbol> {
+    size_t operator()(const KataScript::Symbol& symbol) const noexcept {
+        return symbol.id;
+    }
+};
@@ -0,0 +1,320 @@
+#pragma once
+
+#include <istream>
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KATASCRIPT_SSE2
+#endif
+
+namespace KataScript {
+    // tokenizer special characters
+    constexpr string_view WhitespaceChars = " \t\r\n";
+    constexpr string_view GrammarChars = " \t\r\n,.(){}[];+-/*%<>=!&|\"";
+    constexpr string_view MultiCharTokenStartChars = "+-/*<>=!&|";
+    constexpr string_view NumericChars = "0123456789.";
+    constexpr string_view NumericStartChars = "0123456789.";
+    constexpr string_view DisallowedIdentifierStartChars = "0123456789.- \t\r\n,.(){}[];+-/*%<>=!&|\"";
+
+    // which of the sets above a character is in, as bit flags
+    enum class CharClass : uint8_t {
+        Whitespace = 1,
+        Grammar = 2,
+        MultiCharTokenStart = 4,
+        Numeric = 8,
+        DisallowedIdentifierStart = 16
+    };
+
+    constexpr array<uint8_t, 256> makeCharClasses() {
+        array<uint8_t, 256> table{};
+        auto add = [&table](string_view chars, CharClass charClass) {
+            for (auto c : chars) {
+                table[(uint8_t)c] |= (uint8_t)charClass;
+            }
+        };
+        add(WhitespaceChars, CharClass::Whitespace);
+        add(GrammarChars, CharClass::Grammar);
+        add(MultiCharTokenStartChars, CharClass::MultiCharTokenStart);
+        add(NumericChars, CharClass::Numeric);
+        add(DisallowedIdentifierStartChars, CharClass::DisallowedIdentifierStart);
+        return table;
+    }
+
+    // one lookup per character instead of searching the sets
+    inline constexpr array<uint8_t, 256> CharClasses = makeCharClasses();
+
+    constexpr bool isCharClass(char c, CharClass charClass) {
+        return CharClasses[(uint8_t)c] & (uint8_t)charClass;
+    }
+
+    // keywords the parser cares about, spellings that mean the same thing share a keyword
+    enum class Keyword : uint8_t {
+        None,
+        Function,
+        Var,
+        Loop,
+        Foreach,
+        If,
+        Else,
+        Class,
+        Return,
+        Break,
+        Continue,
+        Import,
+        True,
+        False,
+        Null
+    };
+
+    struct KeywordEntry {
+        string_view text;
+        Keyword keyword = Keyword::None;
+    };
+
+    // perfect hash over the keywords, every keyword gets a slot of its own
+    constexpr size_t keywordHash(string_view word) {
+        return (word.size() * 7 + (uint8_t)word.front() + (uint8_t)word.back() * 8) & 31;
+    }
+
+    constexpr array<KeywordEntry, 32> makeKeywordTable() {
+        KeywordEntry keywords[] = {
+            { "fn", Keyword::Function }, { "func", Keyword::Function }, { "function", Keyword::Function },
+            { "var", Keyword::Var }, { "for", Keyword::Loop }, { "while", Keyword::Loop },
+            { "foreach", Keyword::Foreach }, { "if", Keyword::If }, { "else", Keyword::Else },
+            { "class", Keyword::Class }, { "return", Keyword::Return }, { "break", Keyword::Break },
+            { "continue", Keyword::Continue }, { "import", Keyword::Import }, { "true", Keyword::True },
+            { "false", Keyword::False }, { "null", Keyword::Null },
+        };
+        array<KeywordEntry, 32> table{};
+        for (auto& entry : keywords) {
+            auto& slot = table[keywordHash(entry.text)];
+            if (slot.keyword != Keyword::None) {
+                // a new keyword collides, pick new multipliers for keywordHash
+                throw "keyword hash collision";
+            }
+            slot = entry;
+        }
+        return table;
+    }
+
+    inline constexpr array<KeywordEntry, 32> KeywordTable = makeKeywordTable();
+
+    // a single comparison tells whether a word is a keyword
+    constexpr Keyword getKeyword(string_view word) {
+        if (word.empty()) {
+            return Keyword::None;
+        }
+        auto& entry = KeywordTable[keywordHash(word)];
+        return entry.text == word ? entry.keyword : Keyword::None;
+    }
+
+    // a token and where it starts in the source, lines and columns count from 1
+    struct Token {
+        string_view text;
+        size_t line = 1;
+        size_t column = 1;
+        Keyword keyword = Keyword::None;
+    };
+
+    // splits a whole script into tokens, either straight out of a buffer
+    // or out of a stream that is read in fixed size chunks
+    // a token's text stays valid until the next call to next(), or for the life of the buffer
+    class Tokenizer {
+        std::istream* stream = nullptr;
+        size_t chunkSize = 0;
+        // holds the unconsumed tail of the stream, only used when streaming
+        string data;
+        string_view view;
+        size_t start = 0;
+        size_t line = 1;
+        size_t column = 1;
+        // last character of the previous token on this line, 0 at the start of a line
+        char previous = 0;
+
+        // make sure there is a character at start + offset, pulling in more of the stream if needed
+        bool available(size_t offset) {
+            while (start + offset >= view.size()) {
+                if (!stream || !*stream) {
+                    return false;
+                }
+                // drop everything before the current token so memory stays bounded
+                data.erase(0, start);
+                start = 0;
+                auto size = data.size();
+                data.resize(size + chunkSize);
+                stream->read(data.data() + size, chunkSize);
+                data.resize(size + (size_t)stream->gcount());
+                view = data;
+            }
+            return true;
+        }
+
+        char at(size_t offset) {
+            return available(offset) ? view[start + offset] : 0;
+        }
+
+        static bool isGrammar(char c) {
+            return isCharClass(c, CharClass::Grammar);
+        }
+
+        static bool isNumeric(char c) {
+            return isCharClass(c, CharClass::Numeric);
+        }
+
+        static bool isMultiCharStart(char c) {
+            return isCharClass(c, CharClass::MultiCharTokenStart);
+        }
+
+        // position of the first grammar character at or after pos, or the end of the view
+        size_t findGrammar(size_t pos) const {
+            auto data = view.data();
+            auto size = view.size();
+#if defined(KATASCRIPT_SSE2)
+            // letters, digits, underscores and anything past ascii are never grammar, so whole blocks of them are skipped
+            // blocks flag a few more characters than just grammar, so flagged characters are checked with the table
+            // wider blocks don't pay off, most words are shorter than 16 characters
+            auto atMost = [](__m128i x, char limit) {
+                return _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(limit)), x);
+            };
+            auto inRange = [&atMost](__m128i x, char first, char last) {
+                return atMost(_mm_sub_epi8(x, _mm_set1_epi8(first)), last - first);
+            };
+            while (pos + 16 <= size) {
+                auto block = _mm_loadu_si128((const __m128i*)(data + pos));
+                // grammar is whitespace and '!' to '/', ';' to '>', '[' and ']', or '{' to '}'
+                auto flagged = (uint32_t)_mm_movemask_epi8(_mm_or_si128(
+                    _mm_or_si128(atMost(block, 0x2f), inRange(block, 0x3b, 0x3e)),
+                    _mm_or_si128(inRange(block, 0x5b, 0x5d), inRange(block, 0x7b, 0x7d))));
+                while (flagged) {
+                    auto offset = (size_t)std::countr_zero(flagged);
+                    if (isGrammar(data[pos + offset])) {
+                        return pos + offset;
+                    }
+                    flagged &= flagged - 1;
+                }
+                pos += 16;
+            }
+#endif
+            while (pos < size && !isGrammar(data[pos])) {
+                ++pos;
+            }
+            return pos;
+        }
+
+        // length of the token once all the characters up to the next grammar character are added
+        size_t scanWord(size_t length) {
+            while (available(length)) {
+                auto pos = findGrammar(start + length);
+                if (pos < view.size()) {
+                    return pos - start;
+                }
+                length = view.size() - start;
+            }
+            return length;
+        }
+
+        // length of the token once all the characters up to the next c are added
+        // find is a memchr, which is already vectorized
+        size_t scanUntil(char c, size_t length) {
+            while (available(length)) {
+                auto pos = view.find(c, start + length);
+                if (pos != string::npos) {
+                    return pos - start;
+                }
+                length = view.size() - start;
+            }
+            return length;
+        }
+
+        // numbers with a decimal part keep going past the dot
+        size_t scanDecimal(size_t length) {
+            if (at(length) == '.' && isNumeric(at(length + 1))) {
+                return scanWord(length + 1);
+            }
+            return length;
+        }
+
+        void skip(size_t length) {
+            auto text = view.substr(start, length);
+            auto newline = text.rfind('\n');
+            if (newline == string::npos) {
+                column += length;
+            } else {
+                line += std::count(text.begin(), text.end(), '\n');
+                column = length - newline;
+                previous = 0;
+            }
+            start += length;
+        }
+
+    public:
+        static constexpr size_t DefaultChunkSize = 64 * 1024;
+
+        Tokenizer(string_view buffer, size_t firstLine = 1) : view(buffer), line(firstLine) {}
+        Tokenizer(std::istream& input, size_t chunk = DefaultChunkSize, size_t firstLine = 1)
+            : stream(&input), chunkSize(chunk ? chunk : DefaultChunkSize), line(firstLine) {}
+
+        // read the next token, returns false once the source runs out
+        bool next(Token& token) {
+            while (available(0)) {
+                auto c = view[start];
+                if (isCharClass(c, CharClass::Whitespace)) {
+                    size_t length = 1;
+                    while (available(length) && isCharClass(view[start + length], CharClass::Whitespace)) {
+                        ++length;
+                    }
+                    skip(length);
+                    continue;
+                }
+                // comments run to the end of the line
+                if (c == '/' && at(1) == '/') {
+                    skip(scanUntil('\n', 2));
+                    continue;
+                }
+
+                token.line = line;
+                token.column = column;
+                token.keyword = Keyword::None;
+                size_t length;
+                if (c == '\"') {
+                    // string literals can span lines
+                    length = scanUntil('\"', 1);
+                    if (!available(length)) {
+                        token.text = view.substr(start, 1);
+                        throw Exception("Quote mismatch at "s + string(view.substr(start)));
+                    }
+                    ++length;
+                } else if (c == '-' && isNumeric(at(1)) && (previous == 0 || isMultiCharStart(previous))) {
+                    // negative numbers
+                    length = scanDecimal(scanWord(1));
+                } else if (c == '.' && isNumeric(at(1))) {
+                    // decimals without a leading digit, as opposed to dot syntax for function calls
+                    length = scanWord(1);
+                } else if (isGrammar(c)) {
+                    // multicharacter special tokens like ++, -=, etc
+                    length = isMultiCharStart(c) && isMultiCharStart(at(1)) ? 2 : 1;
+                } else {
+                    length = scanDecimal(scanWord(0));
+                    token.keyword = getKeyword(view.substr(start, length));
+                }
+
+                token.text = view.substr(start, length);
+                skip(length);
+                previous = token.text.back();
+                return true;
+            }
+            return false;
+        }
+    };
+
+    inline vector<string_view> ViewTokenize(string_view input) {
+        vector<string_view> ret;
+        Tokenizer tokenizer(input);
+        Token token;
+        while (tokenizer.next(token)) {
+            ret.push_back(token.text);
+        }
+        return ret;
+    }
+}
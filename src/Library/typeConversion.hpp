@@ -9,89 +9,115 @@ namespace KataScript {
         return get<vector<T>>(value);
     }
 
+    template <typename T>
+    const vector<T>& Array::getStdVector() const {
+        return get<vector<T>>(value);
+    }
+
     template <typename T>
     vector<T>& Value::getStdVector() {
-        return get<Array>(value).getStdVector<T>();
+        return getArray().getStdVector<T>();
     }
 
-    void ArrayMember::setValue(const ValueRef& val) {
-        auto& arr = arrayRef->getArray();
-        val->hardconvert(arr.getType());
+    template <typename T>
+    const vector<T>& Value::getStdVector() const {
+        return getArray().getStdVector<T>();
+    }
+
+    inline void checkArrayBounds(const Array& arr, Int index) {
+        if (index < 0 || index >= (Int)arr.size()) {
+            throw Exception("Out of bounds array access index "s + std::to_string(index) + ", array length " + std::to_string(arr.size()));
+        }
+    }
+
+    // read an array element straight into a value, numbers don't need any allocation
+    void loadArrayElement(const Array& arr, Int index, Value& out) {
+        checkArrayBounds(arr, index);
         switch (arr.getType()) {
         case Type::Int:
-            get<vector<Int>>(arr.value)[index] = val->getInt();
+            out.value = get<vector<Int>>(arr.value)[index];
             break;
         case Type::Float:
-            get<vector<Float>>(arr.value)[index] = val->getFloat();
+            out.value = get<vector<Float>>(arr.value)[index];
             break;
         case Type::Vec3:
-            get<vector<vec3>>(arr.value)[index] = val->getVec3();
+            out.value = get<vector<vec3>>(arr.value)[index];
             break;
         case Type::Function:
-            get<vector<FunctionRef>>(arr.value)[index] = val->getFunction();
+            out.value = get<vector<FunctionRef>>(arr.value)[index];
             break;
         case Type::UserPointer:
-            get<vector<UserPointer>>(arr.value)[index] = val->getPointer();
+            out.value = get<vector<UserPointer>>(arr.value)[index];
             break;
         case Type::String:
-            get<vector<string>>(arr.value)[index] = val->getString();
+            out.value = get<vector<string>>(arr.value)[index];
             break;
         default:
-            throw Exception("Attempting to set array of illegal type");
+            throw Exception("Attempting to access array of illegal type");
             break;
         }
     }
 
-    ValueRef ArrayMember::getValue() const {
-        auto& arr = arrayRef->getArray();
-        if (index < 0 || index >= (Int)arr.size()) {
-            throw Exception("Out of bounds array access index "s + std::to_string(index) + ", array length " + std::to_string(arr.size()));
-        }
+    // write a value into an array element, the value is converted to the array's type first
+    void storeArrayElement(Array& arr, Int index, Value& val) {
+        checkArrayBounds(arr, index);
+        val.hardconvert(arr.getType());
         switch (arr.getType()) {
         case Type::Int:
-            return make_shared<Value>(get<vector<Int>>(arr.value)[index]);
+            get<vector<Int>>(arr.value)[index] = val.getInt();
             break;
         case Type::Float:
-            return make_shared<Value>(get<vector<Float>>(arr.value)[index]);
+            get<vector<Float>>(arr.value)[index] = val.getFloat();
             break;
         case Type::Vec3:
-            return make_shared<Value>(get<vector<vec3>>(arr.value)[index]);
+            get<vector<vec3>>(arr.value)[index] = val.getVec3();
             break;
         case Type::Function:
-            return make_shared<Value>(get<vector<FunctionRef>>(arr.value)[index]);
+            get<vector<FunctionRef>>(arr.value)[index] = val.getFunction();
             break;
         case Type::UserPointer:
-            return make_shared<Value>(get<vector<UserPointer>>(arr.value)[index]);
+            get<vector<UserPointer>>(arr.value)[index] = val.getPointer();
             break;
         case Type::String:
-            return make_shared<Value>(get<vector<string>>(arr.value)[index]);
+            get<vector<string>>(arr.value)[index] = val.getString();
             break;
         default:
-            throw Exception("Attempting to access array of illegal type");
+            throw Exception("Attempting to set array of illegal type");
             break;
         }
     }
 
+    void ArrayMember::setValue(const ValueRef& val) {
+        auto converted = *val;
+        storeArrayElement(arrayRef->getArray(), index, converted);
+    }
+
+    ValueRef ArrayMember::getValue() const {
+        auto val = makeImmediate();
+        loadArrayElement(std::as_const(*arrayRef).getArray(), index, *val);
+        return val;
+    }
+
     Class::Class(const Class& o) : name(o.name), functionScope(o.functionScope) {
         for (auto&& v : o.variables) {
-            variables[v.first] = make_shared<Value>(v.second->value);
+            variables[v.first] = makeValue(v.second->value);
         }
     }
 
     Class::Class(const ScopeRef& o) : name(o->name), functionScope(o) {
         for (auto&& v : o->variables) {
-            variables[v.first] = make_shared<Value>(v.second->value);
+            variables[v.first] = makeValue(v.second->value);
         }
     }
 
     Class::~Class() {
-        auto iter = functionScope->functions.find("~"s + name);
+        auto iter = functionScope->functions.find(Symbol::find("~"s + name));
         if (iter != functionScope->functions.end()) {
             functionScope->host->callFunction(iter->second, functionScope, {}, this);
         }
     }
 
-    size_t Value::getHash() {
+    size_t Value::getHash() const {
         size_t hash = 0;
         switch (getType()) {
         default: break;
@@ -199,7 +225,7 @@ namespace KataScript {
                     break;
                 case Type::String:
                 {
-                    auto str = getString();
+                    auto str = std::as_const(*this).getString();
                     value = Array(vector<string>{ });
                     auto& arry = getStdVector<string>();
                     for (auto&& ch : str) {
@@ -218,41 +244,41 @@ namespace KataScript {
                 case Type::Int:
                 case Type::Float:
                 case Type::Vec3:
-                    value = List({ make_shared<Value>(value) });
+                    value = List({ makeValue(value) });
                     break;
                 case Type::String:
                 {
-                    auto str = getString();
+                    auto str = std::as_const(*this).getString();
                     value = List();
                     auto& list = getList();
                     for (auto&& ch : str) {
-                        list.push_back(make_shared<Value>(""s + ch));
+                        list.push_back(makeValue(""s + ch));
                     }
                 }
                 break;
                 case Type::Array:
-                    Array arr = getArray();
+                    Array arr = std::as_const(*this).getArray();
                     value = List();
                     auto& list = getList();
                     switch (arr.getType()) {
                     case Type::Int:
                         for (auto&& item : get<vector<Int>>(arr.value)) {
-                            list.push_back(make_shared<Value>(item));
+                            list.push_back(makeValue(item));
                         }
                         break;
                     case Type::Float:
                         for (auto&& item : get<vector<Float>>(arr.value)) {
-                            list.push_back(make_shared<Value>(item));
+                            list.push_back(makeValue(item));
                         }
                         break;
                     case Type::Vec3:
                         for (auto&& item : get<vector<vec3>>(arr.value)) {
-                            list.push_back(make_shared<Value>(item));
+                            list.push_back(makeValue(item));
                         }
                         break;
                     case Type::String:
                         for (auto&& item : get<vector<string>>(arr.value)) {
-                            list.push_back(make_shared<Value>(item));
+                            list.push_back(makeValue(item));
                         }
                         break;
                     default:
@@ -276,30 +302,30 @@ namespace KataScript {
                     break;
                 case Type::Array:
                 {
-                    Array arr = getArray();
+                    Array arr = std::as_const(*this).getArray();
                     value = make_shared<Dictionary>();
-                    auto hashbits = typeHashBits(Type::Int);
                     auto& dict = getDictionary();
-                    size_t index = 0;
+                    dict->reserve(arr.size());
+                    Int index = 0;
                     switch (arr.getType()) {
                     case Type::Int:
                         for (auto&& item : get<vector<Int>>(arr.value)) {
-                            (*dict)[index++ ^ hashbits] = make_shared<Value>(item);
+                            (*dict)[Value(Int(index++))] = makeValue(item);
                         }
                         break;
                     case Type::Float:
                         for (auto&& item : get<vector<Float>>(arr.value)) {
-                            (*dict)[index++ ^ hashbits] = make_shared<Value>(item);
+                            (*dict)[Value(Int(index++))] = makeValue(item);
                         }
                         break;
                     case Type::Vec3:
                         for (auto&& item : get<vector<vec3>>(arr.value)) {
-                            (*dict)[index++ ^ hashbits] = make_shared<Value>(item);
+                            (*dict)[Value(Int(index++))] = makeValue(item);
                         }
                         break;
                     case Type::String:
                         for (auto&& item : get<vector<string>>(arr.value)) {
-                            (*dict)[index++ ^ hashbits] = make_shared<Value>(item);
+                            (*dict)[Value(Int(index++))] = makeValue(item);
                         }
                         break;
                     default:
@@ -310,13 +336,13 @@ namespace KataScript {
                 break;
                 case Type::List:
                 {
-                    auto hashbits = typeHashBits(Type::Int);
-                    List list = getList();
+                    List list = std::as_const(*this).getList();
                     value = make_shared<Dictionary>();
                     auto& dict = getDictionary();
-                    size_t index = 0;
+                    dict->reserve(list.size());
+                    Int index = 0;
                     for (auto&& item : list) {
-                        (*dict)[index++ ^ hashbits] = item;
+                        (*dict)[Value(Int(index++))] = item;
                     }
                 }
                 break;
@@ -346,7 +372,7 @@ namespace KataScript {
                     value = (Int)getFloat();
                     break;
                 case Type::String: {
-                    auto [val, valid] = fromChars(getString());
+                    auto [val, valid] = fromChars(std::as_const(*this).getString());
                     if (valid) {
                         value = (Int)val;
                     } else {
@@ -355,10 +381,10 @@ namespace KataScript {
                 }
                     break;
                 case Type::Array:
-                    value = (Int)getArray().size();
+                    value = (Int)std::as_const(*this).getArray().size();
                     break;
                 case Type::List:
-                    value = (Int)getList().size();
+                    value = (Int)std::as_const(*this).getList().size();
                     break;
                 }
                 break;
@@ -368,7 +394,7 @@ namespace KataScript {
                     throw Exception("Conversion not defined for types `"s + getTypeName(getType()) + "` to `" + getTypeName(newType) + "`");
                     break;
                 case Type::String: {
-                    auto [val, valid] = fromChars(getString());
+                    auto [val, valid] = fromChars(std::as_const(*this).getString());
                     if (valid) {
                         value = (Float)val;
                     } else {
@@ -377,10 +403,10 @@ namespace KataScript {
                 }
                     break;
                 case Type::Array:
-                    value = (Float)getArray().size();
+                    value = (Float)std::as_const(*this).getArray().size();
                     break;
                 case Type::List:
-                    value = (Float)getList().size();
+                    value = (Float)std::as_const(*this).getList().size();
                     break;
                 }
                 break;
@@ -392,7 +418,7 @@ namespace KataScript {
                 case Type::Array:
                 {
                     string newval = "["s;
-                    auto& arr = getArray();
+                    auto& arr = std::as_const(*this).getArray();
                     switch (arr.getType()) {
                     case Type::Int:
                         for (auto&& item : get<vector<Int>>(arr.value)) {
@@ -431,7 +457,7 @@ namespace KataScript {
                 case Type::List:
                 {
                     string newval = "["s;
-                    auto& list = getList();
+                    auto& list = std::as_const(*this).getList();
                     for (auto val : list) {
                         newval += val->getPrintString() + ", ";
                     }
@@ -447,9 +473,9 @@ namespace KataScript {
                     string newval = "["s;
                     auto& dict = getDictionary();
                     for (auto&& val : *dict) {
-                        newval += "`"s + std::to_string(val.first)  + ": " + val.second->getPrintString() + "`, ";
+                        newval += "`"s + val.first.getPrintString() + ": " + val.second->getPrintString() + "`, ";
                     }
-                    if (newval.size()) {
+                    if (newval.size() > 1) {
                         newval.pop_back();
                         newval.pop_back();
                     }
@@ -461,7 +487,7 @@ namespace KataScript {
                     auto& strct = getClass();
                     string newval = strct->name + ":\n"s;
                     for (auto&& val : strct->variables) {
-                        newval += "`"s + val.first + ": " + val.second->getPrintString() + "`\n";
+                        newval += "`"s + val.first.getString() + ": " + val.second->getPrintString() + "`\n";
                     }
                     value = newval;
                 }
@@ -476,111 +502,141 @@ namespace KataScript {
                     break;
                 case Type::Dictionary:
                 {
-                    Array arr;
                     auto dict = getDictionary();
+                    if (dict->empty()) {
+                        value = Array();
+                        break;
+                    }
                     auto listType = dict->begin()->second->getType();
                     switch (listType) {
                     case Type::Int:
-                        arr = Array(vector<Int>{});
+                    {
+                        vector<Int> items;
                         for (auto&& item : *dict) {
                             if (item.second->getType() == listType) {
-                                arr.push_back(item.second->getInt());
+                                items.push_back(item.second->getInt());
                             }
                         }
-                        break;
+                        value = Array(std::move(items));
+                    }
+                    break;
                     case Type::Float:
-                        arr = Array(vector<Float>{});
+                    {
+                        vector<Float> items;
                         for (auto&& item : *dict) {
                             if (item.second->getType() == listType) {
-                                arr.push_back(item.second->getFloat());
+                                items.push_back(item.second->getFloat());
                             }
                         }
-                        break;
+                        value = Array(std::move(items));
+                    }
+                    break;
                     case Type::Vec3:
-                        arr = Array(vector<vec3>{});
+                    {
+                        vector<vec3> items;
                         for (auto&& item : *dict) {
                             if (item.second->getType() == listType) {
-                                arr.push_back(item.second->getVec3());
+                                items.push_back(item.second->getVec3());
                             }
                         }
-                        break;
+                        value = Array(std::move(items));
+                    }
+                    break;
                     case Type::Function:
-                        arr = Array(vector<FunctionRef>{});
+                    {
+                        vector<FunctionRef> items;
                         for (auto&& item : *dict) {
                             if (item.second->getType() == listType) {
-                                arr.push_back(item.second->getFunction());
+                                items.push_back(item.second->getFunction());
                             }
                         }
-                        break;
+                        value = Array(std::move(items));
+                    }
+                    break;
                     case Type::String:
-                        arr = Array(vector<string>{});
+                    {
+                        vector<string> items;
                         for (auto&& item : *dict) {
                             if (item.second->getType() == listType) {
-                                arr.push_back(item.second->getString());
+                                items.push_back(std::as_const(*item.second).getString());
                             }
                         }
-                        break;
+                        value = Array(std::move(items));
+                    }
+                    break;
                     default:
                         throw Exception("Array cannot contain collections");
                         break;
                     }
-                    value = arr;
                 }
                 break;
                 case Type::List:
                 {
-                    auto list = getList();
+                    auto list = std::as_const(*this).getList();
                     auto listType = list[0]->getType();
-                    Array arr;
                     switch (listType) {
                     case Type::Null:
-                        arr = Array(vector<Int>{});
+                        value = Array();
                         break;
                     case Type::Int:
-                        arr = Array(vector<Int>{});
+                    {
+                        vector<Int> items;
                         for (auto&& item : list) {
                             if (item->getType() == listType) {
-                                arr.push_back(item->getInt());
+                                items.push_back(item->getInt());
                             }
                         }
-                        break;
+                        value = Array(std::move(items));
+                    }
+                    break;
                     case Type::Float:
-                        arr = Array(vector<Float>{});
+                    {
+                        vector<Float> items;
                         for (auto&& item : list) {
                             if (item->getType() == listType) {
-                                arr.push_back(item->getFloat());
+                                items.push_back(item->getFloat());
                             }
                         }
-                        break;
+                        value = Array(std::move(items));
+                    }
+                    break;
                     case Type::Vec3:
-                        arr = Array(vector<vec3>{});
+                    {
+                        vector<vec3> items;
                         for (auto&& item : list) {
                             if (item->getType() == listType) {
-                                arr.push_back(item->getVec3());
+                                items.push_back(item->getVec3());
                             }
                         }
-                        break;
+                        value = Array(std::move(items));
+                    }
+                    break;
                     case Type::Function:
-                        arr = Array(vector<FunctionRef>{});
+                    {
+                        vector<FunctionRef> items;
                         for (auto&& item : list) {
                             if (item->getType() == listType) {
-                                arr.push_back(item->getFunction());
+                                items.push_back(item->getFunction());
                             }
                         }
-                        break;
+                        value = Array(std::move(items));
+                    }
+                    break;
                     case Type::String:
-                        arr = Array(vector<string>{});
+                    {
+                        vector<string> items;
                         for (auto&& item : list) {
                             if (item->getType() == listType) {
-                                arr.push_back(item->getString());
+                                items.push_back(std::as_const(*item).getString());
                             }
                         }
-                        break;
+                        value = Array(std::move(items));
+                    }
+                    break;
                     default:
                         throw Exception("Array cannot contain collections");
                         break;
                     }
-                    value = arr;
                 }
                 break;
                 }
@@ -603,17 +659,18 @@ namespace KataScript {
                 }
                 break;
                 case Type::Class:
-                    value = List({ make_shared<Value>(value) });
+                    value = List({ makeValue(value) });
                     break;
                 }
             }
             break;
             case Type::Dictionary:
             {
-                Dictionary dict;
+                auto dict = make_shared<Dictionary>();
                 for (auto&& item : getClass()->variables) {
-                    dict[std::hash<string>()(item.first) ^ typeHashBits(Type::String)] = item.second;
+                    (*dict)[Value(item.first.getString())] = item.second;
                 }
+                value = dict;
             }
             }
         }
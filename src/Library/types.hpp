@@ -7,7 +7,13 @@
 #include <functional>
 #include <unordered_map>
 #include <algorithm>
+#include <utility>
 #include <mutex>
+#include <atomic>
+#include <array>
+#include <new>
+
+#include "symbols.hpp"
 
 namespace KataScript {
     using std::vector;
@@ -21,6 +27,7 @@ namespace KataScript {
     using std::min;
 	using std::max;
     using std::make_shared;
+    using std::array;
     using namespace std::string_literals;
 
 #ifdef KATASCRIPT_USE_32_BIT_NUMBERS
@@ -285,9 +292,151 @@ namespace KataScript {
 
     // KataScript uses shared_ptr for ref counting, anything with a name
     // like fooRef is a a shared_ptr to foo
-	using ValueRef = shared_ptr<Value>;
+    // ValueRef is the exception, it's shared like one but an immediate from makeImmediate keeps its value inline
+    // the first copy of an immediate moves its value into a box that both handles share,
+    // so a number that is only moved around and read never gets a box of its own
+    class ValueRef {
+    public:
+        // big enough for a Value, checked once Value is defined
+        static constexpr size_t ImmediateSize = 32;
+
+    private:
+        mutable shared_ptr<Value> box;
+        alignas(8) mutable unsigned char storage[ImmediateSize];
+        // storage holds the value
+        mutable bool immediate = false;
+        // storage holds a value that was moved out, it's kept until the handle is reset so earlier references stay valid
+        mutable bool stale = false;
+
+        Value* inlineValue() const { return std::launder(reinterpret_cast<Value*>(storage)); }
+        void promote() const;
+        void release();
+
+        template <typename ... Ts>
+        friend ValueRef makeImmediate(Ts&&... args);
+
+    public:
+        ValueRef() noexcept {}
+        ValueRef(std::nullptr_t) noexcept {}
+        ValueRef(shared_ptr<Value> p) noexcept : box(std::move(p)) {}
+        ValueRef(const ValueRef& o);
+        ValueRef(ValueRef&& o) noexcept;
+        ValueRef& operator=(const ValueRef& o);
+        ValueRef& operator=(ValueRef&& o) noexcept;
+        ~ValueRef() { release(); }
+
+        Value* get() const { return immediate ? inlineValue() : box.get(); }
+        Value& operator*() const { return *get(); }
+        Value* operator->() const { return get(); }
+        explicit operator bool() const { return immediate || box; }
+        long use_count() const { return immediate ? 1 : box.use_count(); }
+        bool isImmediate() const { return immediate; }
+
+        friend bool operator==(const ValueRef& a, const ValueRef& b) { return a.get() == b.get(); }
+        friend bool operator==(const ValueRef& a, std::nullptr_t) { return !a; }
+    };
+
+    // values are created and dropped constantly, so their blocks get recycled per thread
+    // instead of going back to the system allocator every time
+    template <size_t Size>
+    class BlockPool {
+        struct Block { Block* next; };
+        Block* freeList = nullptr;
+        size_t freeCount = 0;
+        // idle blocks past this are given back to the system
+        static constexpr size_t maxFree = 1 << 16;
+        // values can outlive the pool at thread exit, those just use the system allocator
+        static inline thread_local bool destroyed = false;
+
+        static BlockPool& instance() {
+            static thread_local BlockPool pool;
+            return pool;
+        }
+
+        ~BlockPool() {
+            destroyed = true;
+            while (freeList) {
+                auto next = freeList->next;
+                ::operator delete(freeList);
+                freeList = next;
+            }
+        }
+
+    public:
+        static void* allocate() {
+            if (!destroyed) {
+                auto& pool = instance();
+                if (pool.freeList) {
+                    auto block = pool.freeList;
+                    pool.freeList = block->next;
+                    --pool.freeCount;
+                    return block;
+                }
+            }
+            return ::operator new(Size);
+        }
+
+        static void deallocate(void* ptr) {
+            if (!destroyed) {
+                auto& pool = instance();
+                if (pool.freeCount < maxFree) {
+                    auto block = static_cast<Block*>(ptr);
+                    block->next = pool.freeList;
+                    pool.freeList = block;
+                    ++pool.freeCount;
+                    return;
+                }
+            }
+            ::operator delete(ptr);
+        }
+    };
+
+    template <typename T>
+    struct PoolAllocator {
+        using value_type = T;
+        static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "pooled blocks use the default alignment");
+
+        PoolAllocator() = default;
+        template <typename U>
+        PoolAllocator(const PoolAllocator<U>&) {}
+
+        T* allocate(size_t n) {
+            if (n == 1) {
+                return static_cast<T*>(BlockPool<sizeof(T) < sizeof(void*) ? sizeof(void*) : sizeof(T)>::allocate());
+            }
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+
+        void deallocate(T* ptr, size_t n) {
+            if (n == 1) {
+                BlockPool<sizeof(T) < sizeof(void*) ? sizeof(void*) : sizeof(T)>::deallocate(ptr);
+            } else {
+                ::operator delete(ptr);
+            }
+        }
+
+        template <typename U>
+        bool operator==(const PoolAllocator<U>&) const { return true; }
+        template <typename U>
+        bool operator!=(const PoolAllocator<U>&) const { return false; }
+    };
+
+    // use this instead of make_shared<Value> so values come from the pool
+    template <typename ... Ts>
+    ValueRef makeValue(Ts&&... args) {
+#ifdef KATASCRIPT_NO_VALUE_POOL
+        return make_shared<Value>(std::forward<Ts>(args)...);
+#else
+        return std::allocate_shared<Value>(PoolAllocator<Value>(), std::forward<Ts>(args)...);
+#endif
+    }
+
+    // a value that stays inside its handle until the handle is copied, use it for results nothing else holds yet
+    template <typename ... Ts>
+    ValueRef makeImmediate(Ts&&... args);
+
     inline ValueRef makeNull() {
-        return make_shared<Value>();
+        return makeValue();
     }
 
     // Backing for the List type and for function arguments
@@ -309,7 +458,7 @@ namespace KataScript {
         vector<string>
         >;
 
-    inline Type getArrayType(const ArrayVariant arr) {
+    inline Type getArrayType(const ArrayVariant& arr) {
         switch (arr.index()) {
         case 0:
             return Type::Int;
@@ -348,6 +497,8 @@ namespace KataScript {
 
         template <typename T>
         vector<T>& getStdVector();
+        template <typename T>
+        const vector<T>& getStdVector() const;
 
 		bool operator==(const Array& o) const {
             if (size() != o.size()) {
@@ -622,35 +773,72 @@ namespace KataScript {
 	};
 
     struct ArrayMember {
-        ValueRef arrayRef;
+        shared_ptr<Value> arrayRef;
         Int index;
 
         void setValue(const ValueRef& val);
         ValueRef getValue() const;
     };
 
-    using Dictionary = unordered_map<size_t, ValueRef>;
+    class Dictionary;
     using DictionaryRef = shared_ptr<Dictionary>;
 
     struct Scope;
     using ScopeRef = shared_ptr<Scope>;
 
+    // the member variables of a class instance
+    // layoutId is unique to each map, and renewed by anything that removes an entry,
+    // so a cached pointer into the map can check that it's still good
+    // hosts can use this like any unordered_map, removals through it keep the caches honest
+    struct ClassVariables : unordered_map<Symbol, ValueRef> {
+        using Map = unordered_map<Symbol, ValueRef>;
+        uint64_t layoutId = newLayoutId();
+
+        static uint64_t newLayoutId() {
+#ifndef KATASCRIPT_THREAD_UNSAFE
+            static std::atomic<uint64_t> next = 1;
+#else
+            static uint64_t next = 1;
+#endif
+            return next++;
+        }
+
+        ClassVariables() = default;
+        // copies and moves are different maps, so they get their own layoutId
+        ClassVariables(const ClassVariables& o) : Map(o) {}
+        ClassVariables(ClassVariables&& o) noexcept : Map(std::move(o)) { o.layoutId = newLayoutId(); }
+        ClassVariables& operator=(const ClassVariables& o) { Map::operator=(o); layoutId = newLayoutId(); return *this; }
+        ClassVariables& operator=(ClassVariables&& o) noexcept { Map::operator=(std::move(o)); layoutId = newLayoutId(); o.layoutId = newLayoutId(); return *this; }
+
+        size_t erase(const Symbol& key) { layoutId = newLayoutId(); return Map::erase(key); }
+        iterator erase(const_iterator pos) { layoutId = newLayoutId(); return Map::erase(pos); }
+        iterator erase(const_iterator first, const_iterator last) { layoutId = newLayoutId(); return Map::erase(first, last); }
+        node_type extract(const_iterator pos) { layoutId = newLayoutId(); return Map::extract(pos); }
+        node_type extract(const Symbol& key) { layoutId = newLayoutId(); return Map::extract(key); }
+        void clear() noexcept { layoutId = newLayoutId(); Map::clear(); }
+        void swap(ClassVariables& o) noexcept { Map::swap(o); layoutId = newLayoutId(); o.layoutId = newLayoutId(); }
+    };
+
     struct Class {
         // this is the main storage object for all functions and variables
         string name;
-        unordered_map<string, ValueRef> variables;
+        ClassVariables variables;
         ScopeRef functionScope;
 #ifndef KATASCRIPT_THREAD_UNSAFE
         std::mutex varInsert;
 #endif
 
         Class(const string& name_) : name(name_) {}
-        Class(const string& name_, const unordered_map<string, ValueRef>& variables_) : name(name_), variables(variables_){}
+        Class(const string& name_, const unordered_map<string, ValueRef>& variables_) : name(name_) {
+            for (auto&& v : variables_) {
+                variables[v.first] = v.second;
+            }
+        }
         Class(const Class& o);
         Class(const ScopeRef& o);
         ~Class();
 
-        ValueRef& insertVar(const string& n, ValueRef val) {
+        ValueRef& insertVar(Symbol n, ValueRef val) {
 #ifndef KATASCRIPT_THREAD_UNSAFE
             auto l = std::unique_lock(varInsert);
 #endif
@@ -673,16 +861,53 @@ namespace KataScript {
 		func
 	};
 
+    // standard library operators the evaluators can run directly instead of through a Lambda call
+    enum class BuiltinOperator : uint8_t {
+        None,
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Modulo,
+        Equal,
+        NotEqual,
+        Less,
+        Greater,
+        LessEqual,
+        GreaterEqual,
+        Count
+    };
+
+    // standard library assignments that change their target in place, in the order of assignmentOperators
+    enum class BuiltinAssignment : uint8_t {
+        Set,
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Increment,
+        Decrement,
+        None
+    };
+
 	// Lambda is a "native function" it's how you wrap c++ code for use inside KataScript
     using Lambda = function<ValueRef(const List&)>;
     using ScopedLambda = function<ValueRef(ScopeRef, const List&)>;
     using ClassLambda = function<ValueRef(Class*, ScopeRef, const List&)>;
+    // lazy functions get their arguments unevaluated, calling a thunk evaluates that argument again every time
+    // thunks hold what they need, so one can be kept and called after the lazy function returns
+    using Thunk = function<ValueRef()>;
+    using LazyLambda = function<ValueRef(const vector<Thunk>&)>;
 
 	// forward declare so we can cross refernce types
 	// Expression is a 'generic' expression
 	struct Expression;
 	using ExpressionRef = shared_ptr<Expression>;
 
+    // compiled bytecode for the bytecode engine
+    struct Chunk;
+    using ChunkRef = shared_ptr<Chunk>;
+
     enum class FunctionType : uint8_t {
         free,
         constructor,
@@ -694,14 +919,25 @@ namespace KataScript {
         vector<ExpressionRef>,
         Lambda,
         ScopedLambda,
-        ClassLambda
+        ClassLambda,
+        LazyLambda
         >;
 
     enum class FunctionBodyType : uint8_t {
         Subexpressions,
         Lambda,
         ScopedLambda,
-        ClassLambda
+        ClassLambda,
+        LazyLambda
+    };
+
+    // the source of a function body that lazy parsing skipped over
+    // it is parsed into the body the first time the function is called
+    struct UnparsedBody {
+        string source;
+        size_t firstLine = 1;
+        // names in a method body parse as members of the class
+        bool classScope = false;
     };
 
 	// our basic function type
@@ -709,9 +945,15 @@ namespace KataScript {
         OperatorPrecedence opPrecedence;
         FunctionType type = FunctionType::free;
         string name;
-		vector<string> argNames;
+		vector<Symbol> argNames;
+        // names of the frame slots, arguments first and then var locals
+        vector<Symbol> slotNames;
 
         FunctionBodyVariant body;
+        // set while the body is still waiting to be parsed
+        shared_ptr<UnparsedBody> unparsedBody;
+        // lazily compiled body for the bytecode engine
+        ChunkRef bytecode;
 
         FunctionBodyType getBodyType() {
             return static_cast<FunctionBodyType>(body.index());
@@ -747,11 +989,13 @@ namespace KataScript {
         Function(const string& name_, const ScopedLambda& l)
             : name(name_), opPrecedence(getPrecedence(name_)), body(l) {}
         Function(const string& name_, const ClassLambda& l)
+            : name(name_), opPrecedence(getPrecedence(name_)), body(l) {}
+        Function(const string& name_, const LazyLambda& l)
             : name(name_), opPrecedence(getPrecedence(name_)), body(l) {}
 		// when using a KataScript function body
         // the operator precedence will always be "func" level (aka the highest)
 		Function(const string& name_, const vector<string>& argNames_, const vector<ExpressionRef>& body_) 
-			: name(name_), body(body_), argNames(argNames_), opPrecedence(OperatorPrecedence::func) {}
+			: name(name_), body(body_), argNames(argNames_.begin(), argNames_.end()), opPrecedence(OperatorPrecedence::func) {}
         Function(const string& name_, const vector<string>& argNames_) : Function(name_, argNames_, {}) {}
 		// default constructor makes a function with no args that returns void
 		Function(const string& name) 
@@ -11,15 +11,17 @@ namespace KataScript {
         vec3,
         FunctionRef,
         UserPointer,
-        string,
-        Array,
+        CopyOnWrite<string>,
+        CopyOnWrite<Array>,
         ArrayMember,
-        List,
+        CopyOnWrite<List>,
         DictionaryRef,
         ClassRef
         >;
 
     // our basic Object/Value type
+    // strings, arrays and lists are shared between copies of a value
+    // their non const getters give this value its own copy first, so read through a const Value where you can
     struct Value {
         ValueVariant value;
 
@@ -32,15 +34,19 @@ namespace KataScript {
         explicit Value(vec3 a) : value(a) {}
         explicit Value(FunctionRef a) : value(a) {}
         explicit Value(UserPointer a) : value(a) {}
-        explicit Value(string a) : value(a) {}
+        explicit Value(string a) : value(std::move(a)) {}
         explicit Value(const char* a) : value(string(a)) {}
-        explicit Value(Array a) : value(a) {}
+        explicit Value(Array a) : value(std::move(a)) {}
         explicit Value(ArrayMember a) : value(a) {}
-        explicit Value(List a) : value(a) {}
+        explicit Value(List a) : value(std::move(a)) {}
         explicit Value(DictionaryRef a) : value(a) {}
         explicit Value(ClassRef a) : value(a) {}
-        explicit Value(ValueVariant a) : value(a) {}
-        explicit Value(ValueRef o) : value(o->value) {}
+        explicit Value(ValueVariant a) : value(std::move(a)) {}
+        explicit Value(const ValueRef& o) : value(o->value) {}
+        Value(const Value&) = default;
+        Value(Value&&) = default;
+        Value& operator=(const Value&) = default;
+        Value& operator=(Value&&) = default;
         ~Value() {};
 
         Type getType() const {
@@ -51,68 +57,103 @@ namespace KataScript {
         string getPrintString() const {
             auto t = *this;
             t.hardconvert(Type::String);
-            return get<string>(t.value);
+            return std::as_const(t).getString();
         }
 
         // get this value as an int
         Int& getInt() {
             return get<Int>(value);
         }
+        const Int& getInt() const {
+            return get<Int>(value);
+        }
 
         // get this value as a float
         Float& getFloat() {
             return get<Float>(value);
         }
+        const Float& getFloat() const {
+            return get<Float>(value);
+        }
 
         // get this value as a vec3
         vec3& getVec3() {
             return get<vec3>(value);
         }
+        const vec3& getVec3() const {
+            return get<vec3>(value);
+        }
 
         // get this value as a function
         FunctionRef& getFunction() {
             return get<FunctionRef>(value);
         }
+        const FunctionRef& getFunction() const {
+            return get<FunctionRef>(value);
+        }
 
         // get this value as a function
         UserPointer& getPointer() {
             return get<UserPointer>(value);
         }
+        const UserPointer& getPointer() const {
+            return get<UserPointer>(value);
+        }
 
         // get this value as a string
         string& getString() {
-            return get<string>(value);
+            return get<CopyOnWrite<string>>(value).write();
+        }
+        const string& getString() const {
+            return get<CopyOnWrite<string>>(value).read();
         }
 
         // get this value as an array
         Array& getArray() {
-            return get<Array>(value);
+            return get<CopyOnWrite<Array>>(value).write();
+        }
+        const Array& getArray() const {
+            return get<CopyOnWrite<Array>>(value).read();
         }
 
         // get this value as an array member
         ArrayMember& getArrayMember() {
             return get<ArrayMember>(value);
         }
+        const ArrayMember& getArrayMember() const {
+            return get<ArrayMember>(value);
+        }
 
         // get this value as an std::vector<T>
         template <typename T>
         vector<T>& getStdVector();
+        template <typename T>
+        const vector<T>& getStdVector() const;
 
         // get this value as a list
         List& getList() {
-            return get<List>(value);
+            return get<CopyOnWrite<List>>(value).write();
+        }
+        const List& getList() const {
+            return get<CopyOnWrite<List>>(value).read();
         }
 
         DictionaryRef& getDictionary() {
             return get<DictionaryRef>(value);
         }
+        const DictionaryRef& getDictionary() const {
+            return get<DictionaryRef>(value);
+        }
 
         ClassRef& getClass() {
             return get<ClassRef>(value);
         }
+        const ClassRef& getClass() const {
+            return get<ClassRef>(value);
+        }
 
         // get a boolean representing the truthiness of this value
-        bool getBool() {
+        bool getBool() const {
             // non zero or "true" are true
             bool truthiness = false;
             switch (getType()) {
@@ -140,7 +181,7 @@ namespace KataScript {
             return truthiness;
         }
 
-        size_t getHash();
+        size_t getHash() const;
 
         // convert this value up to the newType
         void upconvert(Type newType);
@@ -149,6 +190,74 @@ namespace KataScript {
         void hardconvert(Type newType);
     };
 
+    static_assert(sizeof(Value) <= ValueRef::ImmediateSize && alignof(Value) <= 8, "an immediate has to fit inside its ValueRef");
+
+    template <typename ... Ts>
+    ValueRef makeImmediate(Ts&&... args) {
+        ValueRef ref;
+        new (ref.storage) Value(std::forward<Ts>(args)...);
+        ref.immediate = true;
+        return ref;
+    }
+
+    inline void ValueRef::promote() const {
+        if (immediate) {
+            box = std::move(makeValue(std::move(*inlineValue())).box);
+            immediate = false;
+            stale = true;
+        }
+    }
+
+    inline void ValueRef::release() {
+        if (immediate || stale) {
+            inlineValue()->~Value();
+            immediate = false;
+            stale = false;
+        }
+        box.reset();
+    }
+
+    inline ValueRef::ValueRef(const ValueRef& o) {
+        o.promote();
+        box = o.box;
+    }
+
+    inline ValueRef::ValueRef(ValueRef&& o) noexcept : box(std::move(o.box)) {
+        if (o.immediate) {
+            new (storage) Value(std::move(*o.inlineValue()));
+            immediate = true;
+            o.immediate = false;
+            o.stale = true;
+        }
+    }
+
+    // the new handle is made before this one lets go, in case this one owns what it's assigned from
+    inline ValueRef& ValueRef::operator=(const ValueRef& o) {
+        if (this != &o) {
+            *this = ValueRef(o);
+        }
+        return *this;
+    }
+
+    inline ValueRef& ValueRef::operator=(ValueRef&& o) noexcept {
+        if (this != &o) {
+            ValueRef taken(std::move(o));
+            release();
+            box = std::move(taken.box);
+            if (taken.immediate) {
+                new (storage) Value(std::move(*taken.inlineValue()));
+                immediate = true;
+            }
+        }
+        return *this;
+    }
+}
+
+// dictionaries store whole values, and the operators below need the full dictionary
+#include "dictionary.hpp"
+
+namespace KataScript {
+
     // cout << operators for examples
 
     // define cout operator for List
@@ -212,14 +321,19 @@ namespace KataScript {
         }
     }
 
+    // throws if a and b would have to convert between numbers and non-numbers to match
+    inline void throwOnNonNumberToNumberCompare(const Value& a, const Value& b) {
+        if (a.getType() != b.getType() && max((int)a.getType(), (int)b.getType()) > (int)Type::Vec3) {
+            throw Exception(
+                "Types `"s + getTypeName(a.getType()) + " " + a.getPrintString() + "` and `" 
+                + getTypeName(b.getType()) + " " + b.getPrintString() + "` are incompatible for this operation");
+        }
+    }
+
     // makes both values have matching types but doesn't allow converting between numbers and non-numbers
     inline void upconvertThrowOnNonNumberToNumberCompare(Value& a, Value& b) {
+        throwOnNonNumberToNumberCompare(a, b);
         if (a.getType() != b.getType()) {
-            if (max((int)a.getType(), (int)b.getType()) > (int)Type::Vec3) {
-                throw Exception(
-                    "Types `"s + getTypeName(a.getType()) + " " + a.getPrintString() + "` and `" 
-                    + getTypeName(b.getType()) + " " + b.getPrintString() + "` are incompatible for this operation");
-            }
             if (a.getType() < b.getType()) {
                 a.upconvert(b.getType());
             } else {
@@ -228,9 +342,53 @@ namespace KataScript {
         }
     }
 
-    // math operators
-    inline Value operator + (Value a, Value b) {
-        upconvert(a, b);
+    // calls op on a and b with matching types
+    // operands that already match are passed through by reference, only a converted side gets copied
+    template <bool NumbersOnly, typename Op>
+    inline auto withMatchingTypes(const Value& a, const Value& b, Op&& op) -> decltype(op(a, b)) {
+        if constexpr (NumbersOnly) {
+            throwOnNonNumberToNumberCompare(a, b);
+        } else {
+            if (a.getType() == Type::ArrayMember) {
+                auto member = a.getArrayMember().getValue();
+                return withMatchingTypes<NumbersOnly>(*member, b, op);
+            }
+            if (b.getType() == Type::ArrayMember) {
+                auto member = b.getArrayMember().getValue();
+                return withMatchingTypes<NumbersOnly>(a, *member, op);
+            }
+        }
+        if (a.getType() == b.getType()) {
+            return op(a, b);
+        }
+        if (a.getType() < b.getType()) {
+            auto converted = a;
+            converted.upconvert(b.getType());
+            return op(std::as_const(converted), b);
+        }
+        auto converted = b;
+        converted.upconvert(a.getType());
+        return op(a, std::as_const(converted));
+    }
+
+    // gets b in a's type for a compound assignment, converting a in place if it's the narrower one
+    // storage holds the converted copy of b when one is needed
+    inline const Value& matchForAssignment(Value& a, const Value& b, Value& storage) {
+        throwOnNonNumberToNumberCompare(a, b);
+        if (a.getType() == b.getType()) {
+            return b;
+        }
+        if (a.getType() < b.getType()) {
+            a.upconvert(b.getType());
+            return b;
+        }
+        storage = b;
+        storage.upconvert(a.getType());
+        return storage;
+    }
+
+    // math kernels, these expect both sides to already have the same type
+    inline Value addSameType(const Value& a, const Value& b) {
         switch (a.getType()) {
         case Type::Int:
             return Value{ a.getInt() + b.getInt() };
@@ -248,15 +406,18 @@ namespace KataScript {
         {
             auto arr = Array(a.getArray());
             arr.push_back(b.getArray());
-            return Value{ arr };
+            return Value{ std::move(arr) };
         }
         break;
         case Type::List:
         {
-            auto list = List(a.getList());
+            auto& alist = a.getList();
             auto& blist = b.getList();
+            List list;
+            list.reserve(alist.size() + blist.size());
+            list.insert(list.end(), alist.begin(), alist.end());
             list.insert(list.end(), blist.begin(), blist.end());
-            return Value{ list };
+            return Value{ std::move(list) };
         }
         break;
         case Type::Dictionary:
@@ -272,8 +433,7 @@ namespace KataScript {
         }
     }
 
-    inline Value operator - (Value a, Value b) {
-        upconvertThrowOnNonNumberToNumberCompare(a, b);
+    inline Value subtractSameType(const Value& a, const Value& b) {
         switch (a.getType()) {
         case Type::Int:
             return Value{ a.getInt() - b.getInt() };
@@ -290,8 +450,7 @@ namespace KataScript {
         }
     }
 
-    inline Value operator * (Value a, Value b) {
-        upconvertThrowOnNonNumberToNumberCompare(a, b);
+    inline Value multiplySameType(const Value& a, const Value& b) {
         switch (a.getType()) {
         case Type::Int:
             return Value{ a.getInt() * b.getInt() };
@@ -308,8 +467,7 @@ namespace KataScript {
         }
     }
 
-    inline Value operator / (Value a, Value b) {
-        upconvertThrowOnNonNumberToNumberCompare(a, b);
+    inline Value divideSameType(const Value& a, const Value& b) {
         switch (a.getType()) {
         case Type::Int:
             return Value{ a.getInt() / b.getInt() };
@@ -326,78 +484,141 @@ namespace KataScript {
         }
     }
 
-    inline Value operator += (Value& a, Value b) {
+    inline Value modSameType(const Value& a, const Value& b) {
+        switch (a.getType()) {
+        case Type::Int:
+            return Value{ a.getInt() % b.getInt() };
+            break;
+        case Type::Float:
+            return Value{ std::fmod(a.getFloat(), b.getFloat()) };
+            break;
+        default:
+            throw Exception("Operator %% not defined for type `"s + getTypeName(a.getType()) + "`");
+            break;
+        }
+    }
+
+    // math operators
+    inline Value operator + (const Value& a, const Value& b) {
+        return withMatchingTypes<false>(a, b, addSameType);
+    }
+
+    inline Value operator - (const Value& a, const Value& b) {
+        return withMatchingTypes<true>(a, b, subtractSameType);
+    }
+
+    inline Value operator * (const Value& a, const Value& b) {
+        return withMatchingTypes<true>(a, b, multiplySameType);
+    }
+
+    inline Value operator / (const Value& a, const Value& b) {
+        return withMatchingTypes<true>(a, b, divideSameType);
+    }
+
+    inline Value operator % (const Value& a, const Value& b) {
+        return withMatchingTypes<true>(a, b, modSameType);
+    }
+
+    inline Value& operator += (Value& a, const Value& b) {
+        if (&a == &b) {
+            // appending something to itself reads from a snapshot
+            auto copy = b;
+            return a += copy;
+        }
+        Value storage;
+        const Value* rhs = &b;
         if ((int)a.getType() < (int)Type::Array || b.getType() == Type::List) {
-            upconvert(a, b);
+            if (a.getType() == Type::ArrayMember) {
+                a = *a.getArrayMember().getValue();
+            }
+            if (b.getType() == Type::ArrayMember) {
+                storage = *b.getArrayMember().getValue();
+                rhs = &storage;
+            }
+            if (a.getType() < rhs->getType()) {
+                a.upconvert(rhs->getType());
+            } else if (rhs->getType() < a.getType()) {
+                if (rhs != &storage) {
+                    storage = b;
+                    rhs = &storage;
+                }
+                storage.upconvert(a.getType());
+            }
         }
+        auto& r = *rhs;
         switch (a.getType()) {
         case Type::Int:
-            a.getInt() += b.getInt();
+            a.getInt() += r.getInt();
             break;
         case Type::Float:
-            a.getFloat() += b.getFloat();
+            a.getFloat() += r.getFloat();
             break;
         case Type::Vec3:
-
-            a.getVec3() += b.getVec3();
+            a.getVec3() += r.getVec3();
             break;
         case Type::String:
-            a.getString() += b.getString();
+            a.getString() += r.getString();
             break;
         case Type::Array:
         {
             auto& arr = a.getArray();
-            auto bType = b.getType() == Type::Array ? b.getArray().getType() : b.getType();
+            auto bType = r.getType() == Type::Array ? r.getArray().getType() : r.getType();
             if (arr.size() == 0) {
                 arr.changeType(bType);
             }
-            if (arr.getType() == b.getType()
-                || (b.getType() == Type::Array && b.getArray().getType() == arr.getType())) {
-                switch (b.getType()) {
+            if (arr.getType() == r.getType()
+                || (r.getType() == Type::Array && r.getArray().getType() == arr.getType())) {
+                switch (r.getType()) {
                 case Type::Int:
-                    arr.push_back(b.getInt());
+                    arr.push_back(r.getInt());
                     break;
                 case Type::Float:
-                    arr.push_back(b.getFloat());
+                    arr.push_back(r.getFloat());
                     break;
                 case Type::Vec3:
-                    arr.push_back(b.getVec3());
+                    arr.push_back(r.getVec3());
                     break;
                 case Type::Function:
-                    arr.push_back(b.getFunction());
+                    arr.push_back(r.getFunction());
                     break;
                 case Type::String:
-                    arr.push_back(b.getString());
+                    arr.push_back(r.getString());
                     break;
                 case Type::UserPointer:
-                    arr.push_back(b.getPointer());
+                    arr.push_back(r.getPointer());
                     break;
                 case Type::Array:
-                    arr.push_back(b.getArray());
+                    arr.push_back(r.getArray());
                     break;
                 default:
                     break;
                 }
             }
-            return Value{ arr };
         }
         break;
         case Type::List:
         {
             auto& list = a.getList();
-            switch (b.getType()) {
+            switch (r.getType()) {
             case Type::Int:
             case Type::Float:
             case Type::Vec3:
             case Type::Function:
             case Type::String:
             case Type::UserPointer:
-                list.push_back(make_shared<Value>(b));
+                list.push_back(makeValue(r));
                 break;
+            case Type::List:
+            {
+                auto& blist = r.getList();
+                list.insert(list.end(), blist.begin(), blist.end());
+            }
+            break;
             default:
             {
-                b.upconvert(Type::List);
-                auto& blist = b.getList();
+                auto converted = r;
+                converted.upconvert(Type::List);
+                auto& blist = converted.getList();
                 list.insert(list.end(), blist.begin(), blist.end());
             }
             break;
@@ -407,8 +628,13 @@ namespace KataScript {
         case Type::Dictionary:
         {
             auto& dict = a.getDictionary();
-            b.upconvert(Type::Dictionary);
-            dict->merge(*b.getDictionary());
+            if (r.getType() == Type::Dictionary) {
+                dict->merge(*r.getDictionary());
+            } else {
+                auto converted = r;
+                converted.upconvert(Type::Dictionary);
+                dict->merge(*converted.getDictionary());
+            }
         }
         break;
         default:
@@ -418,17 +644,28 @@ namespace KataScript {
         return a;
     }
 
-    inline Value operator -= (Value& a, Value b) {
-        upconvertThrowOnNonNumberToNumberCompare(a, b);
+    // a temporary string or list on the left can be appended to and moved into the result
+    inline Value operator + (Value&& a, const Value& b) {
+        if (&a != &b && a.getType() == b.getType() 
+            && (a.getType() == Type::String || a.getType() == Type::List)) {
+            a += b;
+            return std::move(a);
+        }
+        return std::as_const(a) + b;
+    }
+
+    inline Value& operator -= (Value& a, const Value& b) {
+        Value storage;
+        auto& r = matchForAssignment(a, b, storage);
         switch (a.getType()) {
         case Type::Int:
-            a.getInt() -= b.getInt();
+            a.getInt() -= r.getInt();
             break;
         case Type::Float:
-            a.getFloat() -= b.getFloat();
+            a.getFloat() -= r.getFloat();
             break;
         case Type::Vec3:
-            a.getVec3() -= b.getVec3();
+            a.getVec3() -= r.getVec3();
             break;
         default:
             throw Exception("Operator -= not defined for type `"s + getTypeName(a.getType()) + "`");
@@ -437,17 +674,18 @@ namespace KataScript {
         return a;
     }
 
-    inline Value operator *= (Value& a, Value b) {
-        upconvertThrowOnNonNumberToNumberCompare(a, b);
+    inline Value& operator *= (Value& a, const Value& b) {
+        Value storage;
+        auto& r = matchForAssignment(a, b, storage);
         switch (a.getType()) {
         case Type::Int:
-            a.getInt() *= b.getInt();
+            a.getInt() *= r.getInt();
             break;
         case Type::Float:
-            a.getFloat() *= b.getFloat();
+            a.getFloat() *= r.getFloat();
             break;
         case Type::Vec3:
-            a.getVec3() *= b.getVec3();
+            a.getVec3() *= r.getVec3();
             break;
         default:
             throw Exception("Operator *= not defined for type `"s + getTypeName(a.getType()) + "`");
@@ -456,17 +694,18 @@ namespace KataScript {
         return a;
     }
 
-    inline Value operator /= (Value& a, Value b) {
-        upconvertThrowOnNonNumberToNumberCompare(a, b);
+    inline Value& operator /= (Value& a, const Value& b) {
+        Value storage;
+        auto& r = matchForAssignment(a, b, storage);
         switch (a.getType()) {
         case Type::Int:
-            a.getInt() /= b.getInt();
+            a.getInt() /= r.getInt();
             break;
         case Type::Float:
-            a.getFloat() /= b.getFloat();
+            a.getFloat() /= r.getFloat();
             break;
         case Type::Vec3:
-            a.getVec3() /= b.getVec3();
+            a.getVec3() /= r.getVec3();
             break;
         default:
             throw Exception("Operator /= not defined for type `"s + getTypeName(a.getType()) + "`");
@@ -475,24 +714,9 @@ namespace KataScript {
         return a;
     }
 
-    inline Value operator % (Value a, Value b) {
-        upconvertThrowOnNonNumberToNumberCompare(a, b);
-        switch (a.getType()) {
-        case Type::Int:
-            return Value{ a.getInt() % b.getInt() };
-            break;
-        case Type::Float:
-            return Value{ std::fmod(a.getFloat(), b.getFloat()) };
-            break;
-        default:
-            throw Exception("Operator %% not defined for type `"s + getTypeName(a.getType()) + "`");
-            break;
-        }
-    }
-
     // comparison operators
-    bool operator != (Value a, Value b);
-    inline bool operator == (Value a, Value b) {
+    bool operator != (const Value& a, const Value& b);
+    inline bool operator == (const Value& a, const Value& b) {
         if (a.getType() != b.getType()) {
             return false;
         }
@@ -536,7 +760,7 @@ namespace KataScript {
         return true;
     }
 
-    inline bool operator != (Value a, Value b) {
+    inline bool operator != (const Value& a, const Value& b) {
         if (a.getType() != b.getType()) {
             return true;
         }
@@ -574,8 +798,7 @@ namespace KataScript {
         return a.getBool() && b.getBool();
     }
 
-    inline bool operator < (Value a, Value b) {
-        upconvertThrowOnNonNumberToNumberCompare(a, b);
+    inline bool lessSameType(const Value& a, const Value& b) {
         switch (a.getType()) {
         case Type::Int:
             return a.getInt() < b.getInt();
@@ -601,8 +824,7 @@ namespace KataScript {
         return false;
     }
 
-    inline bool operator > (Value a, Value b) {
-        upconvertThrowOnNonNumberToNumberCompare(a, b);
+    inline bool greaterSameType(const Value& a, const Value& b) {
         switch (a.getType()) {
         case Type::Int:
             return a.getInt() > b.getInt();
@@ -628,8 +850,7 @@ namespace KataScript {
         return false;
     }
 
-    inline bool operator <= (Value a, Value b) {
-        upconvertThrowOnNonNumberToNumberCompare(a, b);
+    inline bool lessOrEqualSameType(const Value& a, const Value& b) {
         switch (a.getType()) {
         case Type::Int:
             return a.getInt() <= b.getInt();
@@ -655,8 +876,7 @@ namespace KataScript {
         return false;
     }
 
-    inline bool operator >= (Value a, Value b) {
-        upconvertThrowOnNonNumberToNumberCompare(a, b);
+    inline bool greaterOrEqualSameType(const Value& a, const Value& b) {
         switch (a.getType()) {
         case Type::Int:
             return a.getInt() >= b.getInt();
@@ -681,4 +901,182 @@ namespace KataScript {
         }
         return false;
     }
-}
\ No newline at end of file
+
+    inline bool operator < (const Value& a, const Value& b) {
+        return withMatchingTypes<true>(a, b, lessSameType);
+    }
+
+    inline bool operator > (const Value& a, const Value& b) {
+        return withMatchingTypes<true>(a, b, greaterSameType);
+    }
+
+    inline bool operator <= (const Value& a, const Value& b) {
+        return withMatchingTypes<true>(a, b, lessOrEqualSameType);
+    }
+
+    inline bool operator >= (const Value& a, const Value& b) {
+        return withMatchingTypes<true>(a, b, greaterOrEqualSameType);
+    }
+
+    // kernels for builtin operators on pairs of numbers, indexed by operator and then the two types
+    using OperatorKernel = Value(*)(const Value&, const Value&);
+
+    template <BuiltinOperator Op, typename T>
+    inline Value applyOperator(const T& a, const T& b) {
+        if constexpr (Op == BuiltinOperator::Add) {
+            return Value(a + b);
+        } else if constexpr (Op == BuiltinOperator::Subtract) {
+            return Value(a - b);
+        } else if constexpr (Op == BuiltinOperator::Multiply) {
+            return Value(a * b);
+        } else if constexpr (Op == BuiltinOperator::Divide) {
+            return Value(a / b);
+        } else if constexpr (Op == BuiltinOperator::Modulo) {
+            if constexpr (std::is_same_v<T, Float>) {
+                return Value(std::fmod(a, b));
+            } else {
+                return Value(a % b);
+            }
+        } else if constexpr (Op == BuiltinOperator::Equal) {
+            return Value((Int)(a == b));
+        } else if constexpr (Op == BuiltinOperator::NotEqual) {
+            return Value((Int)(a != b));
+        } else if constexpr (Op == BuiltinOperator::Less) {
+            return Value((Int)(a < b));
+        } else if constexpr (Op == BuiltinOperator::Greater) {
+            return Value((Int)(a > b));
+        } else if constexpr (Op == BuiltinOperator::LessEqual) {
+            return Value((Int)(a <= b));
+        } else {
+            return Value((Int)(a >= b));
+        }
+    }
+
+    // mixed ints and floats do the math as floats, same as upconvert
+    template <BuiltinOperator Op, typename A, typename B>
+    inline Value operatorKernel(const Value& a, const Value& b) {
+        using T = std::conditional_t<std::is_same_v<A, B>, A, Float>;
+        return applyOperator<Op, T>(static_cast<T>(get<A>(a.value)), static_cast<T>(get<B>(b.value)));
+    }
+
+    template <BuiltinOperator Op>
+    constexpr array<array<OperatorKernel, 3>, 3> numberKernels() {
+        // vec3 has no ordering or modulo, those go through the regular operators
+        constexpr bool vec3Supported = Op == BuiltinOperator::Add || Op == BuiltinOperator::Subtract
+            || Op == BuiltinOperator::Multiply || Op == BuiltinOperator::Divide 
+            || Op == BuiltinOperator::Equal || Op == BuiltinOperator::NotEqual;
+        OperatorKernel vec3Kernel = nullptr;
+        if constexpr (vec3Supported) {
+            vec3Kernel = operatorKernel<Op, vec3, vec3>;
+        }
+        // equality is type strict, so an int never equals a float and those go through the regular operators
+        constexpr bool mixedSupported = Op != BuiltinOperator::Equal && Op != BuiltinOperator::NotEqual;
+        OperatorKernel intFloatKernel = nullptr;
+        OperatorKernel floatIntKernel = nullptr;
+        if constexpr (mixedSupported) {
+            intFloatKernel = operatorKernel<Op, Int, Float>;
+            floatIntKernel = operatorKernel<Op, Float, Int>;
+        }
+        return {{
+            {{ operatorKernel<Op, Int, Int>, intFloatKernel, nullptr }},
+            {{ floatIntKernel, operatorKernel<Op, Float, Float>, nullptr }},
+            {{ nullptr, nullptr, vec3Kernel }}
+        }};
+    }
+
+    inline constexpr array<array<array<OperatorKernel, 3>, 3>, (size_t)BuiltinOperator::Count> operatorKernels = {{
+        {},
+        numberKernels<BuiltinOperator::Add>(),
+        numberKernels<BuiltinOperator::Subtract>(),
+        numberKernels<BuiltinOperator::Multiply>(),
+        numberKernels<BuiltinOperator::Divide>(),
+        numberKernels<BuiltinOperator::Modulo>(),
+        numberKernels<BuiltinOperator::Equal>(),
+        numberKernels<BuiltinOperator::NotEqual>(),
+        numberKernels<BuiltinOperator::Less>(),
+        numberKernels<BuiltinOperator::Greater>(),
+        numberKernels<BuiltinOperator::LessEqual>(),
+        numberKernels<BuiltinOperator::GreaterEqual>()
+    }};
+
+    // run a builtin operator on two arguments, numbers use the kernels and everything else the regular operators
+    // the result is returned inline so evaluators can keep temporaries off the heap
+    inline Value evaluateBuiltinOperator(BuiltinOperator op, const Value& a, const Value& b) {
+        // Int, Float and Vec3 map to 0, 1 and 2, everything else is out of range
+        auto aIndex = (size_t)a.getType() - 1;
+        auto bIndex = (size_t)b.getType() - 1;
+        if (aIndex < 3 && bIndex < 3) {
+            if (auto kernel = operatorKernels[(size_t)op][aIndex][bIndex]) {
+                return kernel(a, b);
+            }
+        }
+        switch (op) {
+        case BuiltinOperator::Add:
+            return a + b;
+        case BuiltinOperator::Subtract:
+            return a - b;
+        case BuiltinOperator::Multiply:
+            return a * b;
+        case BuiltinOperator::Divide:
+            return a / b;
+        case BuiltinOperator::Modulo:
+            return a % b;
+        case BuiltinOperator::Equal:
+            return Value((Int)(a == b));
+        case BuiltinOperator::NotEqual:
+            return Value((Int)(a != b));
+        case BuiltinOperator::Less:
+            return Value((Int)(a < b));
+        case BuiltinOperator::Greater:
+            return Value((Int)(a > b));
+        case BuiltinOperator::LessEqual:
+            return Value((Int)(a <= b));
+        case BuiltinOperator::GreaterEqual:
+            return Value((Int)(a >= b));
+        default:
+            throw Exception("Unknown builtin operator");
+        }
+    }
+
+    inline ValueRef applyBuiltinOperator(BuiltinOperator op, const Value& a, const Value& b) {
+        return makeImmediate(evaluateBuiltinOperator(op, a, b));
+    }
+
+    // apply a builtin assignment straight to its target, val is unused by increment and decrement
+    inline void applyBuiltinAssignment(BuiltinAssignment op, Value& target, const Value& val) {
+        switch (op) {
+        case BuiltinAssignment::Set:
+            target = val;
+            break;
+        case BuiltinAssignment::Add:
+            target += val;
+            break;
+        case BuiltinAssignment::Subtract:
+            target -= val;
+            break;
+        case BuiltinAssignment::Multiply:
+            target *= val;
+            break;
+        case BuiltinAssignment::Divide:
+            target /= val;
+            break;
+        case BuiltinAssignment::Increment:
+            target += Value(Int(1));
+            break;
+        case BuiltinAssignment::Decrement:
+            target -= Value(Int(1));
+            break;
+        default:
+            throw Exception("Unknown builtin assignment");
+        }
+    }
+
+    // which argument a builtin assignment called with count arguments changes, or count if it can't be applied in place
+    // prefix increments and decrements get a null first argument, like every prefix operator
+    inline size_t builtinAssignmentTarget(BuiltinAssignment op, size_t count) {
+        if (op >= BuiltinAssignment::Increment) {
+            return (count == 1 || count == 2) ? count - 1 : count;
+        }
+        return count == 2 ? 0 : count;
+    }
+}
@@ -23,6 +23,16 @@ namespace Microsoft {
 				auto str = KataScript::Value(t).getPrintString();
 				return std::wstring(str.begin(), str.end());
 			}
+
+			template<> static std::wstring ToString<std::vector<KataScript::Int>>(const std::vector<KataScript::Int>& t) {
+				auto str = KataScript::Value(KataScript::Array(t)).getPrintString();
+				return std::wstring(str.begin(), str.end());
+			}
+
+			template<> static std::wstring ToString<std::vector<KataScript::Float>>(const std::vector<KataScript::Float>& t) {
+				auto str = KataScript::Value(KataScript::Array(t)).getPrintString();
+				return std::wstring(str.begin(), str.end());
+			}
 		}
 	}
 }
@@ -654,7 +664,7 @@ res2 = isValid(getMaxPerColor("Game 5: 6 red, 1 blue, 3 green; 2 blue, 1 red, 2
 
 		Assert::AreEqual(KataScript::Type::Function, value->getType());
 		Assert::AreEqual(1ull, value->getFunction()->argNames.size());
-		Assert::AreEqual("a"s, value->getFunction()->argNames[0]);
+		Assert::AreEqual("a"s, value->getFunction()->argNames[0].getString());
 		Assert::AreEqual("i"s, value->getFunction()->name);
 		Assert::AreEqual(1ull, get<std::vector<KataScript::ExpressionRef>>(value->getFunction()->body).size());
 		Assert::AreEqual(KataScript::OperatorPrecedence::func, value->getFunction()->opPrecedence);
@@ -2886,6 +2896,1234 @@ for (i = 0; i < 10; ++i) {
 		Assert::AreEqual(KataScript::Type::String, value->getType());
 		Assert::AreEqual("s\to"s, value->getString());
 	}
+
+    TEST_METHOD(ContinueNestedFunctionsAndIndirectCalls) {
+        interpreter.evaluate(R"--(
+var a = 0;
+for (i = 0; i < 10; ++i) {
+    if (i > 5) {
+        continue;
+    }
+    a = i;
+}
+fn outer(x) {
+    fn inner(y) { return y + 1; }
+    return inner(x);
+}
+b = outer(4);
+fn dbl(x) { return x * 2; }
+fn apply(f, x) { return f(x); }
+c = apply(dbl, 5);
+d = apply(dbl, 6);
+)--");
+
+        auto val = interpreter.resolveVariable("a"s);
+        Assert::AreEqual(KataScript::Type::Int, val->getType());
+        Assert::AreEqual(KataScript::Int(5), val->getInt());
+
+        val = interpreter.resolveVariable("b"s);
+        Assert::AreEqual(KataScript::Type::Int, val->getType());
+        Assert::AreEqual(KataScript::Int(5), val->getInt());
+
+        // the call node isn't rewritten, so a second call through the same variable still works
+        val = interpreter.resolveVariable("c"s);
+        Assert::AreEqual(KataScript::Type::Int, val->getType());
+        Assert::AreEqual(KataScript::Int(10), val->getInt());
+
+        val = interpreter.resolveVariable("d"s);
+        Assert::AreEqual(KataScript::Type::Int, val->getType());
+        Assert::AreEqual(KataScript::Int(12), val->getInt());
+    }
+
+    TEST_METHOD(BytecodeLoops) {
+        interpreter.setExecutionEngine(KataScript::ExecutionEngine::Bytecode);
+        interpreter.evaluate(R"--(
+var a = 0;
+var b = 0;
+for (i = 0; i < 10; ++i) {
+    if (i > 5) {
+        continue;
+    }
+    a = i;
+}
+while (true) {
+    b += 2;
+    if (b >= 7) {
+        break;
+    }
+}
+)--");
+
+        auto val = interpreter.resolveVariable("a"s);
+        Assert::AreEqual(KataScript::Type::Int, val->getType());
+        Assert::AreEqual(KataScript::Int(5), val->getInt());
+
+        val = interpreter.resolveVariable("b"s);
+        Assert::AreEqual(KataScript::Type::Int, val->getType());
+        Assert::AreEqual(KataScript::Int(8), val->getInt());
+    }
+
+    TEST_METHOD(BytecodeForeach) {
+        interpreter.setExecutionEngine(KataScript::ExecutionEngine::Bytecode);
+        interpreter.evaluate(R"--(
+sum = 0;
+foreach (x; [1, 2, 3, 4]) {
+    sum += x;
+}
+d = dictionary();
+d["a"] = 5;
+d["b"] = 6;
+total = 0;
+foreach (v; d) {
+    total += v;
+}
+)--");
+
+        auto val = interpreter.resolveVariable("sum"s);
+        Assert::AreEqual(KataScript::Type::Int, val->getType());
+        Assert::AreEqual(KataScript::Int(10), val->getInt());
+
+        val = interpreter.resolveVariable("total"s);
+        Assert::AreEqual(KataScript::Type::Int, val->getType());
+        Assert::AreEqual(KataScript::Int(11), val->getInt());
+    }
+
+    TEST_METHOD(BytecodeFunctions) {
+        interpreter.setExecutionEngine(KataScript::ExecutionEngine::Bytecode);
+        interpreter.evaluate(R"--(
+fn fib(n) {
+    if (n < 2) {
+        return n;
+    }
+    return fib(n - 1) + fib(n - 2);
+}
+fn dbl(x) { return x * 2; }
+fn apply(f, x) { return f(x); }
+i = fib(15);
+j = apply(dbl, 5);
+)--");
+
+        auto val = interpreter.resolveVariable("i"s);
+        Assert::AreEqual(KataScript::Type::Int, val->getType());
+        Assert::AreEqual(KataScript::Int(610), val->getInt());
+
+        val = interpreter.resolveVariable("j"s);
+        Assert::AreEqual(KataScript::Type::Int, val->getType());
+        Assert::AreEqual(KataScript::Int(10), val->getInt());
+    }
+
+    TEST_METHOD(BytecodeClasses) {
+        interpreter.setExecutionEngine(KataScript::ExecutionEngine::Bytecode);
+        interpreter.evaluate(R"--(
+class counter {
+    var count;
+    fn counter(start) {
+        count = start;
+    }
+    fn add(n) {
+        count += n;
+        return count;
+    }
+}
+c = counter(3);
+c.add(4);
+i = c.add(1);
+)--");
+
+        auto val = interpreter.resolveVariable("i"s);
+        Assert::AreEqual(KataScript::Type::Int, val->getType());
+        Assert::AreEqual(KataScript::Int(8), val->getInt());
+    }
+
+    TEST_METHOD(FunctionSlotsSeeCallerLocals) {
+        interpreter.evaluate(R"--(
+fn inner() { return a + 1; }
+fn outer(a) { var b = inner(); return b; }
+fn setter() { q = 7; }
+fn host(q) { setter(); return q; }
+i = outer(5);
+j = host(1);
+)--");
+
+        auto val = interpreter.resolveVariable("i"s);
+        Assert::AreEqual(KataScript::Type::Int, val->getType());
+        Assert::AreEqual(KataScript::Int(6), val->getInt());
+
+        val = interpreter.resolveVariable("j"s);
+        Assert::AreEqual(KataScript::Type::Int, val->getType());
+        Assert::AreEqual(KataScript::Int(7), val->getInt());
+    }
+
+    TEST_METHOD(FunctionSlotsBlockLifetime) {
+        interpreter.evaluate(R"--(
+fn shadow(x) {
+    var r = 0;
+    for (i = 0; i < 3; ++i) {
+        var x = i;
+        r += x;
+    }
+    return r + x;
+}
+fn after() {
+    if (true) {
+        var z = 3;
+    }
+    return z;
+}
+i = shadow(100);
+z = 9;
+j = after();
+)--");
+
+        auto val = interpreter.resolveVariable("i"s);
+        Assert::AreEqual(KataScript::Type::Int, val->getType());
+        Assert::AreEqual(KataScript::Int(103), val->getInt());
+
+        val = interpreter.resolveVariable("j"s);
+        Assert::AreEqual(KataScript::Type::Int, val->getType());
+        Assert::AreEqual(KataScript::Int(9), val->getInt());
+    }
+
+    TEST_METHOD(ConstantsAreFreshValues) {
+        interpreter.evaluate(R"--(
+fn lit() { return 1; }
+a = lit();
+a += 5;
+b = lit();
+l = [];
+for (k = 0; k < 3; ++k) {
+    l.pushback(1);
+    l[k] += k;
+}
+)--");
+
+        auto val = interpreter.resolveVariable("a"s);
+        Assert::AreEqual(KataScript::Int(6), val->getInt());
+
+        val = interpreter.resolveVariable("b"s);
+        Assert::AreEqual(KataScript::Int(1), val->getInt());
+
+        val = interpreter.resolveVariable("l"s);
+        Assert::AreEqual(KataScript::Type::List, val->getType());
+        Assert::AreEqual(KataScript::Int(1), val->getList()[0]->getInt());
+        Assert::AreEqual(KataScript::Int(3), val->getList()[2]->getInt());
+    }
+
+    TEST_METHOD(ReusedFramesStartEmpty) {
+        interpreter.evaluate(R"--(
+fn sum(n) {
+    var total = n;
+    if (n > 0) {
+        total += sum(n - 1);
+    }
+    return total;
+}
+fn fresh() {
+    if (typeof(leftover) == "null") {
+        leftover = 1;
+        return 1;
+    }
+    return 2;
+}
+i = sum(100);
+a = fresh();
+b = fresh();
+)--");
+
+        auto val = interpreter.resolveVariable("i"s);
+        Assert::AreEqual(KataScript::Type::Int, val->getType());
+        Assert::AreEqual(KataScript::Int(5050), val->getInt());
+
+        val = interpreter.resolveVariable("b"s);
+        Assert::AreEqual(KataScript::Type::Int, val->getType());
+        Assert::AreEqual(KataScript::Int(1), val->getInt());
+    }
+
+    TEST_METHOD(BooleanOperatorsShortCircuit) {
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            interpreter.setExecutionEngine(engine);
+            interpreter.evaluate(R"--(
+calls = 0;
+fn touch(r) { calls += 1; return r; }
+a = false && touch(true);
+b = true || touch(false);
+c = true && touch(true);
+d = false || touch(false);
+)--");
+
+            Assert::AreEqual(KataScript::Int(0), interpreter.resolveVariable("a"s)->getInt());
+            Assert::AreEqual(KataScript::Int(1), interpreter.resolveVariable("b"s)->getInt());
+            Assert::AreEqual(KataScript::Int(1), interpreter.resolveVariable("c"s)->getInt());
+            Assert::AreEqual(KataScript::Int(0), interpreter.resolveVariable("d"s)->getInt());
+            Assert::AreEqual(KataScript::Int(2), interpreter.resolveVariable("calls"s)->getInt());
+        }
+    }
+
+    TEST_METHOD(LazyNativeFunction) {
+        interpreter.newFunction("select", [](const std::vector<KataScript::Thunk>& args) {
+            return args[0]()->getBool() ? args[1]() : args[2]();
+            });
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            interpreter.setExecutionEngine(engine);
+            interpreter.evaluate(R"--(
+calls = 0;
+fn touch(r) { calls += 1; return r; }
+i = select(1 < 2, touch(3), touch(4));
+j = select(false, touch(3), touch(4));
+)--");
+
+            Assert::AreEqual(KataScript::Int(3), interpreter.resolveVariable("i"s)->getInt());
+            Assert::AreEqual(KataScript::Int(4), interpreter.resolveVariable("j"s)->getInt());
+            Assert::AreEqual(KataScript::Int(2), interpreter.resolveVariable("calls"s)->getInt());
+        }
+    }
+
+    TEST_METHOD(LazyThunksOutliveTheirCall) {
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            KataScript::KataScriptInterpreter local;
+            local.setExecutionEngine(engine);
+            std::vector<KataScript::Thunk> deferred;
+            local.newFunction("defer", [&deferred](const std::vector<KataScript::Thunk>& args) {
+                deferred.push_back(args[0]);
+                return KataScript::makeNull();
+                });
+            local.evaluate(R"--(
+calls = 0;
+fn touch(r) { calls += 1; return r; }
+fn later(n) { defer(touch(n * 2)); }
+later(4);
+)--");
+            Assert::AreEqual(KataScript::Int(0), local.resolveVariable("calls"s)->getInt());
+            Assert::AreEqual(size_t(1), deferred.size());
+            // every call evaluates the argument again
+            Assert::AreEqual(KataScript::Int(8), deferred[0]()->getInt());
+            Assert::AreEqual(KataScript::Int(8), deferred[0]()->getInt());
+            Assert::AreEqual(KataScript::Int(2), local.resolveVariable("calls"s)->getInt());
+        }
+    }
+
+    TEST_METHOD(RecycledValuesDoNotAlias) {
+        interpreter.evaluate(R"--(
+fn build(n) {
+    var out = [];
+    for (i = 0; i < n; ++i) {
+        var tmp = i * 3;
+        out += tmp;
+    }
+    return out;
+}
+a = build(50);
+b = build(50);
+a[10] = 7;
+)--");
+
+        auto val = interpreter.resolveVariable("a"s);
+        Assert::AreEqual(KataScript::Type::List, val->getType());
+        Assert::AreEqual(size_t(50), val->getList().size());
+        Assert::AreEqual(KataScript::Int(7), val->getList()[10]->getInt());
+        Assert::AreEqual(KataScript::Int(147), val->getList()[49]->getInt());
+
+        val = interpreter.resolveVariable("b"s);
+        Assert::AreEqual(KataScript::Int(30), val->getList()[10]->getInt());
+    }
+
+    TEST_METHOD(ImmediateTemporariesKeepAssignmentSemantics) {
+        auto script = R"--(
+fn run() {
+    var i = 5;
+    var post = i++;
+    var pre = ++i;
+    var j = i;
+    j += 10;
+    var k = 0;
+    for (n = 0; n < 4; ++n) { k += n * 2; }
+    return [post, pre, i, j, k];
+}
+r = run();
+a0 = r[0];
+a1 = r[1];
+a2 = r[2];
+a3 = r[3];
+a4 = r[4];
+f = 1.5;
+f *= 2;
+--f;
+x = 1;
+func +=(a, b) { return "replaced"; }
+y = (x += 2);
+)--"s;
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            KataScript::KataScriptInterpreter local;
+            local.setExecutionEngine(engine);
+            local.evaluate(script);
+            Assert::AreEqual(KataScript::Int(5), local.resolveVariable("a0"s)->getInt());
+            Assert::AreEqual(KataScript::Int(7), local.resolveVariable("a1"s)->getInt());
+            Assert::AreEqual(KataScript::Int(7), local.resolveVariable("a2"s)->getInt());
+            Assert::AreEqual(KataScript::Int(17), local.resolveVariable("a3"s)->getInt());
+            Assert::AreEqual(KataScript::Int(12), local.resolveVariable("a4"s)->getInt());
+            Assert::AreEqual(KataScript::Float(2.0), local.resolveVariable("f"s)->getFloat());
+            // an assignment replaced after parsing is called instead of being applied in place
+            Assert::AreEqual(KataScript::Int(1), local.resolveVariable("x"s)->getInt());
+            Assert::AreEqual("replaced"s, local.resolveVariable("y"s)->getString());
+        }
+    }
+
+    TEST_METHOD(ImmediateValuesShareOnceCopied) {
+        auto a = KataScript::makeImmediate(KataScript::Int(3));
+        Assert::AreEqual(true, a.isImmediate());
+        auto b = std::move(a);
+        Assert::AreEqual(true, b.isImmediate());
+        Assert::AreEqual(KataScript::Int(3), b->getInt());
+        // a copy boxes the value and both handles share it
+        auto c = b;
+        Assert::AreEqual(false, b.isImmediate());
+        Assert::AreEqual(true, b == c);
+        c->getInt() = 9;
+        Assert::AreEqual(KataScript::Int(9), b->getInt());
+
+        auto script = R"--(
+fn bump(x) { x += 1; }
+var n = 1;
+bump(n);
+var l = [n, 2.5];
+n += 1;
+first = l[0];
+count = n;
+doubled = twice(n + 1);
+)--"s;
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            KataScript::KataScriptInterpreter local;
+            local.setExecutionEngine(engine);
+            local.newFunction("twice", [](const KataScript::List& args) {
+                return KataScript::makeImmediate(args[0]->getInt() * 2);
+            });
+            local.evaluate(script);
+            // variables are still passed by reference, and list literals still copy
+            Assert::AreEqual(KataScript::Int(2), local.resolveVariable("first"s)->getInt());
+            Assert::AreEqual(KataScript::Int(3), local.resolveVariable("count"s)->getInt());
+            Assert::AreEqual(KataScript::Int(8), local.resolveVariable("doubled"s)->getInt());
+        }
+    }
+
+    TEST_METHOD(AppendToSelf) {
+        interpreter.evaluate(R"--(
+l = [1, 2.5, "three"];
+l += l;
+s = "ab";
+s += s;
+t = s + s;
+same = l == [1, 2.5, "three", 1, 2.5, "three"];
+mixed = 1 + 2.5;
+)--");
+
+        auto val = interpreter.resolveVariable("l"s);
+        Assert::AreEqual(KataScript::Type::List, val->getType());
+        Assert::AreEqual(size_t(6), val->getList().size());
+        Assert::AreEqual("three"s, val->getList()[5]->getString());
+
+        val = interpreter.resolveVariable("s"s);
+        Assert::AreEqual("abab"s, val->getString());
+
+        val = interpreter.resolveVariable("t"s);
+        Assert::AreEqual("abababab"s, val->getString());
+
+        val = interpreter.resolveVariable("same"s);
+        Assert::AreEqual(KataScript::Int(1), val->getInt());
+
+        val = interpreter.resolveVariable("mixed"s);
+        Assert::AreEqual(KataScript::Type::Float, val->getType());
+        Assert::AreEqual(KataScript::Float(3.5), val->getFloat());
+    }
+
+    TEST_METHOD(ConstantFolding) {
+        for (auto folding : { true, false }) {
+            interpreter.setConstantFolding(folding);
+            auto before = interpreter.getFoldedConstantCount();
+            interpreter.evaluate(R"--(
+fn f(x) { 
+    var y = 2 * 3 + (4 / 2);
+    y += 1;
+    return x + y; 
+}
+a = f(1);
+b = f(1);
+s = "pre" + "fix";
+c = -5 * 2;
+fn never() { return 10 / 0; }
+)--");
+            if (folding) {
+                Assert::AreEqual(size_t(6), interpreter.getFoldedConstantCount() - before);
+            } else {
+                Assert::AreEqual(before, interpreter.getFoldedConstantCount());
+            }
+
+            auto val = interpreter.resolveVariable("a"s);
+            Assert::AreEqual(KataScript::Int(10), val->getInt());
+
+            val = interpreter.resolveVariable("b"s);
+            Assert::AreEqual(KataScript::Int(10), val->getInt());
+
+            val = interpreter.resolveVariable("s"s);
+            Assert::AreEqual("prefix"s, val->getString());
+
+            val = interpreter.resolveVariable("c"s);
+            Assert::AreEqual(KataScript::Int(-10), val->getInt());
+        }
+        interpreter.setConstantFolding(true);
+    }
+
+    TEST_METHOD(MemberCallsAcrossClasses) {
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            interpreter.setExecutionEngine(engine);
+            interpreter.evaluate(R"--(
+class cat {
+    var legs;
+    fn cat(n) { legs = n; }
+    fn speak() { return "meow"; }
+}
+class bird {
+    var legs;
+    var wings;
+    fn bird() { wings = 2; legs = 2; }
+    fn speak() { return "tweet"; }
+}
+pets = [cat(4), bird(), cat(3), bird()];
+sounds = "";
+legs = 0;
+foreach (pet; pets) {
+    sounds += pet.speak();
+    legs += pet.legs;
+}
+)--");
+
+            auto val = interpreter.resolveVariable("sounds"s);
+            Assert::AreEqual("meowtweetmeowtweet"s, val->getString());
+
+            val = interpreter.resolveVariable("legs"s);
+            Assert::AreEqual(KataScript::Int(11), val->getInt());
+        }
+        interpreter.setExecutionEngine(KataScript::ExecutionEngine::TreeWalker);
+    }
+
+    TEST_METHOD(MemberReadsNoticeHostErasingVariables) {
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            interpreter.setExecutionEngine(engine);
+            interpreter.evaluate(R"--(
+class cat {
+    var legs;
+    var name;
+    fn cat(n) { legs = n; name = "tom"; }
+}
+fn getLegs(c) { return c.legs; }
+c = cat(4);
+a = getLegs(c);
+)--");
+            Assert::AreEqual(KataScript::Int(4), interpreter.resolveVariable("a"s)->getInt());
+
+            // the host removes the member the read above cached, and puts a new one in its place
+            auto& variables = interpreter.resolveVariable("c"s)->getClass()->variables;
+            variables.erase(KataScript::Symbol("legs"));
+            variables.erase(KataScript::Symbol("name"));
+            variables[KataScript::Symbol("legs")] = KataScript::makeValue(KataScript::Int(3));
+            interpreter.evaluate("b = getLegs(c);"s);
+            Assert::AreEqual(KataScript::Int(3), interpreter.resolveVariable("b"s)->getInt());
+        }
+        interpreter.setExecutionEngine(KataScript::ExecutionEngine::TreeWalker);
+    }
+
+    TEST_METHOD(BuiltinOperatorsCanBeReplaced) {
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            KataScript::KataScriptInterpreter local;
+            local.setExecutionEngine(engine);
+            local.evaluate(R"--(
+fn f(a, b) { return a - b; }
+x = f(5, 3);
+m = f(5, 0.5);
+v = vec3(1, 2, 3) - vec3(1, 1, 1);
+)--");
+            local.newFunction("-", [](const KataScript::List&) { return KataScript::makeValue(KataScript::Int(100)); });
+            local.evaluate("y = f(5, 3);");
+
+            auto val = local.resolveVariable("x"s);
+            Assert::AreEqual(KataScript::Int(2), val->getInt());
+
+            val = local.resolveVariable("m"s);
+            Assert::AreEqual(KataScript::Type::Float, val->getType());
+            Assert::AreEqual(KataScript::Float(4.5), val->getFloat());
+
+            val = local.resolveVariable("v"s);
+            Assert::AreEqual(KataScript::Type::Vec3, val->getType());
+            Assert::AreEqual(1.f, val->getVec3().y);
+
+            val = local.resolveVariable("y"s);
+            Assert::AreEqual(KataScript::Int(100), val->getInt());
+        }
+    }
+
+    TEST_METHOD(MixedIntFloatEqualityIsTypeStrict) {
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            KataScript::KataScriptInterpreter local;
+            local.setExecutionEngine(engine);
+            local.evaluate(R"--(
+a = 1;
+b = 1.0;
+c = a == b;
+d = a != b;
+e = 1 == 1.0;
+f = 1 != 1.0;
+g = b == a;
+h = a < 1.5;
+)--");
+            Assert::AreEqual(KataScript::Int(0), local.resolveVariable("c"s)->getInt());
+            Assert::AreEqual(KataScript::Int(1), local.resolveVariable("d"s)->getInt());
+            Assert::AreEqual(KataScript::Int(0), local.resolveVariable("e"s)->getInt());
+            Assert::AreEqual(KataScript::Int(1), local.resolveVariable("f"s)->getInt());
+            Assert::AreEqual(KataScript::Int(0), local.resolveVariable("g"s)->getInt());
+            // ordering still compares mixed numbers by value
+            Assert::AreEqual(KataScript::Int(1), local.resolveVariable("h"s)->getInt());
+        }
+    }
+
+    TEST_METHOD(FoldedConstantsSeeOperatorsReplacedLater) {
+        auto script = R"--(
+fn f() { return 1 + 2; }
+fn g() { return 2 * 3 - 1; }
+a = f();
+b = g();
+func *(x, y) { return 10; }
+c = g();
+func +(x, y) { return "plus"; }
+d = f();
+)--"s;
+        auto program = interpreter.compile(script);
+        Assert::AreEqual(true, program != nullptr);
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            for (auto mode : { 0, 1, 2 }) {
+                // parsed up front, parsed lazily, and loaded from a compiled program
+                KataScript::KataScriptInterpreter local;
+                local.setExecutionEngine(engine);
+                local.setLazyParsing(mode == 1);
+                if (mode == 2) {
+                    Assert::AreEqual(false, local.run(*program));
+                } else {
+                    local.evaluate(script);
+                }
+                Assert::AreEqual(true, local.getFoldedConstantCount() > 0);
+                Assert::AreEqual(KataScript::Int(3), local.resolveVariable("a"s)->getInt());
+                Assert::AreEqual(KataScript::Int(5), local.resolveVariable("b"s)->getInt());
+                // the inner * was replaced, the outer - wasn't
+                Assert::AreEqual(KataScript::Int(9), local.resolveVariable("c"s)->getInt());
+                Assert::AreEqual("plus"s, local.resolveVariable("d"s)->getString());
+            }
+        }
+    }
+
+    TEST_METHOD(TokenizerStreamsWithPositions) {
+        std::istringstream stream("a = -1; // note\n  b = \"x\ny\";"s);
+        // a tiny chunk size makes tokens straddle reads
+        KataScript::Tokenizer tokenizer(stream, 3);
+        KataScript::Token token;
+        std::string texts;
+        while (tokenizer.next(token)) {
+            texts += std::string(token.text) + " ";
+            if (token.text == "b") {
+                Assert::AreEqual(size_t(2), token.line);
+                Assert::AreEqual(size_t(3), token.column);
+            }
+        }
+        Assert::AreEqual("a = -1 ; b = \"x\ny\" ; "s, texts);
+        Assert::AreEqual(size_t(3), token.line);
+        Assert::AreEqual(size_t(3), token.column);
+    }
+
+    TEST_METHOD(TokenizerFindsKeywordsAndLongWords) {
+        Assert::AreEqual(true, KataScript::getKeyword("func") == KataScript::Keyword::Function);
+        Assert::AreEqual(true, KataScript::getKeyword("while") == KataScript::Keyword::Loop);
+        Assert::AreEqual(true, KataScript::getKeyword("funct") == KataScript::Keyword::None);
+        Assert::AreEqual(true, KataScript::getKeyword("") == KataScript::Keyword::None);
+
+        // words longer than a scanning block, with characters that only look like grammar
+        std::string source = "aVeryLongIdentifierName_withDigits123\\#$ = caf\xc3\xa9[0];if(x){}";
+        KataScript::Tokenizer tokenizer(source);
+        KataScript::Token token;
+        std::vector<std::string> texts;
+        std::vector<KataScript::Keyword> keywords;
+        while (tokenizer.next(token)) {
+            texts.emplace_back(token.text);
+            keywords.push_back(token.keyword);
+        }
+        std::vector<std::string> expected = { "aVeryLongIdentifierName_withDigits123\\#$", "=", "caf\xc3\xa9", "[", "0", "]", ";", "if", "(", "x", ")", "{", "}" };
+        Assert::AreEqual(expected.size(), texts.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            Assert::AreEqual(expected[i], texts[i]);
+        }
+        Assert::AreEqual(true, keywords[7] == KataScript::Keyword::If);
+        Assert::AreEqual(true, keywords[9] == KataScript::Keyword::None);
+    }
+
+    TEST_METHOD(EvaluateFromStream) {
+        std::istringstream stream(R"--(
+// comments and multi-line strings survive streaming
+s = "one
+two";
+fn add(a,
+       b) {
+    return a + b;
+}
+x = add(1,
+        2);
+)--"s);
+        interpreter.evaluate(stream);
+
+        auto val = interpreter.resolveVariable("s"s);
+        Assert::AreEqual("one\ntwo"s, val->getString());
+
+        val = interpreter.resolveVariable("x"s);
+        Assert::AreEqual(KataScript::Int(3), val->getInt());
+    }
+
+    TEST_METHOD(OperatorPrecedenceInsideExpressions) {
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            KataScript::KataScriptInterpreter local;
+            local.setExecutionEngine(engine);
+            local.evaluate(R"--(
+class point { var v; fn point(n) { v = n; } }
+fn make(n) { return point(n); }
+x = 4;
+a = -x;
+b = 3 * -x;
+c = 1 == !0;
+q = point(5);
+d = 2 + 3 * q.v;
+e = make(7).v;
+f = -x * 2 + 10;
+)--");
+            Assert::AreEqual(KataScript::Int(-4), local.resolveVariable("a"s)->getInt());
+            Assert::AreEqual(KataScript::Int(-12), local.resolveVariable("b"s)->getInt());
+            Assert::AreEqual(KataScript::Int(1), local.resolveVariable("c"s)->getInt());
+            Assert::AreEqual(KataScript::Int(17), local.resolveVariable("d"s)->getInt());
+            Assert::AreEqual(KataScript::Int(7), local.resolveVariable("e"s)->getInt());
+            Assert::AreEqual(KataScript::Int(2), local.resolveVariable("f"s)->getInt());
+        }
+    }
+
+    TEST_METHOD(ListLiteralsReadVariablesWhenTheyRun) {
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            KataScript::KataScriptInterpreter local;
+            local.setExecutionEngine(engine);
+            local.evaluate(R"--(
+fn pair(a) { return [a, 1]; }
+x = pair(5);
+y = pair("s");
+)--");
+            auto val = local.resolveVariable("x"s);
+            Assert::AreEqual(KataScript::Type::Array, val->getType());
+            Assert::AreEqual(KataScript::Int(5), val->getStdVector<KataScript::Int>()[0]);
+
+            val = local.resolveVariable("y"s);
+            Assert::AreEqual(KataScript::Type::List, val->getType());
+            Assert::AreEqual("s"s, val->getList()[0]->getString());
+        }
+    }
+
+    TEST_METHOD(CompiledScriptsRunLikeSource) {
+        {
+            std::ofstream source("compiledTest.ks");
+            source << R"--(
+class animal { var legs = 4; fn animal() { } fn count() { return legs; } }
+class bird : animal { fn bird() { legs = 2; } }
+fn add(a, b) { return [a, b]; }
+total = 0;
+for (i = 0; i < 5; i++) { if (i == 2) { continue; } total += i; }
+{ var hidden = 3; total += hidden; }
+b = bird();
+legs = b.count();
+pair = add(1, 2);
+)--";
+        }
+        Assert::AreEqual(false, interpreter.compileFile("compiledTest.ks", "compiledTest.ksc"));
+        // compiling doesn't run anything
+        Assert::AreEqual(KataScript::Type::Null, interpreter.resolveVariable("total"s)->getType());
+
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            KataScript::KataScriptInterpreter local;
+            local.setExecutionEngine(engine);
+            Assert::AreEqual(false, local.evaluateFile("compiledTest.ksc"));
+
+            Assert::AreEqual(KataScript::Int(11), local.resolveVariable("total"s)->getInt());
+            Assert::AreEqual(KataScript::Int(2), local.resolveVariable("legs"s)->getInt());
+            Assert::AreEqual(KataScript::Type::Null, local.resolveVariable("hidden"s)->getType());
+            auto val = local.resolveVariable("pair"s);
+            Assert::AreEqual(KataScript::Type::Array, val->getType());
+            Assert::AreEqual(KataScript::Int(2), val->getStdVector<KataScript::Int>()[1]);
+        }
+
+        // a changed source wins over an old compiled file
+        {
+            std::ofstream source("compiledTest.ks");
+            source << "total = 99;";
+        }
+        KataScript::KataScriptInterpreter local;
+        Assert::AreEqual(false, local.evaluateCompiledFile("compiledTest.ksc"));
+        Assert::AreEqual(KataScript::Int(99), local.resolveVariable("total"s)->getInt());
+        std::remove("compiledTest.ks");
+        std::remove("compiledTest.ksc");
+    }
+
+    TEST_METHOD(DamagedCompiledScriptsFallBackToSource) {
+        {
+            std::ofstream source("damagedTest.ks");
+            source << "fn f() { return 1; }\ntotal = f() + 1;";
+        }
+        Assert::AreEqual(false, interpreter.compileFile("damagedTest.ks", "damagedTest.ksc"));
+        std::string bytes;
+        {
+            std::ifstream in("damagedTest.ksc", std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        // the function count comes right after the magic, version, hash and source path
+        uint32_t pathSize;
+        std::memcpy(&pathSize, bytes.data() + 16, sizeof(pathSize));
+        uint32_t hugeCount = 0x7fffffff;
+        std::memcpy(bytes.data() + 20 + pathSize, &hugeCount, sizeof(hugeCount));
+        {
+            std::ofstream out("damagedTest.ksc", std::ios::binary);
+            out << bytes;
+        }
+
+        KataScript::KataScriptInterpreter local;
+        Assert::AreEqual(false, local.evaluateCompiledFile("damagedTest.ksc"));
+        Assert::AreEqual(KataScript::Int(2), local.resolveVariable("total"s)->getInt());
+
+        // without the source it's an error instead of a crash
+        std::remove("damagedTest.ks");
+        KataScript::KataScriptInterpreter missing;
+        Assert::AreEqual(true, missing.evaluateCompiledFile("damagedTest.ksc"));
+        std::remove("damagedTest.ksc");
+    }
+
+    TEST_METHOD(CompiledProgramsRunManyTimes) {
+        auto program = interpreter.compile(R"--(
+fn bump(n) { return n + 1; }
+runs = bump(runs);
+var local = [runs, 0];
+)--");
+        Assert::AreEqual(true, program != nullptr);
+        Assert::AreEqual(KataScript::Type::Null, interpreter.resolveVariable("runs"s)->getType());
+
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            // one program shared by two interpreters
+            KataScript::KataScriptInterpreter first;
+            KataScript::KataScriptInterpreter second;
+            first.setExecutionEngine(engine);
+            second.setExecutionEngine(engine);
+            first.evaluate("runs = 0;");
+            second.evaluate("runs = 10;");
+            for (int i = 0; i < 3; ++i) {
+                Assert::AreEqual(false, first.run(*program));
+            }
+            Assert::AreEqual(false, second.run(*program));
+
+            Assert::AreEqual(KataScript::Int(3), first.resolveVariable("runs"s)->getInt());
+            Assert::AreEqual(KataScript::Int(11), second.resolveVariable("runs"s)->getInt());
+            Assert::AreEqual(KataScript::Int(3), first.resolveVariable("local"s)->getStdVector<KataScript::Int>()[0]);
+
+            // running in a scope keeps its locals there
+            auto scope = first.newScope("request"s);
+            Assert::AreEqual(false, first.run(*program, scope));
+            Assert::AreEqual(KataScript::Int(4), first.resolveVariable("local"s, scope)->getStdVector<KataScript::Int>()[0]);
+            Assert::AreEqual(KataScript::Int(3), first.resolveVariable("local"s)->getStdVector<KataScript::Int>()[0]);
+        }
+
+        // trees of dropped programs don't pile up
+        KataScript::KataScriptInterpreter looping;
+        for (int i = 0; i < 10; ++i) {
+            auto temporary = looping.compile("n = "s + std::to_string(i) + ";");
+            Assert::AreEqual(false, looping.run(*temporary));
+        }
+        Assert::AreEqual(KataScript::Int(9), looping.resolveVariable("n"s)->getInt());
+        Assert::AreEqual(size_t(1), looping.getLoadedProgramCount());
+        Assert::AreEqual(false, looping.run(*program));
+        Assert::AreEqual(size_t(1), looping.getLoadedProgramCount());
+    }
+
+    TEST_METHOD(EvaluateFileSkipsShellHeader) {
+        {
+            std::ofstream script("mappedTest.sh");
+            script << "#!/usr/bin/env KataScript\nimport \"mappedImport.ks\";\nx = twice(21);\n";
+            std::ofstream imported("mappedImport.ks");
+            imported << "fn twice(a) { return a * 2; }\ns = \"imported\";";
+        }
+        Assert::AreEqual(false, interpreter.evaluateFile("mappedTest.sh"));
+
+        auto val = interpreter.resolveVariable("x"s);
+        Assert::AreEqual(KataScript::Int(42), val->getInt());
+
+        val = interpreter.resolveVariable("s"s);
+        Assert::AreEqual("imported"s, val->getString());
+
+        std::remove("mappedTest.sh");
+        std::remove("mappedImport.ks");
+    }
+
+    TEST_METHOD(SymbolsAreSharedByEveryInterpreter) {
+        auto symbol = KataScript::Symbol("interned"s);
+        Assert::AreEqual(symbol.id, KataScript::Symbol("interned").id);
+        Assert::AreEqual("interned"s, symbol.getString());
+        Assert::AreEqual(false, symbol == KataScript::Symbol("internedToo"));
+        Assert::AreEqual(0u, KataScript::Symbol().id);
+
+        KataScript::KataScriptInterpreter other;
+        interpreter.evaluate("class point { var x; fn point(a) { x = a; } } a = point(3);"s);
+        other.evaluate("class point { var x; fn point(a) { x = a * 2; } } a = point(3);"s);
+
+        auto x = KataScript::Symbol("x");
+        Assert::AreEqual(KataScript::Int(3), interpreter.resolveVariable("a"s)->getClass()->variables[x]->getInt());
+        Assert::AreEqual(KataScript::Int(6), other.resolveVariable("a"s)->getClass()->variables[x]->getInt());
+        Assert::AreEqual(1ull, other.resolveVariable("a"s)->getClass()->variables.count(x));
+
+        // names built from runtime data are looked up without being added to the table
+        Assert::AreEqual(false, KataScript::Symbol::find("neverInterned"s).exists());
+        Assert::AreEqual(symbol.id, KataScript::Symbol::find("interned"s).id);
+        interpreter.evaluate("b = 0; n = 0; m = 0;"s);
+        auto symbols = KataScript::SymbolTable::get().size();
+        interpreter.evaluate("n = \"not\" + \"AMember\"; b = a[\"x\"]; a[n];"s);
+        interpreter.evaluate("m = \"no\" + \"Function\"; applyfunction(m, 1);"s);
+        Assert::AreEqual(KataScript::Int(3), interpreter.resolveVariable("b"s)->getInt());
+        Assert::AreEqual(symbols, KataScript::SymbolTable::get().size());
+        Assert::AreEqual(false, KataScript::Symbol::find("notAMember"s).exists());
+    }
+
+    TEST_METHOD(LazyParsingWaitsForTheFirstCall) {
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            KataScript::KataScriptInterpreter local;
+            local.setExecutionEngine(engine);
+            local.setLazyParsing(true);
+            local.evaluate(R"--(
+fn twice(a) {
+    var b = a * 2;
+    if (b > 10) { return -1; }
+    return b;
+}
+fn outer() { fn inner() { return 3; } return inner(); }
+class counter {
+    var count;
+    fn counter() { count = 0; }
+    fn add(n) { count += n; return count; }
+}
+)--");
+            auto twice = local.resolveVariable("twice"s)->getFunction();
+            Assert::AreEqual(true, twice->unparsedBody != nullptr);
+            // bodies that define something are parsed right away
+            Assert::AreEqual(false, local.resolveFunction("outer"s)->unparsedBody != nullptr);
+            Assert::AreEqual(KataScript::Type::Function, local.resolveVariable("inner"s)->getType());
+
+            // a call in the middle of parsing a block leaves the parser where it was
+            local.evaluate("x = 0; if (true) { x = twice(4); } y = twice(6); c = counter(); c.add(2); z = c.add(3);"s);
+            Assert::AreEqual(false, twice->unparsedBody != nullptr);
+            Assert::AreEqual(KataScript::Int(8), local.resolveVariable("x"s)->getInt());
+            Assert::AreEqual(KataScript::Int(-1), local.resolveVariable("y"s)->getInt());
+            Assert::AreEqual(KataScript::Int(5), local.resolveVariable("z"s)->getInt());
+            Assert::AreEqual(KataScript::Int(5), local.resolveVariable("c"s)->getClass()->variables["count"]->getInt());
+        }
+    }
+
+    TEST_METHOD(ImportsAreCachedUntilTheFileChanges) {
+        {
+            std::ofstream imported("cachedImport.ks");
+            imported << "fn libValue() { return 1; }\nimports += 1;";
+        }
+        auto cache = interpreter.getImportCache();
+        interpreter.evaluate("imports = 0; import \"cachedImport.ks\"; import \"cachedImport.ks\"; a = libValue();"s);
+        Assert::AreEqual(KataScript::Int(1), interpreter.resolveVariable("imports"s)->getInt());
+        Assert::AreEqual(KataScript::Int(1), interpreter.resolveVariable("a"s)->getInt());
+        Assert::AreEqual(1ull, cache->getHits());
+        Assert::AreEqual(1ull, cache->getMisses());
+
+        // another interpreter sharing the cache runs the parsed file
+        KataScript::KataScriptInterpreter other;
+        other.setImportCache(cache);
+        other.evaluate("imports = 0; import \"./cachedImport.ks\"; a = libValue();"s);
+        Assert::AreEqual(KataScript::Int(1), other.resolveVariable("imports"s)->getInt());
+        Assert::AreEqual(2ull, cache->getHits());
+        Assert::AreEqual(1ull, cache->getMisses());
+
+        // a changed file is parsed again
+        {
+            std::ofstream imported("cachedImport.ks");
+            imported << "fn libValue() { return 22; }\nimports += 1;";
+        }
+        interpreter.evaluate("import \"cachedImport.ks\"; a = libValue();"s);
+        Assert::AreEqual(KataScript::Int(2), interpreter.resolveVariable("imports"s)->getInt());
+        Assert::AreEqual(KataScript::Int(22), interpreter.resolveVariable("a"s)->getInt());
+        Assert::AreEqual(2ull, cache->getMisses());
+
+        interpreter.invalidateImport("cachedImport.ks");
+        interpreter.evaluate("import \"cachedImport.ks\";"s);
+        Assert::AreEqual(KataScript::Int(3), interpreter.resolveVariable("imports"s)->getInt());
+        Assert::AreEqual(3ull, cache->getMisses());
+
+        std::remove("cachedImport.ks");
+    }
+
+    TEST_METHOD(BundledFilesAreImportedWhenFirstUsed) {
+        {
+            std::ofstream lib("bundledLib.ks");
+            lib << "fn libValue() { return 5; }\nimports += 1;";
+            std::ofstream app("bundledApp.ks");
+            app << "import \"bundledLib.ks\";\nappValue = libValue() * 2;";
+        }
+        Assert::AreEqual(false, KataScript::writeBundle("test.ksb", { "bundledLib.ks", "./bundledApp.ks" }));
+        std::remove("bundledLib.ks");
+        std::remove("bundledApp.ks");
+
+        Assert::AreEqual(true, interpreter.mountBundle("missing.ksb"));
+        Assert::AreEqual(false, interpreter.mountBundle("test.ksb"));
+        auto cache = interpreter.getImportCache();
+        cache->resetCounters();
+        interpreter.evaluate("imports = 0; import \"bundledApp.ks\"; import \"./bundledLib.ks\";"s);
+        Assert::AreEqual(KataScript::Int(1), interpreter.resolveVariable("imports"s)->getInt());
+        Assert::AreEqual(KataScript::Int(10), interpreter.resolveVariable("appValue"s)->getInt());
+        Assert::AreEqual(1ull, cache->getHits());
+        Assert::AreEqual(2ull, cache->getMisses());
+
+        // compiling finds bundled imports too
+        auto program = interpreter.compile("import \"bundledLib.ks\"; b = libValue();"s);
+        Assert::AreEqual(true, program != nullptr);
+        interpreter.run(*program);
+        Assert::AreEqual(KataScript::Int(5), interpreter.resolveVariable("b"s)->getInt());
+
+        // a file count bigger than the index can hold is an error, not an allocation
+        std::string bytes;
+        {
+            std::ifstream in("test.ksb", std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        uint32_t hugeCount = 0x7fffffff;
+        std::memcpy(bytes.data() + 8, &hugeCount, sizeof(hugeCount));
+        {
+            std::ofstream out("damaged.ksb", std::ios::binary);
+            out << bytes;
+        }
+        Assert::AreEqual(true, interpreter.mountBundle("damaged.ksb"));
+        std::remove("damaged.ksb");
+
+        interpreter.unmountBundles();
+        std::remove("test.ksb");
+    }
+
+    TEST_METHOD(DictionariesKeepTheirKeysInOrder) {
+        interpreter.evaluate("d = dictionary(); d[\"b\"] = 1; d[\"a\"] = 2; d[3] = 3; d[3.0] = 4; d[\"c\"] = 5; erase(d, \"a\");"
+            "order = []; foreach (v; d) { order += [v]; } s = string(d); k = find(d, 4); has = contains(d, \"a\");"s);
+        auto value = interpreter.resolveVariable("d"s);
+        Assert::AreEqual(4ull, value->getDictionary()->size());
+        auto order = interpreter.resolveVariable("order"s);
+        Assert::AreEqual(4ull, order->getList().size());
+        Assert::AreEqual(KataScript::Int(1), order->getList()[0]->getInt());
+        Assert::AreEqual(KataScript::Int(3), order->getList()[1]->getInt());
+        Assert::AreEqual(KataScript::Int(4), order->getList()[2]->getInt());
+        Assert::AreEqual(KataScript::Int(5), order->getList()[3]->getInt());
+        Assert::AreEqual("[`b: 1`, `3: 3`, `3.000000: 4`, `c: 5`]"s, interpreter.resolveVariable("s"s)->getString());
+        Assert::AreEqual(KataScript::Type::Float, interpreter.resolveVariable("k"s)->getType());
+        Assert::AreEqual(KataScript::Int(0), interpreter.resolveVariable("has"s)->getInt());
+
+        // empty dictionaries print and convert without reading past their end
+        interpreter.evaluate("es = string(dictionary());"s);
+        Assert::AreEqual("[]"s, interpreter.resolveVariable("es"s)->getString());
+        KataScript::Value empty(std::make_shared<KataScript::Dictionary>());
+        empty.hardconvert(KataScript::Type::Array);
+        Assert::AreEqual(KataScript::Type::Array, empty.getType());
+        Assert::AreEqual(0ull, empty.getArray().size());
+
+        // lots of keys grow the table and erasing them shrinks it again
+        KataScript::Dictionary dict;
+        for (KataScript::Int i = 0; i < 1000; ++i) {
+            dict[KataScript::Value(i)] = KataScript::makeValue(i * 2);
+        }
+        for (KataScript::Int i = 0; i < 1000; i += 2) {
+            Assert::AreEqual(true, dict.erase(KataScript::Value(i)));
+        }
+        Assert::AreEqual(500ull, dict.size());
+        Assert::AreEqual(false, dict.contains(KataScript::Value(KataScript::Int(10))));
+        Assert::AreEqual(KataScript::Int(22), dict.find(KataScript::Value(KataScript::Int(11)))->second->getInt());
+        Assert::AreEqual(KataScript::Int(1), dict.begin()->first.getInt());
+
+        // every list hashes the same, the keys themselves tell them apart
+        dict[KataScript::Value(KataScript::List{ KataScript::makeValue(KataScript::Int(1)) })] = KataScript::makeValue("one");
+        dict[KataScript::Value(KataScript::List{ KataScript::makeValue(KataScript::Int(2)) })] = KataScript::makeValue("two");
+        Assert::AreEqual(502ull, dict.size());
+        Assert::AreEqual("two"s, dict.find(KataScript::Value(KataScript::List{ KataScript::makeValue(KataScript::Int(2)) }))->second->getString());
+    }
+
+    TEST_METHOD(ArrayElementsAreReadAndWrittenInPlace) {
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            KataScript::KataScriptInterpreter local;
+            local.setExecutionEngine(engine);
+            local.evaluate(R"--(
+fn total(arr) { var sum = 0; for (i = 0; i < length(arr); i++) { sum += arr[i] * 2; } return sum; }
+a = array(1, 2, 3);
+a[1] += 5;
+a[2]++;
+x = 1.5;
+a[0] = x;
+first = a[0];
+sum = total(a);
+b = array(1.0, 2.0);
+b[0] = b[0] + b[1];
+)--");
+            auto a = local.resolveVariable("a"s);
+            Assert::AreEqual(KataScript::Int(1), a->getStdVector<KataScript::Int>()[0]);
+            Assert::AreEqual(KataScript::Int(7), a->getStdVector<KataScript::Int>()[1]);
+            Assert::AreEqual(KataScript::Int(4), a->getStdVector<KataScript::Int>()[2]);
+            // assigning converts a copy, the value assigned keeps its type
+            Assert::AreEqual(KataScript::Type::Float, local.resolveVariable("x"s)->getType());
+            Assert::AreEqual(KataScript::Type::Int, local.resolveVariable("first"s)->getType());
+            Assert::AreEqual(KataScript::Int(24), local.resolveVariable("sum"s)->getInt());
+            Assert::AreEqual(KataScript::Float(3.0), local.resolveVariable("b"s)->getStdVector<KataScript::Float>()[0]);
+
+            Assert::AreEqual(true, local.evaluate("a[3] = 1;"s));
+            Assert::AreEqual(3ull, local.resolveVariable("a"s)->getArray().size());
+        }
+    }
+
+    TEST_METHOD(CopiesShareDataUntilOneChanges) {
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            KataScript::KataScriptInterpreter local;
+            local.setExecutionEngine(engine);
+            local.evaluate(R"--(
+class holder {
+    var items;
+    fn holder(base) { items = base; }
+    fn add(x) { pushback(items, x); }
+}
+fn grow(arr) { var c = arr; pushback(c, 5); return c; }
+s = "abc";
+t = s;
+t += "d";
+a = array(1, 2, 3);
+b = a;
+pushback(b, 4);
+g = grow(a);
+l = list(1, "x");
+m = l;
+pushback(m, 3);
+h = holder(a);
+h.add(9);
+)--");
+            Assert::AreEqual("abc"s, local.resolveVariable("s"s)->getString());
+            Assert::AreEqual("abcd"s, local.resolveVariable("t"s)->getString());
+            Assert::AreEqual(3ull, local.resolveVariable("a"s)->getArray().size());
+            Assert::AreEqual(4ull, local.resolveVariable("b"s)->getArray().size());
+            Assert::AreEqual(4ull, local.resolveVariable("g"s)->getArray().size());
+            Assert::AreEqual(2ull, local.resolveVariable("l"s)->getList().size());
+            Assert::AreEqual(3ull, local.resolveVariable("m"s)->getList().size());
+            Assert::AreEqual(4ull, local.resolveVariable("h"s)->getClass()->variables["items"]->getArray().size());
+        }
+
+        KataScript::Value original(KataScript::List{ KataScript::makeValue(KataScript::Int(1)) });
+        auto copy = original;
+        copy.getList().push_back(KataScript::makeNull());
+        Assert::AreEqual(1ull, original.getList().size());
+        Assert::AreEqual(2ull, copy.getList().size());
+    }
+
+    TEST_METHOD(ForeachGoesThroughCollectionsInPlace) {
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            KataScript::KataScriptInterpreter local;
+            local.setExecutionEngine(engine);
+            local.evaluate(R"--(
+a = array(1, 2, 3);
+foreach (x; a) { pushback(a, x * 10); }
+indexed = 0;
+foreach (i, x; array(5, 6, 7)) { indexed += i * x; }
+letters = "";
+foreach (i, c; "abc") { letters += c + string(i); }
+l = list(1, "b", 3.5);
+count = 0;
+foreach (x; l) { pushback(l, x); count++; }
+d = dictionary();
+d["x"] = 1;
+d["y"] = 2;
+keys = "";
+foreach (k, v; d) { keys += k + string(v); if (k == "x") { d["z"] = 3; erase(d, "y"); } }
+fn sum(arr) { var s = 0.0; foreach (x; arr) { s += x; } return s; }
+total = sum(array(1.5, 2.5));
+)--");
+            // arrays, lists and strings are gone through as they were when the loop started
+            Assert::AreEqual(6ull, local.resolveVariable("a"s)->getArray().size());
+            Assert::AreEqual(KataScript::Int(30), local.resolveVariable("a"s)->getStdVector<KataScript::Int>()[5]);
+            Assert::AreEqual(KataScript::Int(20), local.resolveVariable("indexed"s)->getInt());
+            Assert::AreEqual("a0b1c2"s, local.resolveVariable("letters"s)->getString());
+            Assert::AreEqual(KataScript::Int(3), local.resolveVariable("count"s)->getInt());
+            Assert::AreEqual(6ull, local.resolveVariable("l"s)->getList().size());
+            // dictionaries are gone through live
+            Assert::AreEqual("x1z3"s, local.resolveVariable("keys"s)->getString());
+            Assert::AreEqual(KataScript::Float(4.0), local.resolveVariable("total"s)->getFloat());
+
+            Assert::AreEqual(true, local.evaluate("foreach (a b; l) {}"s));
+        }
+    }
+
+    TEST_METHOD(ArrayMathWorksElementWise) {
+        for (auto engine : { KataScript::ExecutionEngine::TreeWalker, KataScript::ExecutionEngine::Bytecode }) {
+            KataScript::KataScriptInterpreter local;
+            local.setExecutionEngine(engine);
+            local.evaluate(R"--(
+a = array(1.0, -2.0, 3.0);
+b = array(4.0, 5.0, 6.0);
+sum = arrayadd(a, b);
+fma = arrayfma(a, 2, b);
+clamped = arrayclamp(a, -1, 2);
+absolute = arrayabs(a);
+roots = arraysqrt(array(4, 9));
+mask = arrayless(a, array(2.0, 0.0, 3.0));
+ints = arraymul(array(1, 2, 3), 3);
+mixed = arrayadd(array(1, 2), 0.5);
+v = arrayscale(array(vec3(1, 2, 3), vec3(4, 5, 6)), 2);
+kept = b;
+arraysub(b, 1, true);
+)--");
+            Assert::AreEqual(std::vector<KataScript::Float>{ 5.0, 3.0, 9.0 }, local.resolveVariable("sum"s)->getStdVector<KataScript::Float>());
+            Assert::AreEqual(std::vector<KataScript::Float>{ 6.0, 1.0, 12.0 }, local.resolveVariable("fma"s)->getStdVector<KataScript::Float>());
+            Assert::AreEqual(std::vector<KataScript::Float>{ 1.0, -1.0, 2.0 }, local.resolveVariable("clamped"s)->getStdVector<KataScript::Float>());
+            Assert::AreEqual(std::vector<KataScript::Float>{ 1.0, 2.0, 3.0 }, local.resolveVariable("absolute"s)->getStdVector<KataScript::Float>());
+            Assert::AreEqual(std::vector<KataScript::Float>{ 2.0, 3.0 }, local.resolveVariable("roots"s)->getStdVector<KataScript::Float>());
+            Assert::AreEqual(std::vector<KataScript::Int>{ 1, 1, 0 }, local.resolveVariable("mask"s)->getStdVector<KataScript::Int>());
+            Assert::AreEqual(std::vector<KataScript::Int>{ 3, 6, 9 }, local.resolveVariable("ints"s)->getStdVector<KataScript::Int>());
+            Assert::AreEqual(std::vector<KataScript::Float>{ 1.5, 2.5 }, local.resolveVariable("mixed"s)->getStdVector<KataScript::Float>());
+            Assert::AreEqual(KataScript::vec3(8, 10, 12), local.resolveVariable("v"s)->getStdVector<KataScript::vec3>()[1]);
+            // working in place only changes the array it was given
+            Assert::AreEqual(std::vector<KataScript::Float>{ 3.0, 4.0, 5.0 }, local.resolveVariable("b"s)->getStdVector<KataScript::Float>());
+            Assert::AreEqual(std::vector<KataScript::Float>{ 4.0, 5.0, 6.0 }, local.resolveVariable("kept"s)->getStdVector<KataScript::Float>());
+
+            Assert::AreEqual(true, local.evaluate("arrayadd(array(1, 2), array(1, 2, 3));"s));
+            Assert::AreEqual(true, local.evaluate("arraydiv(array(1, 2), 0);"s));
+            Assert::AreEqual(true, local.evaluate("arrayadd(array(\"a\"), 1);"s));
+        }
+    }
+
+    TEST_METHOD(ArrayMathMatchesScalarMath) {
+        // long enough to go through whole registers and a few elements after them
+        std::vector<KataScript::Float> a, b;
+        for (int i = 0; i < 37; ++i) {
+            a.push_back(i * 0.75 - 10.0);
+            b.push_back(i % 5 + 0.5);
+        }
+        KataScript::KataScriptInterpreter local;
+        *local.resolveVariable("a"s) = KataScript::Value(KataScript::Array(a));
+        *local.resolveVariable("b"s) = KataScript::Value(KataScript::Array(b));
+        local.evaluate("q = arraydiv(a, b); m = arraymul(a, b); g = arraygreaterequal(a, b); c = arrayclamp(a, -3, b);"s);
+        auto& q = local.resolveVariable("q"s)->getStdVector<KataScript::Float>();
+        auto& m = local.resolveVariable("m"s)->getStdVector<KataScript::Float>();
+        auto& g = local.resolveVariable("g"s)->getStdVector<KataScript::Int>();
+        auto& c = local.resolveVariable("c"s)->getStdVector<KataScript::Float>();
+        for (size_t i = 0; i < a.size(); ++i) {
+            Assert::AreEqual(a[i] / b[i], q[i]);
+            Assert::AreEqual(a[i] * b[i], m[i]);
+            Assert::AreEqual(KataScript::Int(a[i] >= b[i]), g[i]);
+            Assert::AreEqual(std::min(std::max(a[i], KataScript::Float(-3)), b[i]), c[i]);
+        }
+    }
 	// todo add more tests
 
 	};